@@ -0,0 +1,131 @@
+//
+//  sio_ack_bench.cpp
+//
+//  Registers and completes acks from several threads, comparing the mutex
+//  guarded map sockets used with the lock-free ack table.
+//
+
+#include <internal/sio_ack_table.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace sio;
+
+typedef std::chrono::steady_clock clock_type;
+
+// What socket::impl did before: a static counter and a map under the event mutex.
+class locked_map
+{
+public:
+    locked_map(): m_next_id(1) {}
+
+    unsigned add(socket::ack_listener const& l)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        unsigned id = m_next_id++;
+        m_acks[id] = l;
+        return id;
+    }
+
+    bool complete(unsigned id)
+    {
+        socket::ack_listener l;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            auto it = m_acks.find(id);
+            if(it == m_acks.end()) return false;
+            l.swap(it->second);
+            m_acks.erase(it);
+        }
+        l(socket::ack_ok, message::list());
+        return true;
+    }
+
+private:
+    std::mutex m_mutex;
+    unsigned m_next_id;
+    std::map<unsigned, socket::ack_listener> m_acks;
+};
+
+class lock_free_table
+{
+public:
+    unsigned add(socket::ack_listener const& l)
+    {
+        m_table.acquire(0);
+        unsigned id = m_table.reserve();
+        ack_table::entry e;
+        e.listener = l;
+        e.timer = 0;
+        m_table.publish(id, e);
+        return id;
+    }
+
+    bool complete(unsigned id)
+    {
+        ack_table::entry e;
+        if(!m_table.take(id, e)) return false;
+        e.listener(socket::ack_ok, message::list());
+        return true;
+    }
+
+private:
+    ack_table m_table;
+};
+
+// Each thread keeps a window of acks in flight, like an RPC client does.
+template<typename table_type>
+static double run(unsigned threads, unsigned ops)
+{
+    const unsigned window = 32;
+    table_type table;
+    std::vector<std::thread> workers;
+    clock_type::time_point start = clock_type::now();
+    for(unsigned t = 0; t < threads; ++t)
+    {
+        workers.push_back(std::thread([&table, ops]()
+        {
+            unsigned inflight[window];
+            unsigned done = 0;
+            for(unsigned i = 0; i < ops; ++i)
+            {
+                unsigned& slot = inflight[i % window];
+                if(i >= window)
+                {
+                    table.complete(slot);
+                }
+                slot = table.add([&done](socket::ack_status, message::list const&) { ++done; });
+            }
+            for(unsigned i = 0; i < window && i < ops; ++i)
+            {
+                table.complete(inflight[i]);
+            }
+        }));
+    }
+    for(size_t i = 0; i < workers.size(); ++i)
+    {
+        workers[i].join();
+    }
+    double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    return threads * (double)ops / seconds;
+}
+
+int main(int argc, const char* argv[])
+{
+    unsigned ops = argc > 1 ? (unsigned)atoi(argv[1]) : 200000;
+    std::cout << "acks per thread:" << ops << std::endl;
+    std::cout << "threads\tmutex map ops/s\tack table ops/s" << std::endl;
+    const unsigned counts[] = { 1, 2, 4, 8, 16 };
+    for(unsigned i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+    {
+        double locked = run<locked_map>(counts[i], ops);
+        double lock_free = run<lock_free_table>(counts[i], ops);
+        std::cout << counts[i] << "\t" << (unsigned long long)locked << "\t" << (unsigned long long)lock_free << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,306 @@
+//
+//  sio_codec_bench.cpp
+//
+//  Encodes and decodes representative packets: time, throughput and heap
+//  allocations per operation, as a table or as JSON to compare runs.
+//
+
+#include <internal/sio_packet.h>
+#include <rapidjson/document.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace sio
+{
+    // Defined in sio_packet.cpp, not declared in a header.
+    message::ptr from_json(rapidjson::Value const& value, std::vector<std::shared_ptr<const std::string> > const& buffers);
+}
+
+using namespace sio;
+
+typedef std::chrono::steady_clock clock_type;
+
+// Every heap allocation of the process goes through here.
+static std::atomic<unsigned long long> g_allocations(0);
+
+void* operator new(std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size ? size : 1);
+    if(!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+// A packet as the client emits it and as it arrives, encoded once up front.
+struct payload_case
+{
+    std::string name;
+    std::vector<packet> packets;
+    std::vector<std::string> frames;
+    std::vector<std::vector<std::shared_ptr<const std::string> > > attachments;
+    std::size_t bytes;
+};
+
+struct result
+{
+    std::string payload;
+    std::string op;
+    double ns_per_op;
+    double bytes_per_second;
+    double allocations_per_op;
+};
+
+static message::ptr small_event()
+{
+    message::list l("hello");
+    l.push(int_message::create(42));
+    return l.to_array_message("chat");
+}
+
+static message::ptr nested_object(unsigned depth)
+{
+    message::ptr obj = object_message::create();
+    for(unsigned i = 0; i < 8; ++i)
+    {
+        std::string key = "field" + std::to_string(i);
+        if(depth > 0 && i < 2)
+        {
+            static_cast<object_message*>(obj.get())->insert(key, nested_object(depth - 1));
+        }
+        else if(i % 2)
+        {
+            static_cast<object_message*>(obj.get())->insert(key, int_message::create(i * 1000 + depth));
+        }
+        else
+        {
+            static_cast<object_message*>(obj.get())->insert(key, "value of " + key);
+        }
+    }
+    return obj;
+}
+
+static message::ptr numeric_array()
+{
+    message::ptr arr = array_message::create();
+    for(unsigned i = 0; i < 1024; ++i)
+    {
+        static_cast<array_message*>(arr.get())->push(double_message::create(i * 0.25));
+    }
+    message::list l(arr);
+    return l.to_array_message("samples");
+}
+
+static message::ptr binary_event()
+{
+    message::list l;
+    for(unsigned i = 0; i < 4; ++i)
+    {
+        l.push(std::make_shared<const std::string>(16 * 1024, (char)('a' + i)));
+    }
+    return l.to_array_message("upload");
+}
+
+static payload_case make_case(std::string const& name, std::vector<packet> const& packets)
+{
+    payload_case c;
+    c.name = name;
+    c.packets = packets;
+    c.bytes = 0;
+    packet_manager manager;
+    for(auto it = c.packets.begin(); it != c.packets.end(); ++it)
+    {
+        std::vector<std::shared_ptr<const std::string> > buffers;
+        manager.encode(*it, [&](bool binary, std::shared_ptr<const std::string> const& payload)
+        {
+            if(binary)
+            {
+                buffers.push_back(payload);
+            }
+            else
+            {
+                c.frames.push_back(*payload);
+            }
+            c.bytes += payload->size();
+        });
+        c.attachments.push_back(buffers);
+    }
+    return c;
+}
+
+static std::vector<payload_case> make_cases()
+{
+    std::vector<payload_case> cases;
+    cases.push_back(make_case("small_event", std::vector<packet>(1, packet("/", small_event()))));
+    cases.push_back(make_case("nested_object", std::vector<packet>(1, packet("/", message::list(nested_object(3)).to_array_message("state")))));
+    cases.push_back(make_case("numeric_array", std::vector<packet>(1, packet("/", numeric_array()))));
+    cases.push_back(make_case("binary_attachments", std::vector<packet>(1, packet("/", binary_event()))));
+    std::vector<packet> namespaces;
+    for(int i = 0; i < 64; ++i)
+    {
+        namespaces.push_back(packet("/tenant-" + std::to_string(i) + "/market", small_event(), i));
+    }
+    cases.push_back(make_case("many_namespaces", namespaces));
+    return cases;
+}
+
+// Repeats op, doubling the rounds until a batch takes long enough, and
+// reports the last batch. One round goes over all packets of the case.
+static result measure(payload_case const& c, std::string const& op_name, std::function<void()> const& op)
+{
+    static const double min_seconds = 0.2;
+    for(unsigned i = 0; i < 16; ++i)
+    {
+        op();
+    }
+    unsigned long long rounds = 64;
+    while(true)
+    {
+        unsigned long long allocations = g_allocations.load(std::memory_order_relaxed);
+        clock_type::time_point start = clock_type::now();
+        for(unsigned long long i = 0; i < rounds; ++i)
+        {
+            op();
+        }
+        double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+        allocations = g_allocations.load(std::memory_order_relaxed) - allocations;
+        if(seconds >= min_seconds || rounds >= (1ull << 32))
+        {
+            double ops = (double)rounds * c.packets.size();
+            result r;
+            r.payload = c.name;
+            r.op = op_name;
+            r.ns_per_op = seconds * 1e9 / ops;
+            r.bytes_per_second = c.bytes * (double)rounds / seconds;
+            r.allocations_per_op = allocations / ops;
+            return r;
+        }
+        rounds *= 2;
+    }
+}
+
+static void run_case(payload_case& c, std::vector<result>& results)
+{
+    results.push_back(measure(c, "packet::accept", [&c]()
+    {
+        for(auto it = c.packets.begin(); it != c.packets.end(); ++it)
+        {
+            std::string payload;
+            std::vector<std::shared_ptr<const std::string> > buffers;
+            it->accept(payload, buffers);
+        }
+    }));
+    packet_manager manager;
+    results.push_back(measure(c, "packet_manager::encode", [&c, &manager]()
+    {
+        std::size_t bytes = 0;
+        for(auto it = c.packets.begin(); it != c.packets.end(); ++it)
+        {
+            manager.encode(*it, [&bytes](bool, std::shared_ptr<const std::string> const& payload)
+            {
+                bytes += payload->size();
+            });
+        }
+    }));
+    results.push_back(measure(c, "packet::parse", [&c]()
+    {
+        for(std::size_t i = 0; i < c.frames.size(); ++i)
+        {
+            packet p;
+            if(p.parse(c.frames[i]))
+            {
+                for(auto it = c.attachments[i].begin(); it != c.attachments[i].end(); ++it)
+                {
+                    p.parse_buffer(**it);
+                }
+            }
+        }
+    }));
+    unsigned decoded = 0;
+    manager.set_decode_callback([&decoded](packet const&) { ++decoded; });
+    results.push_back(measure(c, "packet_manager::put_payload", [&c, &manager]()
+    {
+        for(std::size_t i = 0; i < c.frames.size(); ++i)
+        {
+            manager.put_payload(c.frames[i]);
+            for(auto it = c.attachments[i].begin(); it != c.attachments[i].end(); ++it)
+            {
+                manager.put_payload(**it);
+            }
+        }
+    }));
+    //the json of each frame parsed once, from_json alone is timed.
+    std::vector<std::shared_ptr<rapidjson::Document> > docs;
+    for(std::size_t i = 0; i < c.frames.size(); ++i)
+    {
+        std::shared_ptr<rapidjson::Document> doc = std::make_shared<rapidjson::Document>();
+        doc->Parse<0>(c.frames[i].c_str() + c.frames[i].find_first_of("[{"));
+        docs.push_back(doc);
+    }
+    results.push_back(measure(c, "from_json", [&c, &docs]()
+    {
+        for(std::size_t i = 0; i < docs.size(); ++i)
+        {
+            from_json(*docs[i], c.attachments[i]);
+        }
+    }));
+}
+
+int main(int argc, const char* argv[])
+{
+    bool json = argc > 1 && std::strcmp(argv[1], "--json") == 0;
+    std::vector<payload_case> cases = make_cases();
+    std::vector<result> results;
+    for(auto it = cases.begin(); it != cases.end(); ++it)
+    {
+        run_case(*it, results);
+    }
+    if(json)
+    {
+        std::cout << "[" << std::endl;
+        for(std::size_t i = 0; i < results.size(); ++i)
+        {
+            result const& r = results[i];
+            std::cout << "  {\"payload\":\"" << r.payload << "\",\"op\":\"" << r.op
+                      << "\",\"ns_per_op\":" << r.ns_per_op
+                      << ",\"bytes_per_second\":" << r.bytes_per_second
+                      << ",\"allocations_per_op\":" << r.allocations_per_op << "}"
+                      << (i + 1 < results.size() ? "," : "") << std::endl;
+        }
+        std::cout << "]" << std::endl;
+        return 0;
+    }
+    std::cout << "payload\top\tns/op\tMB/s\tallocs/op" << std::endl;
+    for(auto it = results.begin(); it != results.end(); ++it)
+    {
+        std::cout << it->payload << "\t" << it->op << "\t" << (unsigned long long)it->ns_per_op << "\t"
+                  << (unsigned long long)(it->bytes_per_second / 1e6) << "\t" << it->allocations_per_op << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,177 @@
+//
+//  sio_emit_bench.cpp
+//
+//  Hands encoded frames from application threads to a network thread, once
+//  as an io_service closure per frame like the client did and once through
+//  the lock-free ring with a single wakeup.
+//
+
+#include <internal/sio_mpsc_ring.h>
+#include <boost/asio/io_service.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace sio;
+
+typedef std::chrono::steady_clock clock_type;
+
+struct frame
+{
+    std::shared_ptr<const std::string> payload;
+    bool binary;
+};
+
+// Stands in for client_impl::send_impl.
+struct sink
+{
+    sink(): bytes(0), frames(0) {}
+
+    void send(std::shared_ptr<const std::string> const& payload, bool)
+    {
+        bytes += payload->size();
+        frames.fetch_add(1, std::memory_order_release);
+    }
+
+    std::size_t bytes;
+    std::atomic<std::size_t> frames;
+};
+
+class closure_path
+{
+public:
+    closure_path(boost::asio::io_service& io, sink& s): m_io(io), m_sink(s) {}
+
+    void emit(std::shared_ptr<const std::string> const& payload)
+    {
+        m_io.dispatch(std::bind(&sink::send, &m_sink, payload, false));
+    }
+
+private:
+    boost::asio::io_service& m_io;
+    sink& m_sink;
+};
+
+class ring_path
+{
+public:
+    ring_path(boost::asio::io_service& io, sink& s): m_io(io), m_sink(s), m_ring(4096), m_pending(false) {}
+
+    void emit(std::shared_ptr<const std::string> const& payload)
+    {
+        frame f;
+        f.payload = payload;
+        f.binary = false;
+        while(!m_ring.push(f))
+        {
+            std::this_thread::yield();
+        }
+        if(!m_pending.exchange(true))
+        {
+            m_io.post(std::bind(&ring_path::flush, this));
+        }
+    }
+
+private:
+    void flush()
+    {
+        m_pending.store(false);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        frame f;
+        while(m_ring.pop(f))
+        {
+            m_sink.send(f.payload, f.binary);
+        }
+    }
+
+    boost::asio::io_service& m_io;
+    sink& m_sink;
+    mpsc_ring<frame> m_ring;
+    std::atomic<bool> m_pending;
+};
+
+struct result
+{
+    double frames_per_second;
+    double avg_ns;
+    double p99_ns;
+};
+
+template<typename path_type>
+static result run(unsigned threads, unsigned frames)
+{
+    boost::asio::io_service io;
+    std::unique_ptr<boost::asio::io_service::work> work(new boost::asio::io_service::work(io));
+    std::thread network([&io]() { io.run(); });
+    sink s;
+    path_type path(io, s);
+    std::shared_ptr<const std::string> payload = std::make_shared<const std::string>("42[\"message\",\"hello\"]");
+    std::vector<std::vector<unsigned> > latencies(threads);
+    std::vector<std::thread> producers;
+    clock_type::time_point start = clock_type::now();
+    for(unsigned t = 0; t < threads; ++t)
+    {
+        producers.push_back(std::thread([&, t]()
+        {
+            std::vector<unsigned>& samples = latencies[t];
+            samples.reserve(frames);
+            for(unsigned i = 0; i < frames; ++i)
+            {
+                clock_type::time_point before = clock_type::now();
+                path.emit(payload);
+                samples.push_back((unsigned)std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - before).count());
+            }
+        }));
+    }
+    for(size_t i = 0; i < producers.size(); ++i)
+    {
+        producers[i].join();
+    }
+    while(s.frames.load(std::memory_order_acquire) < (std::size_t)threads * frames)
+    {
+        std::this_thread::yield();
+    }
+    double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    work.reset();
+    network.join();
+
+    std::vector<unsigned> all;
+    for(size_t i = 0; i < latencies.size(); ++i)
+    {
+        all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+    }
+    std::sort(all.begin(), all.end());
+    double total = 0;
+    for(size_t i = 0; i < all.size(); ++i)
+    {
+        total += all[i];
+    }
+    result r;
+    r.frames_per_second = all.size() / seconds;
+    r.avg_ns = total / all.size();
+    r.p99_ns = all[all.size() * 99 / 100];
+    return r;
+}
+
+int main(int argc, const char* argv[])
+{
+    unsigned frames = argc > 1 ? (unsigned)atoi(argv[1]) : 200000;
+    std::cout << "frames per thread:" << frames << std::endl;
+    std::cout << "threads\tpath\tframes/s\tavg emit ns\tp99 emit ns" << std::endl;
+    const unsigned counts[] = { 1, 2, 4, 8 };
+    for(unsigned i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+    {
+        result closure = run<closure_path>(counts[i], frames);
+        result ring = run<ring_path>(counts[i], frames);
+        std::cout << counts[i] << "\tclosure\t" << (unsigned long long)closure.frames_per_second << "\t" << closure.avg_ns << "\t" << closure.p99_ns << std::endl;
+        std::cout << counts[i] << "\tring\t" << (unsigned long long)ring.frames_per_second << "\t" << ring.avg_ns << "\t" << ring.p99_ns << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,208 @@
+//
+//  sio_reconnect_bench.cpp
+//
+//  Simulates a mass reconnect against a loopback stand-in server and reports
+//  the peak connect rate the server sees with each jitter mode.
+//
+
+#include <internal/sio_backoff.h>
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using boost::asio::ip::tcp;
+using namespace sio;
+
+typedef std::chrono::steady_clock clock_type;
+
+// Delays are scaled down from the client defaults (5s/25s) to keep a run short.
+static const unsigned kDELAY = 500;
+static const unsigned kDELAY_MAX = 2500;
+static const unsigned kOUTAGE = 1000;
+static const unsigned kHANDSHAKE = 20;
+static const unsigned kBUCKET = 50;
+
+struct run_result
+{
+    unsigned peak_per_sec;
+    unsigned attempts;
+    unsigned settle_ms;
+};
+
+// Server which refuses (closes right away) during the outage and completes a
+// "handshake" by writing one byte after kHANDSHAKE ms afterwards.
+class stand_in_server
+{
+public:
+    stand_in_server(boost::asio::io_service& io, clock_type::time_point start):
+        m_io(io),
+        m_acceptor(io, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+        m_start(start)
+    {
+        m_acceptor.listen(4096);
+        this->accept();
+    }
+
+    unsigned short port() const { return m_acceptor.local_endpoint().port(); }
+
+    void stop() { m_acceptor.close(); }
+
+    unsigned peak_per_sec() const
+    {
+        unsigned peak = m_buckets.empty() ? 0 : *std::max_element(m_buckets.begin(), m_buckets.end());
+        return peak * 1000 / kBUCKET;
+    }
+
+private:
+    void accept()
+    {
+        std::shared_ptr<tcp::socket> s = std::make_shared<tcp::socket>(m_io);
+        m_acceptor.async_accept(*s, [this, s](boost::system::error_code const& ec)
+        {
+            if (ec) return;
+            unsigned elapsed = (unsigned)std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - m_start).count();
+            if (m_buckets.size() <= elapsed / kBUCKET) m_buckets.resize(elapsed / kBUCKET + 1);
+            m_buckets[elapsed / kBUCKET]++;
+            if (elapsed < kOUTAGE) {
+                s->close();
+            }
+            else {
+                std::shared_ptr<boost::asio::deadline_timer> t = std::make_shared<boost::asio::deadline_timer>(m_io);
+                t->expires_from_now(boost::posix_time::milliseconds(kHANDSHAKE));
+                t->async_wait([s, t](boost::system::error_code const&)
+                {
+                    static const char byte = 0;
+                    boost::system::error_code ec;
+                    boost::asio::write(*s, boost::asio::buffer(&byte, 1), ec);
+                    s->close();
+                });
+            }
+            this->accept();
+        });
+    }
+
+    boost::asio::io_service& m_io;
+    tcp::acceptor m_acceptor;
+    clock_type::time_point m_start;
+    std::vector<unsigned> m_buckets;
+};
+
+// One reconnecting client, mirrors client_impl: backoff delay, gate slot, attempt.
+class sim_client : public std::enable_shared_from_this<sim_client>
+{
+public:
+    sim_client(boost::asio::io_service& io, reconnect_gate& gate, client::reconnect_jitter jitter, unsigned seed, tcp::endpoint ep, unsigned& connected, unsigned& attempts):
+        m_io(io), m_gate(gate), m_timer(io), m_socket(io), m_endpoint(ep), m_made(0), m_ticket(0), m_connected(connected), m_attempts(attempts)
+    {
+        m_backoff.set_jitter(jitter);
+        m_backoff.seed(seed);
+    }
+
+    void schedule()
+    {
+        std::shared_ptr<sim_client> self = shared_from_this();
+        m_timer.expires_from_now(boost::posix_time::milliseconds(m_backoff.next_delay(m_made, kDELAY, kDELAY_MAX)));
+        m_timer.async_wait([self](boost::system::error_code const&)
+        {
+            self->m_ticket = self->m_gate.acquire([self]()
+            {
+                self->m_io.post([self]() { self->attempt(); });
+            });
+        });
+    }
+
+private:
+    void attempt()
+    {
+        std::shared_ptr<sim_client> self = shared_from_this();
+        ++m_attempts;
+        m_made++;
+        m_socket.async_connect(m_endpoint, [self](boost::system::error_code const& ec)
+        {
+            if (ec) {
+                self->failed();
+                return;
+            }
+            boost::asio::async_read(self->m_socket, boost::asio::buffer(self->m_byte, 1), [self](boost::system::error_code const& ec, size_t)
+            {
+                if (ec) {
+                    self->failed();
+                    return;
+                }
+                self->m_gate.release(self->m_ticket);
+                self->m_socket.close();
+                ++self->m_connected;
+            });
+        });
+    }
+
+    void failed()
+    {
+        m_gate.release(m_ticket);
+        m_socket.close();
+        this->schedule();
+    }
+
+    boost::asio::io_service& m_io;
+    reconnect_gate& m_gate;
+    boost::asio::deadline_timer m_timer;
+    tcp::socket m_socket;
+    tcp::endpoint m_endpoint;
+    backoff m_backoff;
+    unsigned m_made;
+    reconnect_gate::ticket m_ticket;
+    char m_byte[1];
+    unsigned& m_connected;
+    unsigned& m_attempts;
+};
+
+run_result run(unsigned clients, client::reconnect_jitter jitter, unsigned cap)
+{
+    boost::asio::io_service io;
+    reconnect_gate gate;
+    gate.set_limit(cap);
+    clock_type::time_point start = clock_type::now();
+    stand_in_server server(io, start);
+    tcp::endpoint ep(boost::asio::ip::address_v4::loopback(), server.port());
+    unsigned connected = 0, attempts = 0;
+    run_result result;
+    result.settle_ms = 0;
+    for (unsigned i = 0; i < clients; ++i) {
+        std::make_shared<sim_client>(io, gate, jitter, i + 1, ep, connected, attempts)->schedule();
+    }
+    boost::asio::deadline_timer watch(io);
+    std::function<void(boost::system::error_code const&)> check = [&](boost::system::error_code const&)
+    {
+        if (connected == clients) {
+            result.settle_ms = (unsigned)std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - start).count();
+            server.stop();
+            return;
+        }
+        watch.expires_from_now(boost::posix_time::milliseconds(10));
+        watch.async_wait(check);
+    };
+    check(boost::system::error_code());
+    io.run();
+    result.peak_per_sec = server.peak_per_sec();
+    result.attempts = attempts;
+    return result;
+}
+
+int main(int argc, const char* argv[])
+{
+    unsigned clients = argc > 1 ? (unsigned)atoi(argv[1]) : 1000;
+    unsigned cap = argc > 2 ? (unsigned)atoi(argv[2]) : 0;
+    const char* names[] = { "none", "full", "decorrelated" };
+    client::reconnect_jitter modes[] = { client::jitter_none, client::jitter_full, client::jitter_decorrelated };
+    std::cout << "clients:" << clients << " cap:" << cap << " outage:" << kOUTAGE << "ms delay:" << kDELAY << "-" << kDELAY_MAX << "ms" << std::endl;
+    std::cout << "jitter\tpeak connects/s\tattempts\tall connected after ms" << std::endl;
+    for (int i = 0; i < 3; ++i) {
+        run_result r = run(clients, modes[i], cap);
+        std::cout << names[i] << "\t" << r.peak_per_sec << "\t" << r.attempts << "\t" << r.settle_ms << std::endl;
+    }
+    return 0;
+}
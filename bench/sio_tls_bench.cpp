@@ -0,0 +1,185 @@
+//
+//  sio_tls_bench.cpp
+//
+//  Reconnects to a local TLS echo server and compares a fresh context per
+//  connection with the shared context and session cache the client uses.
+//
+
+#ifndef SIO_TLS
+#define SIO_TLS 1
+#endif
+#include <internal/sio_tls.h>
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <openssl/x509.h>
+#include <openssl/evp.h>
+#include <openssl/ec.h>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+using boost::asio::ip::tcp;
+namespace ssl = boost::asio::ssl;
+using namespace sio;
+
+typedef std::chrono::steady_clock clock_type;
+
+// Self signed P-256 certificate, the client doesn't verify it (as sio doesn't).
+static void use_generated_certificate(ssl::context& ctx)
+{
+    EVP_PKEY_CTX* kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+    EVP_PKEY_keygen_init(kctx);
+    EVP_PKEY_CTX_set_ec_paramgen_curve_nid(kctx, NID_X9_62_prime256v1);
+    EVP_PKEY* pkey = NULL;
+    EVP_PKEY_keygen(kctx, &pkey);
+    EVP_PKEY_CTX_free(kctx);
+    X509* cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_get_notBefore(cert), 0);
+    X509_gmtime_adj(X509_get_notAfter(cert), 3600);
+    X509_set_pubkey(cert, pkey);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"localhost", -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    X509_sign(cert, pkey, EVP_sha256());
+    SSL_CTX_use_certificate(ctx.native_handle(), cert);
+    SSL_CTX_use_PrivateKey(ctx.native_handle(), pkey);
+    X509_free(cert);
+    EVP_PKEY_free(pkey);
+}
+
+// Accepts, completes the handshake and echoes one byte per connection.
+class echo_server
+{
+public:
+    echo_server(boost::asio::io_service& io):
+        m_io(io),
+        m_ctx(ssl::context::sslv23_server),
+        m_acceptor(io, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0))
+    {
+        use_generated_certificate(m_ctx);
+        SSL_CTX_set_session_id_context(m_ctx.native_handle(), (const unsigned char*)"sio", 3);
+        this->accept();
+    }
+
+    unsigned short port() const { return m_acceptor.local_endpoint().port(); }
+
+    void stop() { m_acceptor.close(); }
+
+private:
+    typedef ssl::stream<tcp::socket> stream;
+
+    void accept()
+    {
+        std::shared_ptr<stream> s = std::make_shared<stream>(m_io, m_ctx);
+        m_acceptor.async_accept(s->lowest_layer(), [this, s](boost::system::error_code const& ec)
+        {
+            if (ec) return;
+            s->async_handshake(ssl::stream_base::server, [s](boost::system::error_code const& ec)
+            {
+                if (ec) return;
+                std::shared_ptr<char> byte = std::make_shared<char>(0);
+                boost::asio::async_read(*s, boost::asio::buffer(byte.get(), 1), [s, byte](boost::system::error_code const& ec, size_t)
+                {
+                    if (ec) return;
+                    boost::asio::async_write(*s, boost::asio::buffer(byte.get(), 1), [s, byte](boost::system::error_code const&, size_t) {});
+                });
+            });
+            this->accept();
+        });
+    }
+
+    boost::asio::io_service& m_io;
+    ssl::context m_ctx;
+    tcp::acceptor m_acceptor;
+};
+
+struct run_result
+{
+    double avg_handshake_us;
+    unsigned handshakes;
+    unsigned resumed;
+};
+
+// One connection: handshake, echo a byte so TLS 1.3 tickets get read, then
+// drop without close_notify like a broken network would.
+static bool connect_once(boost::asio::io_service& io, ssl::context& ctx, tls_session_cache* cache, unsigned short port,
+                         clock_type::duration& handshake, bool& resumed)
+{
+    ssl::stream<tcp::socket> s(io, ctx);
+    boost::system::error_code ec;
+    s.lowest_layer().connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), port), ec);
+    if (ec) return false;
+    SSL_set_tlsext_host_name(s.native_handle(), "localhost");
+    if (cache) cache->prepare(s.native_handle());
+    clock_type::time_point start = clock_type::now();
+    s.handshake(ssl::stream_base::client, ec);
+    handshake = clock_type::now() - start;
+    if (ec) return false;
+    if (cache) cache->handshake_done(s.native_handle(), handshake);
+    resumed = SSL_session_reused(s.native_handle()) != 0;
+    char byte = 1;
+    boost::asio::write(s, boost::asio::buffer(&byte, 1), ec);
+    boost::asio::read(s, boost::asio::buffer(&byte, 1), ec);
+    s.lowest_layer().close(ec);
+    return !ec;
+}
+
+static run_result run(unsigned short port, unsigned connects, bool reuse, int max_version)
+{
+    boost::asio::io_service io;
+    tls_session_cache cache;
+    tls_session_cache::context_ptr shared = cache.create_context();
+    SSL_CTX_set_max_proto_version(shared->native_handle(), max_version);
+    run_result result = run_result();
+    clock_type::duration total = clock_type::duration::zero();
+    for (unsigned i = 0; i < connects; ++i) {
+        clock_type::duration handshake;
+        bool resumed = false;
+        bool ok;
+        if (reuse) {
+            ok = connect_once(io, *shared, &cache, port, handshake, resumed);
+        }
+        else {
+            // What the client did before: a new context for every connection.
+            ssl::context fresh(ssl::context::sslv23_client);
+            SSL_CTX_set_max_proto_version(fresh.native_handle(), max_version);
+            ok = connect_once(io, fresh, nullptr, port, handshake, resumed);
+        }
+        if (!ok) continue;
+        result.handshakes++;
+        result.resumed += resumed ? 1 : 0;
+        total += handshake;
+    }
+    if (result.handshakes > 0) {
+        result.avg_handshake_us = std::chrono::duration_cast<std::chrono::microseconds>(total).count() / (double)result.handshakes;
+    }
+    return result;
+}
+
+int main(int argc, const char* argv[])
+{
+    unsigned connects = argc > 1 ? (unsigned)atoi(argv[1]) : 200;
+    boost::asio::io_service server_io;
+    echo_server server(server_io);
+    std::thread server_thread([&server_io]() { server_io.run(); });
+
+    std::cout << "connects:" << connects << std::endl;
+    std::cout << "tls\tcontext\tavg handshake us\tresumed" << std::endl;
+    const int versions[] = { TLS1_2_VERSION, TLS1_3_VERSION };
+    const char* version_names[] = { "1.2", "1.3" };
+    for (int v = 0; v < 2; ++v) {
+        for (int reuse = 0; reuse < 2; ++reuse) {
+            run_result r = run(server.port(), connects, reuse != 0, versions[v]);
+            std::cout << version_names[v] << "\t" << (reuse ? "shared" : "fresh") << "\t" << r.avg_handshake_us << "\t"
+                      << r.resumed << "/" << r.handshakes << std::endl;
+        }
+    }
+    server_io.post([&server]() { server.stop(); });
+    server_io.stop();
+    server_thread.join();
+    return 0;
+}
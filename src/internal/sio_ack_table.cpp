@@ -0,0 +1,212 @@
+//
+//  sio_ack_table.cpp
+//
+//  Lock-free table of the acks a socket waits for, keyed by packet id.
+//
+
+#include "sio_ack_table.h"
+#include <thread>
+
+namespace sio
+{
+    namespace
+    {
+        // Ids probed for a free slot before falling back to the overflow map.
+        const unsigned kPROBES = 8;
+    }
+
+    ack_table::ack_table(unsigned slots):
+        m_next_id(1),
+        m_count(0),
+        m_overflow_count(0)
+    {
+        unsigned size = 16;
+        while(size < slots && size < (1u << 20))
+        {
+            size <<= 1;
+        }
+        m_slots.reset(new slot[size]);
+        for(unsigned i = 0; i < size; ++i)
+        {
+            m_slots[i].key.store(0, std::memory_order_relaxed);
+            m_slots[i].value.timer = 0;
+        }
+        m_mask = size - 1;
+    }
+
+    bool ack_table::acquire(std::size_t max)
+    {
+        if(max == 0)
+        {
+            m_count.fetch_add(1);
+            return true;
+        }
+        std::size_t count = m_count.load();
+        while(count < max)
+        {
+            if(m_count.compare_exchange_weak(count, count + 1))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ack_table::release()
+    {
+        m_count.fetch_sub(1);
+    }
+
+    unsigned ack_table::next_id()
+    {
+        //packet ids are ints on the wire, stay positive and skip 0.
+        unsigned id;
+        do
+        {
+            id = m_next_id.fetch_add(1, std::memory_order_relaxed) & ~kBUSY;
+        }
+        while(id == 0);
+        return id;
+    }
+
+    unsigned ack_table::reserve()
+    {
+        for(unsigned i = 0; i < kPROBES; ++i)
+        {
+            unsigned id = this->next_id();
+            unsigned expected = 0;
+            if(m_slots[id & m_mask].key.compare_exchange_strong(expected, id | kBUSY, std::memory_order_acquire))
+            {
+                return id;
+            }
+        }
+        //slots are crowded, publish puts it in the overflow map.
+        return this->next_id();
+    }
+
+    void ack_table::publish(unsigned id, entry& e)
+    {
+        slot& s = m_slots[id & m_mask];
+        if(s.key.load(std::memory_order_relaxed) == (id | kBUSY))
+        {
+            s.value.listener.swap(e.listener);
+            s.value.timer = e.timer;
+            s.value.trace.swap(e.trace);
+            s.key.store(id, std::memory_order_release);
+            return;
+        }
+        std::lock_guard<std::mutex> guard(m_overflow_mutex);
+        entry& stored = m_overflow[id];
+        stored.listener.swap(e.listener);
+        stored.timer = e.timer;
+        stored.trace.swap(e.trace);
+        m_overflow_count.fetch_add(1);
+    }
+
+    bool ack_table::set_timer(unsigned id, timer_wheel::timer_id timer)
+    {
+        slot& s = m_slots[id & m_mask];
+        unsigned key = s.key.load(std::memory_order_relaxed);
+        while(key == id || key == (id | kBUSY))
+        {
+            if(key == id)
+            {
+                if(s.key.compare_exchange_weak(key, id | kBUSY, std::memory_order_acquire))
+                {
+                    s.value.timer = timer;
+                    s.key.store(id, std::memory_order_release);
+                    return true;
+                }
+            }
+            else
+            {
+                std::this_thread::yield();
+                key = s.key.load(std::memory_order_relaxed);
+            }
+        }
+        if(m_overflow_count.load() == 0)
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> guard(m_overflow_mutex);
+        auto it = m_overflow.find(id);
+        if(it == m_overflow.end())
+        {
+            return false;
+        }
+        it->second.timer = timer;
+        return true;
+    }
+
+    bool ack_table::take(unsigned id, entry& e)
+    {
+        slot& s = m_slots[id & m_mask];
+        unsigned key = s.key.load(std::memory_order_relaxed);
+        while(key == id || key == (id | kBUSY))
+        {
+            if(key == id)
+            {
+                if(s.key.compare_exchange_weak(key, id | kBUSY, std::memory_order_acquire))
+                {
+                    e.listener.swap(s.value.listener);
+                    e.timer = s.value.timer;
+                    e.trace.swap(s.value.trace);
+                    s.value.listener = nullptr;
+                    s.value.timer = 0;
+                    s.value.trace.reset();
+                    s.key.store(0, std::memory_order_release);
+                    m_count.fetch_sub(1);
+                    return true;
+                }
+            }
+            else
+            {
+                //being published or taken, that's a few stores away.
+                std::this_thread::yield();
+                key = s.key.load(std::memory_order_relaxed);
+            }
+        }
+        if(m_overflow_count.load() == 0)
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> guard(m_overflow_mutex);
+        auto it = m_overflow.find(id);
+        if(it == m_overflow.end())
+        {
+            return false;
+        }
+        e.listener.swap(it->second.listener);
+        e.timer = it->second.timer;
+        e.trace.swap(it->second.trace);
+        m_overflow.erase(it);
+        m_overflow_count.fetch_sub(1);
+        m_count.fetch_sub(1);
+        return true;
+    }
+
+    void ack_table::take_all(std::vector<entry>& entries)
+    {
+        for(unsigned i = 0; i <= m_mask; ++i)
+        {
+            unsigned key = m_slots[i].key.load(std::memory_order_relaxed);
+            if(key != 0)
+            {
+                //a busy slot is being published or taken, take waits for it.
+                entry e;
+                if(this->take(key & ~kBUSY, e))
+                {
+                    entries.push_back(e);
+                }
+            }
+        }
+        std::lock_guard<std::mutex> guard(m_overflow_mutex);
+        for(auto it = m_overflow.begin(); it != m_overflow.end(); ++it)
+        {
+            entries.push_back(it->second);
+            m_count.fetch_sub(1);
+        }
+        m_overflow.clear();
+        m_overflow_count.store(0);
+    }
+}
@@ -0,0 +1,86 @@
+//
+//  sio_ack_table.h
+//
+//  Lock-free table of the acks a socket waits for, keyed by packet id.
+//
+
+#ifndef SIO_ACK_TABLE_H
+#define SIO_ACK_TABLE_H
+
+#include "../sio_client.h"
+#include "sio_timer_wheel.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace sio
+{
+    // Ids come from a per table counter and pick their slot (id & mask), an id
+    // whose slot is taken is skipped. Registering and completing an ack is a
+    // CAS on the slot's key, the entry itself is only touched by whoever holds
+    // the slot's busy bit. When no free slot is found the ack goes to an
+    // overflow map under a mutex.
+    class ack_table
+    {
+    public:
+        struct entry
+        {
+            socket::ack_listener listener;
+            timer_wheel::timer_id timer;
+            // Of a traced emit, finished when the ack fails.
+            std::shared_ptr<emit_trace> trace;
+        };
+
+        explicit ack_table(unsigned slots = 1024);
+
+        // Counts an ack in unless max (0 for no cap) are pending, call
+        // reserve next or release on failure.
+        bool acquire(std::size_t max);
+
+        void release();
+
+        // Allocates a packet id, the ack can't be found until it's published.
+        unsigned reserve();
+
+        void publish(unsigned id, entry& e);
+
+        // Stores the timeout timer of a published ack, false if it was taken
+        // meanwhile.
+        bool set_timer(unsigned id, timer_wheel::timer_id timer);
+
+        // Removes the ack, false if it isn't pending (anymore).
+        bool take(unsigned id, entry& e);
+
+        void take_all(std::vector<entry>& entries);
+
+        std::size_t size() const { return m_count; }
+
+    private:
+        static const unsigned kBUSY = 0x80000000;
+
+        struct slot
+        {
+            std::atomic<unsigned> key; // 0 free, id, or id | kBUSY while it changes hands
+            entry value;
+        };
+
+        unsigned next_id();
+
+        std::unique_ptr<slot[]> m_slots;
+
+        unsigned m_mask;
+
+        std::atomic<unsigned> m_next_id;
+
+        std::atomic<std::size_t> m_count;
+
+        std::mutex m_overflow_mutex;
+
+        std::map<unsigned, entry> m_overflow;
+
+        std::atomic<std::size_t> m_overflow_count;
+    };
+}
+#endif // SIO_ACK_TABLE_H
@@ -0,0 +1,116 @@
+//
+//  sio_backoff.cpp
+//
+//  Reconnect delays and the process wide cap on concurrent reconnects.
+//
+
+#include "sio_backoff.h"
+#include <algorithm>
+#include <cmath>
+
+namespace sio
+{
+    backoff::backoff():
+        m_jitter(client::jitter_none),
+        m_random(std::random_device()()),
+        m_last_delay(0)
+    {
+    }
+
+    unsigned backoff::next_delay(unsigned attempts_made, unsigned delay, unsigned delay_max)
+    {
+        unsigned reconn_made = std::min<unsigned>(attempts_made,32);//protect the pow result to be too big.
+        unsigned base = static_cast<unsigned>(std::min<double>(delay * std::pow(1.5,reconn_made),delay_max));
+        switch(m_jitter)
+        {
+        case client::jitter_full:
+        {
+            //uniformly anywhere below the exponential delay.
+            std::uniform_int_distribution<unsigned> dist(0,base);
+            return dist(m_random);
+        }
+        case client::jitter_decorrelated:
+        {
+            //grows from the previous delay instead of the attempt count.
+            unsigned last = std::max(m_last_delay,delay);
+            unsigned upper = static_cast<unsigned>(std::min<double>(last * 3.0,delay_max));
+            std::uniform_int_distribution<unsigned> dist(std::min(delay,upper),upper);
+            m_last_delay = dist(m_random);
+            return m_last_delay;
+        }
+        case client::jitter_none:
+        default:
+            return base;
+        }
+    }
+
+    reconnect_gate& reconnect_gate::global()
+    {
+        static reconnect_gate s_gate;
+        return s_gate;
+    }
+
+    reconnect_gate::reconnect_gate():
+        m_limit(0),
+        m_next_ticket(1)
+    {
+    }
+
+    void reconnect_gate::set_limit(unsigned limit)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_limit = limit;
+        this->grant_waiting();
+    }
+
+    unsigned reconnect_gate::get_limit() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_limit;
+    }
+
+    reconnect_gate::ticket reconnect_gate::acquire(std::function<void()> const& grant)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        ticket t = m_next_ticket++;
+        m_waiting.push_back(std::make_pair(t,grant));
+        this->grant_waiting();
+        return t;
+    }
+
+    void reconnect_gate::release(ticket t)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if(m_active.erase(t) == 0)
+        {
+            for(auto it = m_waiting.begin();it!=m_waiting.end();++it)
+            {
+                if(it->first == t)
+                {
+                    m_waiting.erase(it);
+                    break;
+                }
+            }
+            return;
+        }
+        this->grant_waiting();
+    }
+
+    unsigned reconnect_gate::active() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return static_cast<unsigned>(m_active.size());
+    }
+
+    void reconnect_gate::grant_waiting()
+    {
+        while(!m_waiting.empty() && (m_limit == 0 || m_active.size() < m_limit))
+        {
+            m_active.insert(m_waiting.front().first);
+            std::function<void()> grant;
+            grant.swap(m_waiting.front().second);
+            m_waiting.pop_front();
+            grant();
+        }
+    }
+}
@@ -0,0 +1,84 @@
+//
+//  sio_backoff.h
+//
+//  Reconnect delays and the process wide cap on concurrent reconnects.
+//
+
+#ifndef SIO_BACKOFF_H
+#define SIO_BACKOFF_H
+
+#include <functional>
+#include <list>
+#include <mutex>
+#include <random>
+#include <set>
+#include "../sio_client.h"
+
+namespace sio
+{
+    // Computes the delay before each reconnect attempt. The exponential base
+    // grows by 1.5 per attempt and is capped by delay_max, jitter spreads the
+    // attempts of many clients so they don't hit a recovering server in lockstep.
+    class backoff
+    {
+    public:
+        backoff();
+
+        void set_jitter(client::reconnect_jitter jitter) { m_jitter = jitter; }
+
+        client::reconnect_jitter get_jitter() const { return m_jitter; }
+
+        void seed(unsigned seed) { m_random.seed(seed); }
+
+        unsigned next_delay(unsigned attempts_made, unsigned delay, unsigned delay_max);
+
+        // Forgets the last delay, called once a connection succeeded.
+        void reset() { m_last_delay = 0; }
+
+    private:
+        client::reconnect_jitter m_jitter;
+
+        std::mt19937 m_random;
+
+        unsigned m_last_delay;
+    };
+
+    // Limits how many clients of the process run a reconnect attempt at the same
+    // time, other attempts wait for a slot. A limit of 0 means no limit.
+    class reconnect_gate
+    {
+    public:
+        typedef unsigned long ticket;
+
+        static reconnect_gate& global();
+
+        reconnect_gate();
+
+        void set_limit(unsigned limit);
+
+        unsigned get_limit() const;
+
+        // Invokes grant as soon as a slot is free, possibly before returning.
+        // grant runs with the gate locked and should only post work.
+        ticket acquire(std::function<void()> const& grant);
+
+        // Gives the slot back, or withdraws the request if still waiting.
+        void release(ticket t);
+
+        unsigned active() const;
+
+    private:
+        void grant_waiting();
+
+        mutable std::mutex m_mutex;
+
+        unsigned m_limit;
+
+        ticket m_next_ticket;
+
+        std::set<ticket> m_active;
+
+        std::list<std::pair<ticket, std::function<void()> > > m_waiting;
+    };
+}
+#endif // SIO_BACKOFF_H
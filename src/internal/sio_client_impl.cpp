@@ -10,37 +10,75 @@
 #include <sstream>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <mutex>
-#include <cmath>
-// Comment this out to disable handshake logging to stdout
-#if DEBUG || _DEBUG
-#define LOG(x) std::cout << x
-#else
-#define LOG(x)
-#endif
+#include "sio_log.h"
 
 using boost::posix_time::milliseconds;
 using namespace std;
 
 namespace sio
 {
+    namespace
+    {
+        std::size_t size_of(outbound_packet const& op)
+        {
+            std::size_t bytes = op.payload->size();
+            for(auto it = op.attachments.begin(); it != op.attachments.end(); ++it)
+            {
+                bytes += (*it)->size();
+            }
+            return bytes;
+        }
+    }
+
     /*************************public:*************************/
     client_impl::client_impl() :
+        m_alog_stream(logger::level_info),
+        m_elog_stream(logger::level_error),
         m_ping_interval(0),
         m_ping_timeout(0),
+        m_max_payload(0),
+        m_transport(client::transport_websocket),
+        m_upgrade(true),
+        m_recovery(false),
+        m_upgrading(false),
+        m_resolving(false),
+        m_connect_id(0),
+        m_open_timeout(20000),
+        m_open_timer(0),
+        m_handshake_timeout(5000),
         m_network_thread(),
+        m_has_network_thread(false),
+        m_ping_timeout_timer(0),
+        m_rtt_pending(false),
+        m_rtt(0),
+        m_decode_timed(false),
+        m_reconn_timer(0),
         m_con_state(con_closed),
         m_reconn_delay(5000),
         m_reconn_delay_max(25000),
         m_reconn_attempts(0xFFFFFFFF),
-        m_reconn_made(0)
+        m_reconn_made(0),
+        m_reconn_ticket(0),
+        m_outbound(4096),
+        m_flush_pending(false),
+        m_scheduler(lane_count),
+        m_pacing_timer(0),
+        m_outbound_bytes(0),
+        m_transport_bytes(0),
+        m_buffered_update_pending(false),
+        m_volatile_limit(64 * 1024)
     {
         using websocketpp::log::alevel;
 #ifndef DEBUG
         m_client.clear_access_channels(alevel::all);
         m_client.set_access_channels(alevel::connect|alevel::disconnect|alevel::app);
 #endif
+        m_client.get_alog().set_ostream(&m_alog_stream);
+        m_client.get_elog().set_ostream(&m_elog_stream);
         // Initialize the Asio transport policy
         m_client.init_asio();
+        m_endpoint_cache.reset(new endpoint_cache(m_client.get_io_service()));
+        m_timer_wheel.reset(new timer_wheel(m_client.get_io_service()));
 
         // Bind the clients we are using
         using websocketpp::lib::placeholders::_1;
@@ -49,12 +87,13 @@ namespace sio
         m_client.set_close_handler(lib::bind(&client_impl::on_close,this,_1));
         m_client.set_fail_handler(lib::bind(&client_impl::on_fail,this,_1));
         m_client.set_message_handler(lib::bind(&client_impl::on_message,this,_1,_2));
+        m_client.set_pong_handler(lib::bind(&client_impl::on_ws_pong,this,_1,_2));
 #if SIO_TLS
         m_client.set_tls_init_handler(lib::bind(&client_impl::on_tls_init,this,_1));
+        m_client.set_tcp_pre_init_handler(lib::bind(&client_impl::on_tcp_pre_init,this,_1));
+        m_client.set_tcp_post_init_handler(lib::bind(&client_impl::on_tcp_post_init,this,_1));
 #endif
         m_packet_mgr.set_decode_callback(lib::bind(&client_impl::on_decode,this,_1));
-
-        m_packet_mgr.set_encode_callback(lib::bind(&client_impl::on_encode,this,_1,_2));
     }
     
     client_impl::~client_impl()
@@ -65,13 +104,11 @@ namespace sio
     
     void client_impl::connect(const string& uri, const map<string,string>& query, const map<string, string>& headers)
     {
-        if(m_reconn_timer)
-        {
-            m_reconn_timer->cancel();
-            m_reconn_timer.reset();
-        }
         if(m_network_thread)
         {
+            //the reconnect timer and slot belong to the network thread. A
+            //reconnect waiting for a slot keeps the loop running until given up.
+            m_client.get_io_service().post(lib::bind(&client_impl::abort_reconnect,this));
             if(m_con_state == con_closing||m_con_state == con_closed)
             {
                 //if client is closing, join to wait.
@@ -79,6 +116,7 @@ namespace sio
                 //but in closed case,join will return immediately.
                 m_network_thread->join();
                 m_network_thread.reset();//defensive
+                m_has_network_thread.store(false, std::memory_order_release);
             }
             else
             {
@@ -86,6 +124,8 @@ namespace sio
                 return;
             }
         }
+        //no network thread anymore, whatever the posted call didn't get to.
+        this->abort_reconnect();
         m_con_state = con_opening;
         m_base_url = uri;
         m_reconn_made = 0;
@@ -104,6 +144,7 @@ namespace sio
 
         this->reset_states();
         m_client.get_io_service().dispatch(lib::bind(&client_impl::connect_impl,this,uri,m_query_string));
+        m_has_network_thread.store(true, std::memory_order_release);
         m_network_thread.reset(new thread(lib::bind(&client_impl::run_loop,this)));//uri lifecycle?
 
     }
@@ -154,13 +195,126 @@ namespace sio
         {
             m_network_thread->join();
             m_network_thread.reset();
+            m_has_network_thread.store(false, std::memory_order_release);
         }
     }
 
     /*************************protected:*************************/
-    void client_impl::send(packet& p)
+    void client_impl::send(packet& p, unsigned lane, outbound_flow* flow, std::chrono::steady_clock::time_point not_before,
+                           std::shared_ptr<emit_trace> const& trace)
+    {
+        outbound_packet op;
+        op.lane = lane;
+        op.flow = flow;
+        op.not_before = not_before;
+        this->encode(p, op);
+        if(trace)
+        {
+            trace->encoded = std::chrono::steady_clock::now();
+            op.trace = trace;
+        }
+        this->send(op);
+    }
+
+    void client_impl::encode(packet& p, outbound_packet& op) const
+    {
+        bool timed = m_metrics.encoding();
+        std::chrono::steady_clock::time_point start;
+        if(timed)
+        {
+            start = std::chrono::steady_clock::now();
+        }
+        m_packet_mgr.encode(p, [&](bool isBinary,shared_ptr<const string> const& payload)
+        {
+            if(isBinary)
+            {
+                op.attachments.push_back(payload);
+            }
+            else
+            {
+                op.payload = payload;
+            }
+        });
+        if(timed)
+        {
+            m_metrics.encode_time().record(std::chrono::steady_clock::now() - start);
+        }
+        //determined once encoded.
+        op.type = p.get_frame() == packet::frame_message ? p.get_type() : -1;
+    }
+
+    void client_impl::send(outbound_packet& op)
+    {
+        std::size_t bytes = size_of(op);
+        op.bytes = bytes;
+        SIO_LOG_DEBUG("encoded payload length:"<<bytes<<endl);
+        bool network_thread = this->on_network_thread();
+        m_outbound_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        op.flow->add(bytes);
+        if(op.trace)
+        {
+            //stamped first, the network thread owns the trace once pushed.
+            op.trace->queued = std::chrono::steady_clock::now();
+        }
+        while(!m_outbound.push(op))
+        {
+            if(m_con_state != con_opened)
+            {
+                //send_impl would drop it anyway.
+                m_outbound_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+                op.flow->remove(bytes);
+                if(op.slot)
+                {
+                    op.slot->cancel();
+                }
+                if(op.trace)
+                {
+                    this->trace_dropped(op.trace, socket::ack_disconnected);
+                }
+                return;
+            }
+            if(network_thread)
+            {
+                this->flush_outbound();
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+        if(network_thread)
+        {
+            //sent right away as before, behind what other threads queued.
+            this->flush_outbound();
+        }
+        else if(!m_flush_pending.exchange(true))
+        {
+            m_client.get_io_service().post(lib::bind(&client_impl::flush_outbound,this));
+        }
+    }
+
+    void client_impl::trace_ack_failed(std::shared_ptr<emit_trace> const& trace, socket::ack_status status)
     {
-        m_packet_mgr.encode(p);
+        if(this->has_network_thread())
+        {
+            m_client.get_io_service().dispatch(lib::bind(&emit_tracer::ack_failed, &m_tracer, trace, status));
+        }
+        else
+        {
+            m_tracer.ack_failed(trace, status);
+        }
+    }
+
+    void client_impl::trace_dropped(std::shared_ptr<emit_trace> const& trace, socket::ack_status status)
+    {
+        if(this->has_network_thread())
+        {
+            m_client.get_io_service().dispatch(lib::bind(&emit_tracer::dropped, &m_tracer, trace, status));
+        }
+        else
+        {
+            m_tracer.dropped(trace, status);
+        }
     }
 
     void client_impl::remove_socket(string const& nsp)
@@ -200,59 +354,250 @@ namespace sio
 
     void client_impl::connect_impl(const string& uri, const string& queryString)
     {
-        do{
-            websocketpp::uri uo(uri);
-            ostringstream ss;
-#if SIO_TLS
-            ss<<"wss://";
-#else
-            ss<<"ws://";
-#endif
-            const std::string host(uo.get_host());
-            // As per RFC2732, literal IPv6 address should be enclosed in "[" and "]".
-            if(host.find(':')!=std::string::npos){
-                ss<<"["<<uo.get_host()<<"]";
-            } else {
-                ss<<uo.get_host();
-            }
-            ss<<":"<<uo.get_port()<<"/socket.io/?EIO=4&transport=websocket";
-            if(m_sid.size()>0){
-                ss<<"&sid="<<m_sid;
-            }
-            ss<<"&t="<<time(NULL)<<queryString;
-            lib::error_code ec;
-            client_type::connection_ptr con = m_client.get_connection(ss.str(), ec);
-            if (ec) {
-                m_client.get_alog().write(websocketpp::log::alevel::app,
-                                          "Get Connection Error: "+ec.message());
-                break;
+        websocketpp::uri uo(uri);
+        if(!uo.get_valid())
+        {
+            m_client.get_alog().write(websocketpp::log::alevel::app,
+                                      "Get Connection Error: invalid uri "+uri);
+            if(m_fail_listener)
+            {
+                m_fail_listener();
             }
+            return;
+        }
+        using websocketpp::lib::placeholders::_1;
+        using websocketpp::lib::placeholders::_2;
+        m_resolving = true;
+        unsigned connect_id = ++m_connect_id;
+        //one deadline for the name lookup and the race of its addresses.
+        m_timer_wheel->cancel(m_open_timer);
+        m_open_timer = m_open_timeout > 0 ? m_timer_wheel->arm(m_open_timeout, lib::bind(&client_impl::timeout_open,this,connect_id)) : 0;
+        m_endpoint_cache->resolve(uo.get_host(),uo.get_port_str(),
+                                  lib::bind(&client_impl::on_resolved,this,connect_id,uri,queryString,_1,_2));
+    }
 
-            for( auto&& header: m_http_headers ) {
-                con->replace_header(header.first, header.second);
-            }
+    void client_impl::timeout_open(unsigned connect_id)
+    {
+        m_open_timer = 0;
+        if(connect_id != m_connect_id || !m_resolving)
+        {
+            return;
+        }
+        SIO_LOG_DEBUG("Open timeout"<<endl);
+        //a resolve or race finishing late is stale now.
+        ++m_connect_id;
+        m_resolving = false;
+        if(m_racer)
+        {
+            m_racer->cancel();
+            m_racer.reset();
+            websocketpp::uri uo(m_base_url);
+            m_endpoint_cache->evict(uo.get_host(),uo.get_port_str());
+        }
+        this->on_transport_fail();
+    }
+
+    void client_impl::on_resolved(unsigned connect_id, const string& uri, const string& queryString,
+                                  boost::system::error_code const& ec, endpoint_list const& endpoints)
+    {
+        if(connect_id != m_connect_id)
+        {
+            return;
+        }
+        if(ec)
+        {
+            SIO_LOG_DEBUG("Resolve failed:"<<ec.message()<<endl);
+            m_resolving = false;
+            m_timer_wheel->cancel(m_open_timer);
+            m_open_timer = 0;
+            this->on_transport_fail();
+            return;
+        }
+        using websocketpp::lib::placeholders::_1;
+        using websocketpp::lib::placeholders::_2;
+        m_racer = std::make_shared<endpoint_racer>(m_client.get_io_service(),endpoints);
+        m_racer->start(lib::bind(&client_impl::on_raced,this,connect_id,uri,queryString,_1,_2));
+    }
 
-            m_client.connect(con);
+    void client_impl::on_raced(unsigned connect_id, const string& uri, const string& queryString,
+                               boost::system::error_code const& ec, boost::asio::ip::tcp::endpoint const& ep)
+    {
+        if(connect_id != m_connect_id)
+        {
             return;
         }
-        while(0);
+        std::unique_ptr<boost::asio::ip::tcp::socket> socket = m_racer->take_socket();
+        m_racer.reset();
+        m_resolving = false;
+        m_timer_wheel->cancel(m_open_timer);
+        m_open_timer = 0;
+        if(ec)
+        {
+            SIO_LOG_DEBUG("No address reachable:"<<ec.message()<<endl);
+            websocketpp::uri uo(uri);
+            m_endpoint_cache->evict(uo.get_host(),uo.get_port_str());
+            this->on_transport_fail();
+            return;
+        }
+        m_endpoint = ep;
+        if(m_transport == client::transport_polling)
+        {
+            if(this->connect_polling(uri,queryString,std::move(socket)))
+            {
+                return;
+            }
+        }
+        else
+        {
+            //websocketpp can't take over a connection and dials the address
+            //again, only the address is raced. Close the probe before it does.
+            if(socket)
+            {
+                boost::system::error_code close_ec;
+                socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both,close_ec);
+                socket->close(close_ec);
+                socket.reset();
+            }
+            if(this->connect_websocket(uri,queryString))
+            {
+                return;
+            }
+        }
         if(m_fail_listener)
         {
             m_fail_listener();
         }
     }
 
+    client_type::connection_ptr client_impl::connect_websocket(const string& uri, const string& queryString)
+    {
+        websocketpp::uri uo(uri);
+        ostringstream resource;
+        resource<<":"<<uo.get_port()<<"/socket.io/?EIO=4&transport=websocket";
+        if(m_sid.size()>0){
+            resource<<"&sid="<<m_sid;
+        }
+        resource<<"&t="<<time(NULL)<<queryString;
+#if SIO_TLS
+        const std::string scheme("wss://");
+#else
+        const std::string scheme("ws://");
+#endif
+        // As per RFC2732, literal IPv6 address should be enclosed in "[" and "]".
+        const std::string host(uo.get_host());
+        const std::string address(m_endpoint.address().to_string());
+        const std::string host_url(scheme+(host.find(':')!=std::string::npos?"["+host+"]":host)+resource.str());
+        const std::string address_url(scheme+(m_endpoint.address().is_v6()?"["+address+"]":address)+resource.str());
+        lib::error_code ec;
+        client_type::connection_ptr con = m_client.get_connection(address_url, ec);
+        if (ec) {
+            m_client.get_alog().write(websocketpp::log::alevel::app,
+                                      "Get Connection Error: "+ec.message());
+            return client_type::connection_ptr();
+        }
+
+        for( auto&& header: m_http_headers ) {
+            con->replace_header(header.first, header.second);
+        }
+        con->set_open_handshake_timeout(m_handshake_timeout);
+
+        boost::system::error_code addr_ec;
+        boost::asio::ip::address::from_string(host, addr_ec);
+        m_sni_host = addr_ec ? host : std::string();
+        m_client.connect(con);
+        // The transport has taken the address to connect to, the handshake
+        // request (Host header) is built from the url set now.
+        con->set_uri(std::make_shared<websocketpp::uri>(host_url));
+        return con;
+    }
+
+    bool client_impl::connect_polling(const string& uri, const string& queryString,
+                                      std::unique_ptr<boost::asio::ip::tcp::socket> socket)
+    {
+        websocketpp::uri uo(uri);
+        if(!uo.get_valid())
+        {
+            m_client.get_alog().write(websocketpp::log::alevel::app,
+                                      "Get Connection Error: invalid uri "+uri);
+            return false;
+        }
+#if SIO_TLS
+        m_polling = std::make_shared<polling_transport>(m_client.get_io_service(),this->tls_context());
+        m_polling->set_session_cache(&m_tls_sessions);
+#else
+        m_polling = std::make_shared<polling_transport>(m_client.get_io_service());
+#endif
+        using websocketpp::lib::placeholders::_1;
+        m_polling->set_open_handler(lib::bind(&client_impl::on_transport_open,this));
+        m_polling->set_packet_handler(lib::bind(&client_impl::on_transport_message,this,_1));
+        m_polling->set_fail_handler(lib::bind(&client_impl::on_polling_fail,this,_1));
+        m_polling->set_close_handler(lib::bind(&client_impl::on_polling_close,this,_1));
+        m_polling->set_endpoint(m_endpoint);
+        if(socket)
+        {
+            m_polling->set_socket(std::move(socket));
+        }
+        m_polling->open(uo.get_host(),uo.get_port_str(),"/socket.io/?EIO=4&transport=polling"+queryString,m_http_headers);
+        return true;
+    }
+
+    void client_impl::start_upgrade()
+    {
+        client_type::connection_ptr con = this->connect_websocket(m_base_url,m_query_string);
+        if(con)
+        {
+            SIO_LOG_DEBUG("Probing websocket upgrade."<<endl);
+            m_upgrading = true;
+            m_probe_con = con->get_handle();
+        }
+    }
+
+    bool client_impl::is_probe(connection_hdl con) const
+    {
+        return m_upgrading && !m_probe_con.owner_before(con) && !con.owner_before(m_probe_con);
+    }
+
     void client_impl::close_impl(close::status::value const& code,string const& reason)
     {
-        LOG("Close by reason:"<<reason << endl);
-        if(m_reconn_timer)
+        SIO_LOG_DEBUG("Close by reason:"<<reason << endl);
+        this->cancel_reconnect();
+        this->release_reconnect_slot();
+        if(m_resolving)
         {
-            m_reconn_timer->cancel();
-            m_reconn_timer.reset();
+            //still looking for a reachable address, nothing to close yet.
+            m_resolving = false;
+            ++m_connect_id;
+            m_timer_wheel->cancel(m_open_timer);
+            m_open_timer = 0;
+            if(m_racer)
+            {
+                m_racer->cancel();
+                m_racer.reset();
+            }
+            this->on_transport_close(close::status::normal);
+            return;
         }
-        if (m_con.expired())
+        if(m_upgrading)
         {
-            cerr << "Error: No active session" << endl;
+            lib::error_code ec;
+            m_client.close(m_probe_con, close::status::normal, "Upgrade aborted", ec);
+            m_upgrading = false;
+        }
+        if(m_polling)
+        {
+            if(code == close::status::normal)
+            {
+                m_polling->shutdown();
+            }
+            else
+            {
+                m_polling->close();
+                this->on_polling_close(boost::asio::error::connection_aborted);
+            }
+        }
+        else if (m_con.expired())
+        {
+            SIO_LOG(logger::level_error, "Error: No active session");
         }
         else
         {
@@ -265,76 +610,128 @@ namespace sio
     {
         if(m_con_state == con_opened)
         {
+            m_metrics.frame_out(payload_ptr->size());
+            if(m_polling)
+            {
+                m_polling->send(payload_ptr);
+                return;
+            }
             lib::error_code ec;
             m_client.send(m_con,*payload_ptr,opcode,ec);
             if(ec)
             {
-                cerr<<"Send failed,reason:"<< ec.message()<<endl;
+                SIO_LOG(logger::level_error, "Send failed,reason:"<< ec.message());
             }
         }
     }
 
-    void client_impl::ping(const boost::system::error_code& ec)
+    void client_impl::on_ping()
     {
-        if(ec || m_con.expired())
-        {
-            if (ec != boost::asio::error::operation_aborted)
-                LOG("ping exit,con is expired?"<<m_con.expired()<<",ec:"<<ec.message()<<endl){};
-            return;
-        }
-        packet p(packet::frame_ping);
+        packet p(packet::frame_pong);
         m_packet_mgr.encode(p, [&](bool /*isBin*/,shared_ptr<const string> payload)
         {
-            lib::error_code ec;
-            this->m_client.send(this->m_con, *payload, frame::opcode::text, ec);
+            this->send_impl(payload, frame::opcode::text);
         });
-        if(m_ping_timer)
-        {
-            boost::system::error_code e_code;
-            m_ping_timer->expires_from_now(milliseconds(m_ping_interval), e_code);
-            m_ping_timer->async_wait(lib::bind(&client_impl::ping,this,lib::placeholders::_1));
-        }
-        if(!m_ping_timeout_timer)
+        this->arm_heartbeat();
+        //engine.io pings carry no timestamp, measure the round trip with a websocket ping instead.
+        if(!m_polling && !m_rtt_pending && !m_con.expired())
         {
-            m_ping_timeout_timer.reset(new boost::asio::deadline_timer(m_client.get_io_service()));
-            boost::system::error_code timeout_ec;
-            m_ping_timeout_timer->expires_from_now(milliseconds(m_ping_timeout), timeout_ec);
-            m_ping_timeout_timer->async_wait(lib::bind(&client_impl::timeout_pong, this,lib::placeholders::_1));
+            lib::error_code ec;
+            m_rtt_ping_sent = std::chrono::steady_clock::now();
+            m_client.ping(m_con, "rtt", ec);
+            m_rtt_pending = !ec;
         }
     }
 
-    void client_impl::timeout_pong(const boost::system::error_code &ec)
+    void client_impl::on_ws_pong(connection_hdl, std::string)
     {
-        if(ec)
+        if(m_rtt_pending)
         {
-            return;
+            m_rtt_pending = false;
+            auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_rtt_ping_sent);
+            m_rtt = static_cast<unsigned>(rtt.count());
+            m_metrics.rtt().record(rtt);
+            SIO_LOG_DEBUG("RTT:"<<m_rtt<<"us"<<endl);
         }
-        LOG("Pong timeout"<<endl);
-        m_client.get_io_service().dispatch(lib::bind(&client_impl::close_impl, this,close::status::policy_violation,"Pong timeout"));
     }
 
-    void client_impl::timeout_reconnect(boost::system::error_code const& ec)
+    void client_impl::arm_heartbeat()
     {
-        if(ec)
+        //the server pings every ping interval and expects the pong within ping timeout.
+        m_timer_wheel->cancel(m_ping_timeout_timer);
+        m_ping_timeout_timer = m_timer_wheel->arm(m_ping_interval + m_ping_timeout,
+                                                  lib::bind(&client_impl::timeout_ping, this));
+    }
+
+    void client_impl::timeout_ping()
+    {
+        m_ping_timeout_timer = 0;
+        SIO_LOG_DEBUG("Ping timeout"<<endl);
+        m_client.get_io_service().dispatch(lib::bind(&client_impl::close_impl, this,close::status::policy_violation,"Ping timeout"));
+    }
+
+    void client_impl::arm_reconnect(unsigned delay)
+    {
+        m_timer_wheel->cancel(m_reconn_timer);
+        m_reconn_timer = m_timer_wheel->arm(delay, lib::bind(&client_impl::timeout_reconnect, this));
+    }
+
+    void client_impl::cancel_reconnect()
+    {
+        m_timer_wheel->cancel(m_reconn_timer);
+        m_reconn_timer = 0;
+    }
+
+    void client_impl::timeout_reconnect()
+    {
+        m_reconn_timer = 0;
+        //wait for a slot of the process wide reconnect cap, keep the loop running meanwhile.
+        this->release_reconnect_slot();
+        m_reconn_work.reset(new boost::asio::io_service::work(m_client.get_io_service()));
+        m_reconn_ticket = reconnect_gate::global().acquire([this]()
         {
-            return;
-        }
+            m_client.get_io_service().post(lib::bind(&client_impl::start_reconnect,this));
+        });
+    }
+
+    void client_impl::start_reconnect()
+    {
+        m_reconn_work.reset();
         if(m_con_state == con_closed)
         {
             m_con_state = con_opening;
             m_reconn_made++;
+            m_metrics.reconnect_attempt();
             this->reset_states();
-            LOG("Reconnecting..."<<endl);
+            SIO_LOG_DEBUG("Reconnecting..."<<endl);
             if(m_reconnecting_listener) m_reconnecting_listener();
             m_client.get_io_service().dispatch(lib::bind(&client_impl::connect_impl,this,m_base_url,m_query_string));
         }
+        else
+        {
+            this->release_reconnect_slot();
+        }
     }
 
-    unsigned client_impl::next_delay() const
+    void client_impl::abort_reconnect()
     {
-        //no jitter, fixed power root.
-        unsigned reconn_made = min<unsigned>(m_reconn_made,32);//protect the pow result to be too big.
-        return static_cast<unsigned>(min<double>(m_reconn_delay * pow(1.5,reconn_made),m_reconn_delay_max));
+        this->cancel_reconnect();
+        this->release_reconnect_slot();
+    }
+
+    void client_impl::release_reconnect_slot()
+    {
+        if(m_reconn_ticket)
+        {
+            reconnect_gate::global().release(m_reconn_ticket);
+            m_reconn_ticket = 0;
+        }
+        m_reconn_work.reset();
+    }
+
+    unsigned client_impl::next_delay()
+    {
+        return m_backoff.next_delay(m_reconn_made,m_reconn_delay,m_reconn_delay_max);
     }
 
     socket::ptr client_impl::get_socket_locked(string const& nsp)
@@ -351,6 +748,22 @@ namespace sio
         }
     }
 
+    void client_impl::dispatch(string const& nsp, string const& event_name, std::function<void()> const& task)
+    {
+        std::shared_ptr<event_executor> executor = m_executor;
+        if(!executor)
+        {
+            task();
+            return;
+        }
+        socket::ptr so_ptr = get_socket_locked(nsp);
+        std::size_t key = m_dispatch_key ? m_dispatch_key(nsp, event_name) : std::hash<string>()(nsp);
+        executor->submit(key, [so_ptr, task]()
+        {
+            task();
+        });
+    }
+
     void client_impl::sockets_invoke_void(void (sio::socket::*fn)(void))
     {
         map<const string,socket::ptr> socks;
@@ -363,21 +776,31 @@ namespace sio
         }
     }
 
-    void client_impl::on_fail(connection_hdl)
+    void client_impl::on_fail(connection_hdl con)
     {
+        if(this->is_probe(con))
+        {
+            SIO_LOG_DEBUG("Upgrade probe failed." << endl);
+            m_upgrading = false;
+            m_probe_con.reset();
+            return;
+        }
         m_con.reset();
+        this->on_transport_fail();
+    }
+
+    void client_impl::on_transport_fail()
+    {
+        this->release_reconnect_slot();
         m_con_state = con_closed;
         this->sockets_invoke_void(&sio::socket::on_disconnect);
-        LOG("Connection failed." << endl);
+        SIO_LOG_DEBUG("Connection failed." << endl);
         if(m_reconn_made<m_reconn_attempts)
         {
-            LOG("Reconnect for attempt:"<<m_reconn_made<<endl);
+            SIO_LOG_DEBUG("Reconnect for attempt:"<<m_reconn_made<<endl);
             unsigned delay = this->next_delay();
             if(m_reconnect_listener) m_reconnect_listener(m_reconn_made,delay);
-            m_reconn_timer.reset(new boost::asio::deadline_timer(m_client.get_io_service()));
-            boost::system::error_code ec;
-            m_reconn_timer->expires_from_now(milliseconds(delay), ec);
-            m_reconn_timer->async_wait(lib::bind(&client_impl::timeout_reconnect,this,lib::placeholders::_1));
+            this->arm_reconnect(delay);
         }
         else
         {
@@ -387,10 +810,27 @@ namespace sio
     
     void client_impl::on_open(connection_hdl con)
     {
-        LOG("Connected." << endl);
-        m_con_state = con_opened;
+        if(this->is_probe(con))
+        {
+            lib::error_code ec;
+            m_client.send(con, "2probe", frame::opcode::text, ec);
+            return;
+        }
         m_con = con;
+        this->on_transport_open();
+    }
+
+    void client_impl::on_transport_open()
+    {
+        SIO_LOG_DEBUG("Connected." << endl);
+        this->release_reconnect_slot();
+        m_con_state = con_opened;
+        if(m_reconn_made > 0)
+        {
+            m_metrics.reconnected();
+        }
         m_reconn_made = 0;
+        m_backoff.reset();
         this->sockets_invoke_void(&sio::socket::on_open);
         this->socket("");
         if(m_open_listener)m_open_listener();
@@ -398,14 +838,18 @@ namespace sio
     
     void client_impl::on_close(connection_hdl con)
     {
-        LOG("Client Disconnected." << endl);
-        con_state m_con_state_was = m_con_state;
-        m_con_state = con_closed;
+        if(this->is_probe(con))
+        {
+            SIO_LOG_DEBUG("Upgrade probe closed." << endl);
+            m_upgrading = false;
+            m_probe_con.reset();
+            return;
+        }
         lib::error_code ec;
         close::status::value code = close::status::normal;
         client_type::connection_ptr conn_ptr  = m_client.get_con_from_hdl(con, ec);
         if (ec) {
-            LOG("OnClose get conn failed"<<ec<<endl);
+            SIO_LOG_DEBUG("OnClose get conn failed"<<ec<<endl);
         }
         else
         {
@@ -413,7 +857,19 @@ namespace sio
         }
         
         m_con.reset();
+        this->on_transport_close(code);
+    }
+
+    void client_impl::on_transport_close(close::status::value code)
+    {
+        SIO_LOG_DEBUG("Client Disconnected." << endl);
+        this->release_reconnect_slot();
+        con_state m_con_state_was = m_con_state;
+        m_con_state = con_closed;
         this->clear_timers();
+        //closed, so this drops what the lanes still hold rather than send it on the next connection.
+        this->drain_lanes();
+        m_tracer.abandon();
         client::close_reason reason;
 
         // If we initiated the close, no matter what the close status was,
@@ -429,13 +885,10 @@ namespace sio
             this->sockets_invoke_void(&sio::socket::on_disconnect);
             if(m_reconn_made<m_reconn_attempts)
             {
-                LOG("Reconnect for attempt:"<<m_reconn_made<<endl);
+                SIO_LOG_DEBUG("Reconnect for attempt:"<<m_reconn_made<<endl);
                 unsigned delay = this->next_delay();
                 if(m_reconnect_listener) m_reconnect_listener(m_reconn_made,delay);
-                m_reconn_timer.reset(new boost::asio::deadline_timer(m_client.get_io_service()));
-                boost::system::error_code ec;
-                m_reconn_timer->expires_from_now(milliseconds(delay), ec);
-                m_reconn_timer->async_wait(lib::bind(&client_impl::timeout_reconnect,this,lib::placeholders::_1));
+                this->arm_reconnect(delay);
                 return;
             }
             reason = client::close_reason_drop;
@@ -447,15 +900,67 @@ namespace sio
         }
     }
     
-    void client_impl::on_message(connection_hdl, client_type::message_ptr msg)
+    void client_impl::on_message(connection_hdl con, client_type::message_ptr msg)
     {
-        if (m_ping_timeout_timer) {
-            boost::system::error_code ec;
-            m_ping_timeout_timer->expires_from_now(milliseconds(m_ping_timeout),ec);
-            m_ping_timeout_timer->async_wait(lib::bind(&client_impl::timeout_pong, this,lib::placeholders::_1));
+        if(this->is_probe(con))
+        {
+            if(msg->get_payload() == "3probe" && m_polling)
+            {
+                m_polling->pause(lib::bind(&client_impl::on_polling_paused,this,lib::placeholders::_1));
+            }
+            return;
+        }
+        this->on_transport_message(msg->get_payload());
+    }
+
+    void client_impl::on_polling_fail(boost::system::error_code const& ec)
+    {
+        SIO_LOG_DEBUG("Polling failed:" << ec.message() << endl);
+        m_polling.reset();
+        this->on_transport_fail();
+    }
+
+    void client_impl::on_polling_close(boost::system::error_code const& ec)
+    {
+        if(m_upgrading)
+        {
+            lib::error_code close_ec;
+            m_client.close(m_probe_con, close::status::normal, "Upgrade aborted", close_ec);
+            m_upgrading = false;
+            m_probe_con.reset();
+        }
+        m_polling.reset();
+        this->on_transport_close(ec ? close::status::abnormal_close : close::status::normal);
+    }
+
+    void client_impl::on_polling_paused(std::deque<std::shared_ptr<const std::string> >& unsent)
+    {
+        SIO_LOG_DEBUG("Upgraded to websocket." << endl);
+        lib::error_code ec;
+        m_client.send(m_probe_con, "5", frame::opcode::text, ec);
+        m_con = m_probe_con;
+        m_probe_con.reset();
+        m_upgrading = false;
+        std::shared_ptr<polling_transport> polling;
+        polling.swap(m_polling);
+        polling->close();
+        for(auto it = unsent.begin(); it != unsent.end(); ++it)
+        {
+            this->send_impl(*it,packet::is_binary_message(**it)?frame::opcode::binary:frame::opcode::text);
+        }
+    }
+
+    void client_impl::on_transport_message(std::string const& payload)
+    {
+        m_decode_timed = m_metrics.frame_in(payload.size());
+        if(m_decode_timed)
+        {
+            m_decode_start = std::chrono::steady_clock::now();
         }
         // Parse the incoming message according to socket.IO rules
-        m_packet_mgr.put_payload(msg->get_payload());
+        m_packet_mgr.put_payload(payload);
+        //a binary attachment that didn't complete its packet.
+        m_decode_timed = false;
     }
     
     void client_impl::on_handshake(message::ptr const& message)
@@ -489,13 +994,34 @@ namespace sio
             {
                 m_ping_timeout = 60000;
             }
+            it = values->find("maxPayload");
+            if (it!=values->end()&&it->second->get_flag() == message::flag_integer) {
+                m_max_payload = (unsigned) static_pointer_cast<int_message>(it->second)->get_int();
+            }
+            else
+            {
+                m_max_payload = 1000000;
+            }
+            if(m_polling)
+            {
+                m_polling->start(m_sid,m_max_payload);
+                it = values->find("upgrades");
+                if(m_upgrade && it!=values->end() && it->second->get_flag() == message::flag_array)
+                {
+                    const vector<message::ptr>& upgrades = it->second->get_vector();
+                    for(auto up = upgrades.begin();up!=upgrades.end();++up)
+                    {
+                        if((*up)->get_flag() == message::flag_string && (*up)->get_string() == "websocket")
+                        {
+                            this->start_upgrade();
+                            break;
+                        }
+                    }
+                }
+            }
 
-            m_ping_timer.reset(new boost::asio::deadline_timer(m_client.get_io_service()));
-            boost::system::error_code ec;
-            m_ping_timer->expires_from_now(milliseconds(m_ping_interval), ec);
-            if(ec)LOG("ec:"<<ec.message()<<endl){};
-            m_ping_timer->async_wait(lib::bind(&client_impl::ping,this,lib::placeholders::_1));
-            LOG("On handshake,sid:"<<m_sid<<",ping interval:"<<m_ping_interval<<",ping timeout"<<m_ping_timeout<<endl);
+            this->arm_heartbeat();
+            SIO_LOG_DEBUG("On handshake,sid:"<<m_sid<<",ping interval:"<<m_ping_interval<<",ping timeout"<<m_ping_timeout<<endl);
             return;
         }
 failed:
@@ -503,21 +1029,23 @@ failed:
         m_client.get_io_service().dispatch(lib::bind(&client_impl::close_impl, this,close::status::policy_violation,"Handshake error"));
     }
 
-    void client_impl::on_pong()
+    void client_impl::on_decode(packet const& p)
     {
-        if(m_ping_timeout_timer)
+        if(m_decode_timed)
         {
-            m_ping_timeout_timer->cancel();
-            m_ping_timeout_timer.reset();
+            //before dispatching, listeners running inline aren't decoding.
+            m_metrics.decode_time().record(std::chrono::steady_clock::now() - m_decode_start);
+            m_decode_timed = false;
         }
-    }
-
-    void client_impl::on_decode(packet const& p)
-    {
         switch(p.get_frame())
         {
         case packet::frame_message:
         {
+            m_metrics.packet_in(p.get_type());
+            if(p.get_type() == packet::type_ack || p.get_type() == packet::type_binary_ack)
+            {
+                m_tracer.acked(p.get_nsp(), static_cast<int>(p.get_pack_id()));
+            }
             socket::ptr so_ptr = get_socket_locked(p.get_nsp());
             if(so_ptr)so_ptr->on_message_packet(p);
             break;
@@ -529,8 +1057,8 @@ failed:
             //FIXME how to deal?
             this->close_impl(close::status::abnormal_close, "End by server");
             break;
-        case packet::frame_pong:
-            this->on_pong();
+        case packet::frame_ping:
+            this->on_ping();
             break;
 
         default:
@@ -538,26 +1066,152 @@ failed:
         }
     }
     
-    void client_impl::on_encode(bool isBinary,shared_ptr<const string> const& payload)
+    void client_impl::flush_outbound()
     {
-        LOG("encoded payload length:"<<payload->length()<<endl);
-        m_client.get_io_service().dispatch(lib::bind(&client_impl::send_impl,this,payload,isBinary?frame::opcode::binary:frame::opcode::text));
+        //clear first, a packet pushed while draining posts another flush.
+        m_flush_pending.store(false);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        outbound_packet op;
+        while(m_outbound.pop(op))
+        {
+            if(op.trace)
+            {
+                op.trace->dispatched = std::chrono::steady_clock::now();
+            }
+            m_scheduler.push(op);
+        }
+        this->drain_lanes();
     }
-    
-    void client_impl::clear_timers()
+
+    void client_impl::drain_lanes()
     {
-        LOG("clear timers"<<endl);
-        boost::system::error_code ec;
-        if(m_ping_timeout_timer)
+        //websocketpp writes a message as a whole, so a lane can't cut into a
+        //message already handed over. Keep what's handed over small instead.
+        static const std::size_t watermark = 256 * 1024;
+        if(m_con_state != con_opened)
         {
-            m_ping_timeout_timer->cancel(ec);
-            m_ping_timeout_timer.reset();
+            //send_impl would drop them anyway.
+            std::vector<std::shared_ptr<emit_trace> > traces;
+            m_outbound_bytes.fetch_sub(m_scheduler.clear(&traces), std::memory_order_relaxed);
+            for(auto it = traces.begin(); it != traces.end(); ++it)
+            {
+                m_tracer.dropped(*it, socket::ack_disconnected);
+            }
+            return;
         }
-        if(m_ping_timer)
+        this->update_buffered();
+        std::size_t buffered = m_transport_bytes.load(std::memory_order_relaxed);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point next_due = std::chrono::steady_clock::time_point::max();
+        outbound_packet op;
+        while(!m_scheduler.empty())
         {
-            m_ping_timer->cancel(ec);
-            m_ping_timer.reset();
+            if(buffered >= watermark)
+            {
+                this->arm_pacing(1);
+                m_transport_bytes.store(buffered, std::memory_order_relaxed);
+                return;
+            }
+            if(!m_scheduler.pop(op, now, next_due))
+            {
+                //the rest is held back by rate limits, come back when the first is due.
+                auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next_due - now).count();
+                this->arm_pacing(wait > 0 ? (unsigned)wait : 1);
+                break;
+            }
+            if(op.slot)
+            {
+                op.slot->take(op);
+                op.slot.reset();
+                //queued with the first value, the newest may differ in size.
+                std::size_t queued_bytes = op.bytes;
+                op.bytes = size_of(op);
+                if(op.bytes > queued_bytes)
+                {
+                    m_outbound_bytes.fetch_add(op.bytes - queued_bytes, std::memory_order_relaxed);
+                }
+                else
+                {
+                    m_outbound_bytes.fetch_sub(queued_bytes - op.bytes, std::memory_order_relaxed);
+                }
+                m_scheduler.recharge(op, queued_bytes);
+            }
+            this->send_impl(op.payload, frame::opcode::text);
+            for(auto it = op.attachments.begin(); it != op.attachments.end(); ++it)
+            {
+                this->send_impl(*it, frame::opcode::binary);
+            }
+            m_metrics.packet_out(op.type);
+            if(op.trace)
+            {
+                m_tracer.written(op.trace, std::chrono::steady_clock::now());
+                op.trace.reset();
+            }
+            m_outbound_bytes.fetch_sub(op.bytes, std::memory_order_relaxed);
+            buffered += op.bytes;
         }
+        this->update_buffered();
+    }
+
+    void client_impl::arm_pacing(unsigned delay)
+    {
+        m_timer_wheel->cancel(m_pacing_timer);
+        m_pacing_timer = m_timer_wheel->arm(delay, lib::bind(&client_impl::timeout_pacing,this));
+    }
+
+    void client_impl::timeout_pacing()
+    {
+        m_pacing_timer = 0;
+        this->drain_lanes();
+    }
+
+    void client_impl::update_buffered()
+    {
+        m_buffered_update_pending.store(false);
+        std::size_t bytes = 0;
+        if(m_polling)
+        {
+            bytes = m_polling->queued_bytes();
+        }
+        else if(!m_con.expired())
+        {
+            lib::error_code ec;
+            client_type::connection_ptr con = m_client.get_con_from_hdl(m_con, ec);
+            if(con)
+            {
+                bytes = con->get_buffered_amount();
+            }
+        }
+        m_transport_bytes.store(bytes, std::memory_order_relaxed);
+    }
+
+    bool client_impl::can_send_volatile()
+    {
+        if(m_con_state != con_opened)
+        {
+            return false;
+        }
+        std::size_t buffered = m_outbound_bytes.load(std::memory_order_relaxed) + m_transport_bytes.load(std::memory_order_relaxed);
+        if(buffered < m_volatile_limit.load(std::memory_order_relaxed))
+        {
+            return true;
+        }
+        //the sample is only taken when sending, refresh it so a drained link lets emits through again.
+        if(!m_buffered_update_pending.exchange(true))
+        {
+            m_client.get_io_service().post(lib::bind(&client_impl::update_buffered,this));
+        }
+        return false;
+    }
+    
+    void client_impl::clear_timers()
+    {
+        SIO_LOG_DEBUG("clear timers"<<endl);
+        m_timer_wheel->cancel(m_ping_timeout_timer);
+        m_ping_timeout_timer = 0;
+        m_rtt_pending = false;
+        m_timer_wheel->cancel(m_pacing_timer);
+        m_pacing_timer = 0;
     }
     
     void client_impl::reset_states()
@@ -570,20 +1224,73 @@ failed:
 #if SIO_TLS
     client_impl::context_ptr client_impl::on_tls_init(connection_hdl conn)
     {
-        context_ptr ctx = context_ptr(new  boost::asio::ssl::context(boost::asio::ssl::context::tlsv1));
-        boost::system::error_code ec;
-        ctx->set_options(boost::asio::ssl::context::default_workarounds |
-                             boost::asio::ssl::context::no_sslv2 |
-                             boost::asio::ssl::context::single_dh_use,ec);
+        return this->tls_context();
+    }
+
+    client_impl::context_ptr client_impl::tls_context()
+    {
+        if(!m_tls_context)
+        {
+            m_tls_context = m_tls_sessions.create_context();
+        }
+        return m_tls_context;
+    }
+
+    void client_impl::on_tcp_pre_init(connection_hdl con)
+    {
+        lib::error_code ec;
+        client_type::connection_ptr con_ptr = m_client.get_con_from_hdl(con, ec);
         if(ec)
         {
-            cerr<<"Init tls failed,reason:"<< ec.message()<<endl;
+            return;
+        }
+        SSL* ssl = con_ptr->get_socket().native_handle();
+        if(!m_sni_host.empty())
+        {
+            SSL_set_tlsext_host_name(ssl, m_sni_host.c_str());
+        }
+        m_tls_sessions.prepare(ssl);
+        m_tls_handshake_start = std::chrono::steady_clock::now();
+    }
+
+    void client_impl::on_tcp_post_init(connection_hdl con)
+    {
+        lib::error_code ec;
+        client_type::connection_ptr con_ptr = m_client.get_con_from_hdl(con, ec);
+        if(!ec)
+        {
+            //runs after a failed handshake too, which isn't counted.
+            m_tls_sessions.handshake_done(con_ptr->get_socket().native_handle(), std::chrono::steady_clock::now() - m_tls_handshake_start);
         }
-        
-        return ctx;
     }
 #endif
 
+    client::tls_stats client_impl::get_tls_stats() const
+    {
+        client::tls_stats stats = client::tls_stats();
+#if SIO_TLS
+        stats.handshakes = m_tls_sessions.handshakes();
+        stats.resumed = m_tls_sessions.resumed();
+        stats.handshake_time = m_tls_sessions.handshake_time();
+#endif
+        return stats;
+    }
+
+    client::metrics client_impl::get_metrics() const
+    {
+        client::metrics m;
+        m_metrics.snapshot(m);
+        m.outbound_bytes = m_outbound_bytes.load(std::memory_order_relaxed);
+        m.transport_bytes = m_transport_bytes.load(std::memory_order_relaxed);
+        m.tls = this->get_tls_stats();
+        lock_guard<mutex> guard(m_socket_mutex);
+        for(auto it = m_sockets.begin(); it != m_sockets.end(); ++it)
+        {
+            m.sockets[it->first] = it->second->get_metrics();
+        }
+        return m;
+    }
+
     std::string client_impl::encode_query_string(const std::string &query){
         ostringstream ss;
         ss << std::hex;
@@ -32,11 +32,24 @@ typedef websocketpp::config::asio_client client_config;
 #endif //DEBUG
 #include <boost/asio/deadline_timer.hpp>
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <map>
 #include <thread>
 #include "../sio_client.h"
 #include "sio_packet.h"
+#include "sio_polling.h"
+#include "sio_backoff.h"
+#include "sio_resolver.h"
+#include "sio_timer_wheel.h"
+#include "sio_mpsc_ring.h"
+#include "sio_symbol_table.h"
+#include "sio_outbound_scheduler.h"
+#include "sio_metrics.h"
+#include "sio_tracer.h"
+#include "sio_log.h"
+#include "sio_tls.h"
 
 namespace sio
 {
@@ -108,21 +121,102 @@ namespace sio
         void sync_close();
         
         bool opened() const { return m_con_state == con_opened; }
+
+        bool on_network_thread() const { return m_network_thread && m_network_thread->get_id() == std::this_thread::get_id(); }
+
+        // Between connect and the close joining the thread, any thread.
+        bool has_network_thread() const { return m_has_network_thread.load(std::memory_order_acquire); }
         
         std::string const& get_sessionid() const { return m_sid; }
 
+        unsigned get_rtt() const { return m_rtt; }
+
         void set_reconnect_attempts(unsigned attempts) {m_reconn_attempts = attempts;}
 
         void set_reconnect_delay(unsigned millis) {m_reconn_delay = millis;if(m_reconn_delay_max<millis) m_reconn_delay_max = millis;}
 
         void set_reconnect_delay_max(unsigned millis) {m_reconn_delay_max = millis;if(m_reconn_delay>millis) m_reconn_delay = millis;}
+
+        void set_transport(client::transport t) {m_transport = t;}
+
+        void set_upgrade(bool upgrade) {m_upgrade = upgrade;}
+
+        void set_reconnect_jitter(client::reconnect_jitter jitter) {m_backoff.set_jitter(jitter);}
+
+        void set_connection_state_recovery(bool enable) {m_recovery = enable;}
+
+        bool recovery_enabled() const {return m_recovery;}
+
+        void set_open_timeout(unsigned millis) {m_open_timeout = millis;}
+
+        void set_handshake_timeout(unsigned millis) {m_handshake_timeout = millis;}
+
+        void set_dns_cache_ttl(unsigned seconds) {m_endpoint_cache->set_ttl(seconds);}
+
+        void set_volatile_buffer_limit(std::size_t bytes) {m_volatile_limit = bytes;}
+
+        void set_namespace_weight(std::string const& nsp, unsigned weight) {m_scheduler.set_weight(nsp, weight);}
+
+        // Whether a volatile emit goes out now, any thread.
+        bool can_send_volatile();
+
+        client::tls_stats get_tls_stats() const;
+
+        client::metrics get_metrics() const;
+
+        emit_tracer& get_tracer() { return m_tracer; }
+
+        void set_event_executor(std::shared_ptr<event_executor> const& executor, client::dispatch_key const& key)
+        {
+            m_executor = executor;
+            m_dispatch_key = key;
+        }
         
     protected:
-        void send(packet& p);
+        // Outbound lanes, lower is sent first. Control packets (acks, namespace
+        // connect) go ahead of every emit, a namespace disconnect goes
+        // behind what its socket queued with lane_trailing.
+        enum
+        {
+            lane_control,
+            lane_count = 1 + socket::priority_low + 1
+        };
+
+        static unsigned lane_of(socket::priority p) { return 1 + (unsigned)p; }
+
+        static const unsigned lane_trailing = outbound_scheduler::lane_trailing;
+
+        outbound_flow* get_flow(std::string const& nsp) { return m_scheduler.get_flow(nsp); }
+
+        // not_before holds the packet back, for rate limits.
+        void send(packet& p, unsigned lane, outbound_flow* flow,
+                  std::chrono::steady_clock::time_point not_before = std::chrono::steady_clock::time_point(),
+                  std::shared_ptr<emit_trace> const& trace = std::shared_ptr<emit_trace>());
+
+        // Fills in op.payload and op.attachments, any thread.
+        void encode(packet& p, outbound_packet& op) const;
+
+        // op.payload, op.attachments, op.lane and op.flow set.
+        void send(outbound_packet& op);
+
+        // The tracer is the network thread's, any thread hands it a trace
+        // whose ack failed or whose packet was dropped unwritten.
+        void trace_ack_failed(std::shared_ptr<emit_trace> const& trace, socket::ack_status status);
+
+        void trace_dropped(std::shared_ptr<emit_trace> const& trace, socket::ack_status status);
         
         void remove_socket(std::string const& nsp);
         
         boost::asio::io_service& get_io_service();
+
+        timer_wheel& get_timer_wheel() { return *m_timer_wheel; }
+
+        symbol_table& get_symbols() { return m_symbols; }
+
+        bool has_executor() const { return (bool)m_executor; }
+
+        // Runs a listener of the namespace on the executor, keeping the socket alive meanwhile.
+        void dispatch(std::string const& nsp, std::string const& event_name, std::function<void()> const& task);
         
         void on_socket_closed(std::string const& nsp);
         
@@ -133,24 +227,63 @@ namespace sio
 
         void connect_impl(const std::string& uri, const std::string& query);
 
+        void on_resolved(unsigned connect_id, const std::string& uri, const std::string& query,
+                         boost::system::error_code const& ec, endpoint_list const& endpoints);
+
+        void on_raced(unsigned connect_id, const std::string& uri, const std::string& query,
+                      boost::system::error_code const& ec, boost::asio::ip::tcp::endpoint const& ep);
+
+        client_type::connection_ptr connect_websocket(const std::string& uri, const std::string& query);
+
+        // socket is the connection that won the address race, if any.
+        bool connect_polling(const std::string& uri, const std::string& query,
+                             std::unique_ptr<boost::asio::ip::tcp::socket> socket);
+
+        void start_upgrade();
+
+        bool is_probe(connection_hdl con) const;
+
         void close_impl(close::status::value const& code,std::string const& reason);
         
         void send_impl(std::shared_ptr<const std::string> const&  payload_ptr,frame::opcode::value opcode);
         
-        void ping(const boost::system::error_code& ec);
+        void on_ping();
+
+        void arm_heartbeat();
         
-        void timeout_pong(const boost::system::error_code& ec);
+        void timeout_ping();
+
+        void timeout_open(unsigned connect_id);
 
-        void timeout_reconnect(boost::system::error_code const& ec);
+        void timeout_reconnect();
 
-        unsigned next_delay() const;
+        void start_reconnect();
+
+        void release_reconnect_slot();
+
+        // Cancels a pending reconnect and gives up its slot, on the network thread.
+        void abort_reconnect();
+
+        unsigned next_delay();
 
         socket::ptr get_socket_locked(std::string const& nsp);
         
         void sockets_invoke_void(void (sio::socket::*fn)(void));
         
         void on_decode(packet const& pack);
-        void on_encode(bool isBinary,shared_ptr<const string> const& payload);
+
+        // Moves the packets application threads queued to their lanes and sends
+        // what the transport takes, on the network thread.
+        void flush_outbound();
+
+        void drain_lanes();
+
+        void arm_pacing(unsigned delay);
+
+        void timeout_pacing();
+
+        // Samples what the transport hasn't written yet, on the network thread.
+        void update_buffered();
         
         //websocket callbacks
         void on_fail(connection_hdl con);
@@ -161,19 +294,53 @@ namespace sio
 
         void on_message(connection_hdl con, client_type::message_ptr msg);
 
+        void on_ws_pong(connection_hdl con, std::string payload);
+
+        //polling callbacks
+        void on_polling_fail(boost::system::error_code const& ec);
+
+        void on_polling_close(boost::system::error_code const& ec);
+
+        void on_polling_paused(std::deque<std::shared_ptr<const std::string> >& unsent);
+
+        //transport independent callbacks
+        void on_transport_fail();
+
+        void on_transport_open();
+
+        void on_transport_close(close::status::value code);
+
+        void on_transport_message(std::string const& payload);
+
         //socketio callbacks
         void on_handshake(message::ptr const& message);
 
-        void on_pong();
-
         void reset_states();
 
         void clear_timers();
+
+        void arm_reconnect(unsigned delay);
+
+        void cancel_reconnect();
         
         #if SIO_TLS
         typedef websocketpp::lib::shared_ptr<boost::asio::ssl::context> context_ptr;
         
         context_ptr on_tls_init(connection_hdl con);
+
+        // One context for all connections so their sessions can be resumed.
+        context_ptr tls_context();
+
+        void on_tcp_pre_init(connection_hdl con);
+
+        void on_tcp_post_init(connection_hdl con);
+
+        // Declared first, the context refers to it until destroyed.
+        tls_session_cache m_tls_sessions;
+
+        context_ptr m_tls_context;
+
+        std::chrono::steady_clock::time_point m_tls_handshake_start;
         #endif
         
         // Percent encode query string
@@ -181,6 +348,13 @@ namespace sio
 
         // Connection pointer for client functions.
         connection_hdl m_con;
+
+        // websocketpp's access and error logs go to the library's log through
+        // these, declared first so they outlive m_client.
+        log_bridge m_alog_stream;
+
+        log_bridge m_elog_stream;
+
         client_type m_client;
         // Socket.IO server settings
         std::string m_sid;
@@ -190,16 +364,77 @@ namespace sio
 
         unsigned int m_ping_interval;
         unsigned int m_ping_timeout;
+        unsigned int m_max_payload;
+
+        client::transport m_transport;
+
+        bool m_upgrade;
+
+        bool m_recovery;
+
+        bool m_upgrading;
+
+        std::unique_ptr<endpoint_cache> m_endpoint_cache;
+
+        // All timeouts of the client and its sockets share this wheel's asio timer.
+        std::unique_ptr<timer_wheel> m_timer_wheel;
+
+        // Event names of all sockets, outlives them.
+        symbol_table m_symbols;
+
+        std::shared_ptr<endpoint_racer> m_racer;
+
+        // Set while the host is resolved and its addresses are raced.
+        bool m_resolving;
+
+        // Tells stale resolve and race results apart from the current attempt.
+        unsigned m_connect_id;
+
+        // Address which won the last race, the transports connect to it directly.
+        boost::asio::ip::tcp::endpoint m_endpoint;
+
+        // Server name for TLS SNI, since the websocket url holds the address.
+        std::string m_sni_host;
+
+        unsigned m_open_timeout;
+
+        // Expires when the host isn't resolved and reached within m_open_timeout.
+        timer_wheel::timer_id m_open_timer;
+
+        unsigned m_handshake_timeout;
+
+        std::shared_ptr<polling_transport> m_polling;
+
+        // Websocket connection probed while the session runs on polling.
+        connection_hdl m_probe_con;
         
         std::unique_ptr<std::thread> m_network_thread;
+
+        // Set before the thread starts, cleared once it's joined.
+        std::atomic<bool> m_has_network_thread;
         
         packet_manager m_packet_mgr;
         
-        std::unique_ptr<boost::asio::deadline_timer> m_ping_timer;
-        
-        std::unique_ptr<boost::asio::deadline_timer> m_ping_timeout_timer;
+        // Expires when no ping arrived within ping interval + ping timeout.
+        timer_wheel::timer_id m_ping_timeout_timer;
+
+        std::chrono::steady_clock::time_point m_rtt_ping_sent;
+
+        bool m_rtt_pending;
+
+        std::atomic<unsigned> m_rtt;
+
+        // Bumped on the send and receive paths, encode counts on the emitting threads.
+        mutable client_metrics m_metrics;
+
+        // The frame put to the packet manager is timed until it decoded.
+        bool m_decode_timed;
+
+        std::chrono::steady_clock::time_point m_decode_start;
+
+        emit_tracer m_tracer;
 
-        std::unique_ptr<boost::asio::deadline_timer> m_reconn_timer;
+        timer_wheel::timer_id m_reconn_timer;
         
         con_state m_con_state;
         
@@ -214,7 +449,7 @@ namespace sio
         
         std::map<const std::string,socket::ptr> m_sockets;
         
-        std::mutex m_socket_mutex;
+        mutable std::mutex m_socket_mutex;
 
         unsigned m_reconn_delay;
 
@@ -223,6 +458,42 @@ namespace sio
         unsigned m_reconn_attempts;
 
         unsigned m_reconn_made;
+
+        backoff m_backoff;
+
+        // Slot in the reconnect gate, held from the reconnect attempt until it resolves.
+        reconnect_gate::ticket m_reconn_ticket;
+
+        std::unique_ptr<boost::asio::io_service::work> m_reconn_work;
+
+        // Encoded packets on their way to the network thread, one wakeup is
+        // posted for as many packets as arrive before it runs.
+        mpsc_ring<outbound_packet> m_outbound;
+
+        std::atomic<bool> m_flush_pending;
+
+        // Packets not handed to the transport yet, by lane and namespace. The
+        // transport gets more only while it holds less than a watermark, so a
+        // control packet or high priority emit overtakes a queued bulk upload
+        // and a busy namespace doesn't hold up the others.
+        outbound_scheduler m_scheduler;
+
+        // Re-checks the transport while lanes wait for it to drain.
+        timer_wheel::timer_id m_pacing_timer;
+
+        // Bytes in m_outbound and m_scheduler.
+        std::atomic<std::size_t> m_outbound_bytes;
+
+        // What the transport held when last sampled.
+        std::atomic<std::size_t> m_transport_bytes;
+
+        std::atomic<bool> m_buffered_update_pending;
+
+        std::atomic<std::size_t> m_volatile_limit;
+
+        std::shared_ptr<event_executor> m_executor;
+
+        client::dispatch_key m_dispatch_key;
         
         friend class sio::client;
         friend class sio::socket;
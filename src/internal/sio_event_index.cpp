@@ -0,0 +1,267 @@
+//
+//  sio_event_index.cpp
+//
+//  Listeners of a socket by exact name, by glob pattern and catch-all.
+//
+
+#include "sio_event_index.h"
+#include <algorithm>
+
+namespace sio
+{
+    namespace
+    {
+        inline void add_state(std::vector<unsigned>& states, unsigned s)
+        {
+            if(std::find(states.begin(), states.end(), s) == states.end())
+            {
+                states.push_back(s);
+            }
+        }
+    }
+
+    event_index::event_index():
+        m_order(0)
+    {
+        this->build();
+    }
+
+    event_index::event_index(event_index const& other):
+        m_exact(other.m_exact),
+        m_patterns(other.m_patterns),
+        m_order(other.m_order),
+        m_nodes(other.m_nodes),
+        m_any(other.m_any),
+        m_policies(other.m_policies)
+    {
+        this->relink();
+    }
+
+    event_index& event_index::operator=(event_index const& other)
+    {
+        if(this != &other)
+        {
+            m_exact = other.m_exact;
+            m_patterns = other.m_patterns;
+            m_order = other.m_order;
+            m_nodes = other.m_nodes;
+            m_any = other.m_any;
+            m_policies = other.m_policies;
+            this->relink();
+        }
+        return *this;
+    }
+
+    void event_index::set(const symbol* name, listener const& l)
+    {
+        m_exact[name] = l;
+    }
+
+    bool event_index::erase(const symbol* name)
+    {
+        return m_exact.erase(name) > 0;
+    }
+
+    void event_index::set_pattern(std::string const& pattern, listener const& l)
+    {
+        pattern_entry& e = m_patterns[pattern];
+        e.l = l;
+        e.order = m_order++;
+        this->build();
+    }
+
+    bool event_index::erase_pattern(std::string const& pattern)
+    {
+        if(m_patterns.erase(pattern) == 0)
+        {
+            return false;
+        }
+        this->build();
+        return true;
+    }
+
+    void event_index::set_any(listener const& l)
+    {
+        m_any = l;
+    }
+
+    void event_index::clear()
+    {
+        m_exact.clear();
+        m_patterns.clear();
+        m_any = nullptr;
+        this->build();
+    }
+
+    void event_index::set_policy(const symbol* name, std::shared_ptr<inbound_policy> const& policy)
+    {
+        if(policy)
+        {
+            m_policies[name] = policy;
+        }
+        else
+        {
+            m_policies.erase(name);
+        }
+    }
+
+    std::shared_ptr<inbound_policy> event_index::policy(const symbol* name) const
+    {
+        if(m_policies.empty())
+        {
+            return std::shared_ptr<inbound_policy>();
+        }
+        auto it = m_policies.find(name);
+        return it != m_policies.end() ? it->second : std::shared_ptr<inbound_policy>();
+    }
+
+    void event_index::build()
+    {
+        m_nodes.assign(1, node());
+        m_nodes[0].star = 0;
+        m_nodes[0].single = 0;
+        m_nodes[0].is_star = false;
+        m_nodes[0].terminal = nullptr;
+        for(auto it = m_patterns.begin(); it != m_patterns.end(); ++it)
+        {
+            unsigned current = 0;
+            std::string const& pattern = it->first;
+            for(std::size_t i = 0; i < pattern.size(); ++i)
+            {
+                char c = pattern[i];
+                if(c == '*' && m_nodes[current].is_star)
+                {
+                    continue;//"**" is the same as "*".
+                }
+                unsigned child = c == '*' ? m_nodes[current].star :
+                                 c == '?' ? m_nodes[current].single : 0;
+                if(c != '*' && c != '?')
+                {
+                    auto found = m_nodes[current].next.find(c);
+                    child = found != m_nodes[current].next.end() ? found->second : 0;
+                }
+                if(child == 0)
+                {
+                    node n;
+                    n.star = 0;
+                    n.single = 0;
+                    n.is_star = c == '*';
+                    n.terminal = nullptr;
+                    child = (unsigned)m_nodes.size();
+                    m_nodes.push_back(n);
+                    if(c == '*') m_nodes[current].star = child;
+                    else if(c == '?') m_nodes[current].single = child;
+                    else m_nodes[current].next[c] = child;
+                }
+                current = child;
+            }
+            m_nodes[current].terminal = &it->second;
+        }
+    }
+
+    void event_index::relink()
+    {
+        //same walk as build, every node it needs is there already.
+        for(auto it = m_patterns.begin(); it != m_patterns.end(); ++it)
+        {
+            unsigned current = 0;
+            std::string const& pattern = it->first;
+            for(std::size_t i = 0; i < pattern.size(); ++i)
+            {
+                char c = pattern[i];
+                if(c == '*')
+                {
+                    current = m_nodes[current].is_star ? current : m_nodes[current].star;
+                }
+                else if(c == '?')
+                {
+                    current = m_nodes[current].single;
+                }
+                else
+                {
+                    current = m_nodes[current].next.find(c)->second;
+                }
+            }
+            m_nodes[current].terminal = &it->second;
+        }
+    }
+
+    void event_index::closure(std::vector<unsigned>& states) const
+    {
+        //a star also matches nothing, so being at a node means being at its star too.
+        for(std::size_t i = 0; i < states.size(); ++i)
+        {
+            unsigned star = m_nodes[states[i]].star;
+            if(star != 0)
+            {
+                add_state(states, star);
+            }
+        }
+    }
+
+    void event_index::match(const symbol* sym, std::string const& name, std::vector<const listener*>& out) const
+    {
+        scratch s;
+        this->match(sym, name, out, s);
+    }
+
+    void event_index::match(const symbol* sym, std::string const& name, std::vector<const listener*>& out, scratch& s) const
+    {
+        if(m_any)
+        {
+            out.push_back(&m_any);
+        }
+        if(sym && !m_exact.empty())
+        {
+            auto exact = m_exact.find(sym);
+            if(exact != m_exact.end() && exact->second)
+            {
+                out.push_back(&exact->second);
+            }
+        }
+        if(!m_patterns.empty())
+        {
+            std::vector<unsigned>& states = s.states;
+            std::vector<unsigned>& next = s.next;
+            states.assign(1, 0);
+            this->closure(states);
+            for(std::size_t i = 0; i < name.size() && !states.empty(); ++i)
+            {
+                next.clear();
+                for(std::size_t j = 0; j < states.size(); ++j)
+                {
+                    node const& n = m_nodes[states[j]];
+                    if(n.is_star)
+                    {
+                        add_state(next, states[j]);
+                    }
+                    if(n.single != 0)
+                    {
+                        add_state(next, n.single);
+                    }
+                    auto it = n.next.find(name[i]);
+                    if(it != n.next.end())
+                    {
+                        add_state(next, it->second);
+                    }
+                }
+                this->closure(next);
+                states.swap(next);
+            }
+            //the states left are the matches, sorted in place by registration.
+            states.erase(std::remove_if(states.begin(), states.end(), [this](unsigned state)
+            {
+                const pattern_entry* e = m_nodes[state].terminal;
+                return !e || !e->l;
+            }), states.end());
+            std::sort(states.begin(), states.end(), [this](unsigned a, unsigned b)
+            {
+                return m_nodes[a].terminal->order < m_nodes[b].terminal->order;
+            });
+            for(std::size_t j = 0; j < states.size(); ++j)
+            {
+                out.push_back(&m_nodes[states[j]].terminal->l);
+            }
+        }
+    }
+}
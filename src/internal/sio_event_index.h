@@ -0,0 +1,110 @@
+//
+//  sio_event_index.h
+//
+//  Listeners of a socket by exact name, by glob pattern and catch-all.
+//
+
+#ifndef SIO_EVENT_INDEX_H
+#define SIO_EVENT_INDEX_H
+
+#include "../sio_socket.h"
+#include "sio_symbol_table.h"
+#include "sio_inbound_policy.h"
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sio
+{
+    // Exact names sit in a hash map keyed by their interned symbol. Patterns
+    // ('*' any run of characters, '?' one character) are compiled into a
+    // trie which match walks once
+    // along the event name, so the cost depends on the name's length and not
+    // on how many names or patterns are registered. An index is treated as
+    // immutable once published, changes are made to a copy.
+    class event_index
+    {
+    public:
+        typedef socket::event_listener listener;
+
+        // States of the pattern walk, kept by the caller between matches so
+        // the walk reuses their allocations.
+        struct scratch
+        {
+            std::vector<unsigned> states;
+            std::vector<unsigned> next;
+        };
+
+        event_index();
+
+        // The trie points into the patterns, a copy takes the nodes and
+        // points them at its own patterns.
+        event_index(event_index const& other);
+
+        event_index& operator=(event_index const& other);
+
+        void set(const symbol* name, listener const& l);
+
+        bool erase(const symbol* name);
+
+        void set_pattern(std::string const& pattern, listener const& l);
+
+        bool erase_pattern(std::string const& pattern);
+
+        void set_any(listener const& l);
+
+        // Listeners only, inbound policies stay.
+        void clear();
+
+        // nullptr removes it.
+        void set_policy(const symbol* name, std::shared_ptr<inbound_policy> const& policy);
+
+        std::shared_ptr<inbound_policy> policy(const symbol* name) const;
+
+        // The catch-all first as with socket.onAny() in JS, then the exact
+        // listener, then matching patterns in the order they were registered. sym is the interned name if there
+        // is one, a name without can't have an exact listener.
+        void match(const symbol* sym, std::string const& name, std::vector<const listener*>& out, scratch& s) const;
+
+        void match(const symbol* sym, std::string const& name, std::vector<const listener*>& out) const;
+
+    private:
+        struct pattern_entry
+        {
+            listener l;
+            unsigned order;
+        };
+
+        struct node
+        {
+            std::map<char, unsigned> next;
+            unsigned star;   // child matching any run, 0 for none
+            unsigned single; // child matching one character, 0 for none
+            bool is_star;
+            const pattern_entry* terminal;
+        };
+
+        void build();
+
+        // Points the terminals of copied nodes at this index's patterns.
+        void relink();
+
+        void closure(std::vector<unsigned>& states) const;
+
+        std::unordered_map<const symbol*, listener> m_exact;
+
+        std::map<std::string, pattern_entry> m_patterns;
+
+        unsigned m_order;
+
+        // m_nodes[0] is the root, terminal points into m_patterns.
+        std::vector<node> m_nodes;
+
+        listener m_any;
+
+        // Shared between copies, their state outlives rebinding.
+        std::unordered_map<const symbol*, std::shared_ptr<inbound_policy> > m_policies;
+    };
+}
+#endif // SIO_EVENT_INDEX_H
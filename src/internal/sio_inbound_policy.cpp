@@ -0,0 +1,108 @@
+//
+//  sio_inbound_policy.cpp
+//
+//  Conflation and overload shedding of inbound events ahead of the executor.
+//
+
+#include "sio_inbound_policy.h"
+#include <algorithm>
+
+namespace sio
+{
+    bool inbound_policy::slot::offer(std::shared_ptr<event> const& ev)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_event = ev;
+        bool queued = m_queued;
+        m_queued = true;
+        return queued;
+    }
+
+    std::shared_ptr<event> inbound_policy::slot::take()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        std::shared_ptr<event> ev;
+        ev.swap(m_event);
+        m_queued = false;
+        return ev;
+    }
+
+    bool inbound_policy::slot::idle()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return !m_queued;
+    }
+
+    inbound_policy::inbound_policy(socket::conflation_key const& key, bool conflate, unsigned every_nth):
+        m_key(key),
+        m_conflate(conflate),
+        m_every_nth(every_nth ? every_nth : 1),
+        m_sweep_at(64),
+        m_skipped(0),
+        m_busy(0)
+    {
+    }
+
+    std::shared_ptr<inbound_policy> inbound_policy::conflate(socket::conflation_key const& key)
+    {
+        return std::shared_ptr<inbound_policy>(new inbound_policy(key, true, 1));
+    }
+
+    std::shared_ptr<inbound_policy> inbound_policy::sample(unsigned every_nth)
+    {
+        return std::shared_ptr<inbound_policy>(new inbound_policy(nullptr, false, every_nth));
+    }
+
+    inbound_policy::verdict inbound_policy::admit(std::string const& key, std::shared_ptr<event> const& ev, std::shared_ptr<slot>& s)
+    {
+        if(m_conflate)
+        {
+            if(m_slots.size() >= m_sweep_at)
+            {
+                this->sweep();
+            }
+            std::shared_ptr<slot>& entry = m_slots[key];
+            if(!entry)
+            {
+                entry = std::make_shared<slot>();
+            }
+            if(entry->offer(ev))
+            {
+                return conflated;
+            }
+            s = entry;
+        }
+        else if(m_busy.load() > 0)
+        {
+            //overloaded, let one in every_nth through.
+            if(++m_skipped < m_every_nth)
+            {
+                return dropped;
+            }
+            m_skipped = 0;
+        }
+        else
+        {
+            m_skipped = 0;
+        }
+        ++m_busy;
+        return deliver;
+    }
+
+    void inbound_policy::sweep()
+    {
+        for(auto it = m_slots.begin(); it != m_slots.end();)
+        {
+            if(it->second->idle())
+            {
+                //a new event of the key gets a new slot and dispatch.
+                it = m_slots.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        m_sweep_at = std::max<std::size_t>(64, m_slots.size() * 2);
+    }
+}
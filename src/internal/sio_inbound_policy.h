@@ -0,0 +1,98 @@
+//
+//  sio_inbound_policy.h
+//
+//  Conflation and overload shedding of inbound events ahead of the executor.
+//
+
+#ifndef SIO_INBOUND_POLICY_H
+#define SIO_INBOUND_POLICY_H
+
+#include "../sio_socket.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace sio
+{
+    // Decides on the network thread whether an event of one name goes to the
+    // executor. Conflating keeps one dispatch per key waiting, a newer event
+    // of the key replaces the one it will deliver. Sampling delivers one in
+    // every_nth events while the listeners are still busy with an earlier one.
+    class inbound_policy
+    {
+    public:
+        enum verdict
+        {
+            deliver,
+            conflated,
+            dropped
+        };
+
+        // Holds the newest event of a key until its dispatch starts.
+        class slot
+        {
+        public:
+            slot(): m_queued(false) {}
+
+            // Network thread, true if the dispatch already waiting delivers ev.
+            bool offer(std::shared_ptr<event> const& ev);
+
+            // Executor, the event to deliver. The next offer needs a new dispatch.
+            std::shared_ptr<event> take();
+
+            // No dispatch waits for it.
+            bool idle();
+
+        private:
+            std::mutex m_mutex;
+
+            std::shared_ptr<event> m_event;
+
+            bool m_queued;
+        };
+
+        // key nullptr conflates all events of the name.
+        static std::shared_ptr<inbound_policy> conflate(socket::conflation_key const& key);
+
+        static std::shared_ptr<inbound_policy> sample(unsigned every_nth);
+
+        // The key ev is conflated by, empty when sampling.
+        std::string key(event const& ev) const { return m_conflate && m_key ? m_key(ev) : std::string(); }
+
+        // Network thread. When delivered with conflation, s is the slot the
+        // dispatch takes its event from.
+        verdict admit(std::string const& key, std::shared_ptr<event> const& ev, std::shared_ptr<slot>& s);
+
+        // Executor, once the listeners of a delivered event returned.
+        void done() { --m_busy; }
+
+        // Keys with a slot, network thread.
+        std::size_t slots() const { return m_slots.size(); }
+
+    private:
+        inbound_policy(socket::conflation_key const& key, bool conflate, unsigned every_nth);
+
+        socket::conflation_key m_key;
+
+        bool m_conflate;
+
+        unsigned m_every_nth;
+
+        // Drops the slots of keys no dispatch waits for.
+        void sweep();
+
+        // Network thread only. Idle slots are swept once the map doubled
+        // since the last sweep, keys come and go with the data.
+        std::unordered_map<std::string, std::shared_ptr<slot> > m_slots;
+
+        std::size_t m_sweep_at;
+
+        unsigned m_skipped;
+
+        // Delivered events whose listeners haven't returned yet.
+        std::atomic<unsigned> m_busy;
+    };
+}
+#endif // SIO_INBOUND_POLICY_H
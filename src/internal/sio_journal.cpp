@@ -0,0 +1,273 @@
+//
+//  sio_journal.cpp
+//
+//  Outbound packets kept in a memory mapped ring file while disconnected.
+//
+
+#include "sio_journal.h"
+#include <boost/interprocess/exceptions.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace sio
+{
+    using namespace boost::interprocess;
+
+    namespace
+    {
+        const std::uint32_t kMAGIC = 0x4a4f4953; // "SIOJ"
+        const std::uint32_t kVERSION = 2;
+        // The data area starts on its own cache line.
+        const std::size_t kDATA_OFFSET = 64;
+    }
+
+    // Record layout in the ring, integers in host byte order:
+    // u32 length of the rest | u32 frame count | per frame: u8 binary, u32 size, bytes.
+
+    journal::journal():
+        m_header(nullptr),
+        m_data(nullptr),
+        m_count(0)
+    {
+    }
+
+    journal::~journal()
+    {
+        this->close();
+    }
+
+    bool journal::open(std::string const& path, std::size_t capacity)
+    {
+        this->close();
+        if(capacity == 0)
+        {
+            return false;
+        }
+        try
+        {
+            std::size_t file_size = kDATA_OFFSET + capacity;
+            bool fresh = false;
+            {
+                std::fstream probe(path.c_str(), std::ios::in | std::ios::binary);
+                if(probe)
+                {
+                    probe.seekg(0, std::ios::end);
+                    std::size_t existing = static_cast<std::size_t>(probe.tellg());
+                    header h;
+                    probe.seekg(0);
+                    if(existing == 0)
+                    {
+                        fresh = true;
+                    }
+                    else if(existing > kDATA_OFFSET && probe.read(reinterpret_cast<char*>(&h), sizeof(h)) &&
+                            h.magic == kMAGIC && h.version == kVERSION && h.capacity + kDATA_OFFSET == existing)
+                    {
+                        file_size = existing;
+                    }
+                    else
+                    {
+                        //not ours, or of another version, leave it alone.
+                        return false;
+                    }
+                }
+                else
+                {
+                    fresh = true;
+                }
+            }
+            if(fresh)
+            {
+                std::filebuf fbuf;
+                if(!fbuf.open(path.c_str(), std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary))
+                {
+                    return false;
+                }
+                fbuf.pubseekoff(file_size - 1, std::ios::beg);
+                fbuf.sputc(0);
+            }
+            file_mapping file(path.c_str(), read_write);
+            mapped_region region(file, read_write, 0, file_size);
+            m_file.swap(file);
+            m_region.swap(region);
+        }
+        catch(interprocess_exception const&)
+        {
+            this->close();
+            return false;
+        }
+        m_header = static_cast<header*>(m_region.get_address());
+        m_data = static_cast<char*>(m_region.get_address()) + kDATA_OFFSET;
+        if(m_header->magic != kMAGIC)
+        {
+            m_header->version = kVERSION;
+            m_header->capacity = capacity;
+            m_header->head = 0;
+            m_header->tail = 0;
+            m_header->magic = kMAGIC;
+        }
+        if(!this->count_records())
+        {
+            this->close();
+            return false;
+        }
+        return true;
+    }
+
+    void journal::close()
+    {
+        if(m_header)
+        {
+            m_region.flush();
+        }
+        mapped_region().swap(m_region);
+        file_mapping().swap(m_file);
+        m_header = nullptr;
+        m_data = nullptr;
+        m_count = 0;
+    }
+
+    bool journal::append(record const& r)
+    {
+        if(!m_header)
+        {
+            return false;
+        }
+        std::uint64_t len = 4;
+        for(auto it = r.begin(); it != r.end(); ++it)
+        {
+            len += 5 + it->payload->size();
+        }
+        if(4 + len > m_header->capacity - (m_header->tail - m_header->head))
+        {
+            return false;
+        }
+        std::uint64_t pos = m_header->tail % m_header->capacity;
+        std::uint32_t value = static_cast<std::uint32_t>(len);
+        this->write(pos, &value, 4);
+        pos = (pos + 4) % m_header->capacity;
+        value = static_cast<std::uint32_t>(r.size());
+        this->write(pos, &value, 4);
+        pos = (pos + 4) % m_header->capacity;
+        for(auto it = r.begin(); it != r.end(); ++it)
+        {
+            char binary = it->binary ? 1 : 0;
+            this->write(pos, &binary, 1);
+            pos = (pos + 1) % m_header->capacity;
+            value = static_cast<std::uint32_t>(it->payload->size());
+            this->write(pos, &value, 4);
+            pos = (pos + 4) % m_header->capacity;
+            this->write(pos, it->payload->data(), it->payload->size());
+            pos = (pos + it->payload->size()) % m_header->capacity;
+        }
+        //publish the record only after its bytes are in place.
+        m_header->tail += 4 + len;
+        ++m_count;
+        return true;
+    }
+
+    bool journal::front(record& r) const
+    {
+        r.clear();
+        if(!m_header || m_count == 0)
+        {
+            return false;
+        }
+        std::uint64_t pos = (m_header->head + 4) % m_header->capacity;
+        std::uint32_t frames;
+        this->read(pos, &frames, 4);
+        pos = (pos + 4) % m_header->capacity;
+        r.reserve(frames);
+        for(std::uint32_t i = 0; i < frames; ++i)
+        {
+            char binary;
+            this->read(pos, &binary, 1);
+            pos = (pos + 1) % m_header->capacity;
+            std::uint32_t size;
+            this->read(pos, &size, 4);
+            pos = (pos + 4) % m_header->capacity;
+            std::shared_ptr<std::string> payload = std::make_shared<std::string>(size, '\0');
+            if(size > 0)
+            {
+                this->read(pos, &(*payload)[0], size);
+            }
+            pos = (pos + size) % m_header->capacity;
+            frame f;
+            f.binary = binary != 0;
+            f.payload = payload;
+            r.push_back(f);
+        }
+        return true;
+    }
+
+    void journal::pop()
+    {
+        if(!m_header || m_count == 0)
+        {
+            return;
+        }
+        m_header->head += 4 + this->record_length(m_header->head % m_header->capacity);
+        --m_count;
+    }
+
+    bool journal::empty() const
+    {
+        return m_count == 0;
+    }
+
+    std::size_t journal::size() const
+    {
+        return m_count;
+    }
+
+    std::size_t journal::used_bytes() const
+    {
+        return m_header ? static_cast<std::size_t>(m_header->tail - m_header->head) : 0;
+    }
+
+    std::size_t journal::capacity() const
+    {
+        return m_header ? static_cast<std::size_t>(m_header->capacity) : 0;
+    }
+
+    void journal::write(std::uint64_t pos, void const* data, std::size_t len)
+    {
+        std::size_t first = static_cast<std::size_t>(std::min<std::uint64_t>(len, m_header->capacity - pos));
+        std::memcpy(m_data + pos, data, first);
+        std::memcpy(m_data, static_cast<char const*>(data) + first, len - first);
+    }
+
+    void journal::read(std::uint64_t pos, void* data, std::size_t len) const
+    {
+        std::size_t first = static_cast<std::size_t>(std::min<std::uint64_t>(len, m_header->capacity - pos));
+        std::memcpy(data, m_data + pos, first);
+        std::memcpy(static_cast<char*>(data) + first, m_data, len - first);
+    }
+
+    std::uint32_t journal::record_length(std::uint64_t pos) const
+    {
+        std::uint32_t len;
+        this->read(pos, &len, 4);
+        return len;
+    }
+
+    bool journal::count_records()
+    {
+        m_count = 0;
+        if(m_header->head > m_header->tail || m_header->tail - m_header->head > m_header->capacity)
+        {
+            return false;
+        }
+        std::uint64_t pos = m_header->head;
+        while(pos < m_header->tail)
+        {
+            if(m_header->tail - pos < 8)
+            {
+                return false;
+            }
+            pos += 4 + this->record_length(pos % m_header->capacity);
+            ++m_count;
+        }
+        return pos == m_header->tail;
+    }
+}
@@ -0,0 +1,97 @@
+//
+//  sio_journal.h
+//
+//  Outbound packets kept in a memory mapped ring file while disconnected.
+//
+
+#ifndef SIO_JOURNAL_H
+#define SIO_JOURNAL_H
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sio
+{
+    // Ring of encoded packets in a file, which survives disconnects and
+    // process restarts. A record holds the frames of one packet, the text
+    // frame first and its binary attachments after it. Not thread safe.
+    class journal
+    {
+    public:
+        struct frame
+        {
+            bool binary;
+            std::shared_ptr<const std::string> payload;
+        };
+
+        typedef std::vector<frame> record;
+
+        journal();
+
+        ~journal();
+
+        // Maps the file, creating it when missing or empty. An existing
+        // journal keeps its records and its capacity. Fails rather than
+        // overwrite a file that isn't a journal or whose records don't add up.
+        bool open(std::string const& path, std::size_t capacity);
+
+        void close();
+
+        bool is_open() const { return m_header != nullptr; }
+
+        // Returns false when the record doesn't fit in the free space.
+        bool append(record const& r);
+
+        // Reads the oldest record without removing it.
+        bool front(record& r) const;
+
+        void pop();
+
+        bool empty() const;
+
+        std::size_t size() const;
+
+        std::size_t used_bytes() const;
+
+        std::size_t capacity() const;
+
+    private:
+        // head and tail count bytes since the journal was created, a position
+        // in the ring is taken modulo capacity. append commits with a single
+        // store to tail and pop with one to head, so a process dying between
+        // any two writes leaves a consistent journal.
+        struct header
+        {
+            std::uint32_t magic;
+            std::uint32_t version;
+            std::uint64_t capacity;
+            std::uint64_t head;
+            std::uint64_t tail;
+        };
+
+        void write(std::uint64_t pos, void const* data, std::size_t len);
+
+        void read(std::uint64_t pos, void* data, std::size_t len) const;
+
+        std::uint32_t record_length(std::uint64_t pos) const;
+
+        // Counts the records from head to tail, false if they don't end at tail.
+        bool count_records();
+
+        boost::interprocess::file_mapping m_file;
+
+        boost::interprocess::mapped_region m_region;
+
+        header* m_header;
+
+        char* m_data;
+
+        // Not stored, counted when opened.
+        std::size_t m_count;
+    };
+}
+#endif // SIO_JOURNAL_H
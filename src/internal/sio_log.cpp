@@ -0,0 +1,174 @@
+//
+//  sio_log.cpp
+//
+//  Levelled logging of the library and of websocketpp's loggers.
+//
+
+#include "sio_log.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace sio
+{
+    namespace
+    {
+        class console_logger : public logger
+        {
+        public:
+            void log(level l, char const* message, std::size_t length)
+            {
+                std::ostream& out = l >= level_warning ? std::cerr : std::cout;
+                std::lock_guard<std::mutex> guard(m_mutex);
+                out.write(message, length);
+                out << std::endl;
+            }
+
+        private:
+            //keeps lines of different threads apart.
+            std::mutex m_mutex;
+        };
+    }
+
+    log_sink& log_sink::global()
+    {
+        static log_sink sink;
+        return sink;
+    }
+
+    std::shared_ptr<logger> const& log_sink::console()
+    {
+        static const std::shared_ptr<logger> l = std::make_shared<console_logger>();
+        return l;
+    }
+
+    log_sink::log_sink():
+#if DEBUG || _DEBUG
+        m_level(logger::level_debug),
+#else
+        m_level(logger::level_info),
+#endif
+        m_logger(console())
+    {
+    }
+
+    void log_sink::set_logger(std::shared_ptr<logger> const& l)
+    {
+        std::atomic_store(&m_logger, l ? l : console());
+    }
+
+    void log_sink::write(logger::level l, char const* message, std::size_t length)
+    {
+        std::shared_ptr<logger> current = std::atomic_load(&m_logger);
+        current->log(l, message, length);
+    }
+
+    log_line::log_line():
+        std::ostream(static_cast<std::streambuf*>(this))
+    {
+        setp(m_data, m_data + capacity);
+    }
+
+    std::size_t log_line::length() const
+    {
+        std::size_t length = pptr() - pbase();
+        while(length > 0 && (m_data[length - 1] == '\n' || m_data[length - 1] == '\r'))
+        {
+            --length;
+        }
+        return length;
+    }
+
+    std::streambuf::int_type log_line::overflow(std::streambuf::int_type c)
+    {
+        //full, the rest of the line is cut.
+        return std::streambuf::traits_type::not_eof(c);
+    }
+
+    log_bridge::log_bridge(logger::level l):
+        std::ostream(static_cast<std::streambuf*>(this)),
+        m_level(l)
+    {
+        setp(m_data, m_data + sizeof(m_data));
+    }
+
+    std::streambuf::int_type log_bridge::overflow(std::streambuf::int_type c)
+    {
+        //a line longer than the buffer goes out in pieces.
+        this->sync();
+        if(!std::streambuf::traits_type::eq_int_type(c, std::streambuf::traits_type::eof()))
+        {
+            sputc(std::streambuf::traits_type::to_char_type(c));
+        }
+        return std::streambuf::traits_type::not_eof(c);
+    }
+
+    int log_bridge::sync()
+    {
+        std::size_t length = pptr() - pbase();
+        while(length > 0 && (m_data[length - 1] == '\n' || m_data[length - 1] == '\r'))
+        {
+            --length;
+        }
+        if(length > 0 && log_sink::global().enabled(m_level))
+        {
+            log_sink::global().write(m_level, m_data, length);
+        }
+        setp(m_data, m_data + sizeof(m_data));
+        return 0;
+    }
+
+    async_logger::async_logger(std::shared_ptr<logger> const& sink, std::size_t capacity):
+        m_sink(sink),
+        m_records(capacity),
+        m_dropped(0),
+        m_stop(false)
+    {
+        m_thread = std::thread(&async_logger::run, this);
+    }
+
+    async_logger::~async_logger()
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_one();
+        m_thread.join();
+    }
+
+    void async_logger::log(level l, char const* message, std::size_t length)
+    {
+        record r;
+        r.l = l;
+        r.length = std::min<std::size_t>(length, sizeof(r.text));
+        std::memcpy(r.text, message, r.length);
+        if(!m_records.push(r))
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void async_logger::run()
+    {
+        record r;
+        while(true)
+        {
+            while(m_records.pop(r))
+            {
+                m_sink->log(r.l, r.text, r.length);
+            }
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if(m_stop)
+            {
+                break;
+            }
+            //producers never wait on the mutex, so poll rather than be woken.
+            m_wake.wait_for(lock, std::chrono::milliseconds(10));
+        }
+        while(m_records.pop(r))
+        {
+            m_sink->log(r.l, r.text, r.length);
+        }
+    }
+}
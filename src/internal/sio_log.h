@@ -0,0 +1,140 @@
+//
+//  sio_log.h
+//
+//  Levelled logging of the library and of websocketpp's loggers.
+//
+
+#ifndef SIO_LOG_H
+#define SIO_LOG_H
+
+#include "../sio_client.h"
+#include "sio_mpsc_ring.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+
+// Formats x into a line on the stack and hands it to the process wide
+// logger, only if level is enabled. A disabled line costs a relaxed load.
+#define SIO_LOG(level, x) \
+    do \
+    { \
+        if(sio::log_sink::global().enabled(level)) \
+        { \
+            sio::log_line sio_log_line_; \
+            sio_log_line_ << x; \
+            sio::log_sink::global().write(level, sio_log_line_.data(), sio_log_line_.length()); \
+        } \
+    } while(0)
+
+// Debug lines, formatted only once client::set_log_level(logger::level_debug).
+#define SIO_LOG_DEBUG(x) SIO_LOG(sio::logger::level_debug, x)
+
+namespace sio
+{
+    // The logger and level shared by all clients of the process.
+    class log_sink
+    {
+    public:
+        static log_sink& global();
+
+        // Writes debug and info lines to stdout, the rest to stderr.
+        static std::shared_ptr<logger> const& console();
+
+        bool enabled(logger::level l) const { return l >= m_level.load(std::memory_order_relaxed); }
+
+        void set_level(logger::level l) { m_level.store(l, std::memory_order_relaxed); }
+
+        // nullptr for the console.
+        void set_logger(std::shared_ptr<logger> const& l);
+
+        void write(logger::level l, char const* message, std::size_t length);
+
+    private:
+        log_sink();
+
+        std::atomic<int> m_level;
+
+        // Read and replaced with std::atomic_load and std::atomic_store.
+        std::shared_ptr<logger> m_logger;
+    };
+
+    // Fixed buffer a line is formatted into without allocating, longer
+    // lines are cut. A trailing newline isn't part of the line.
+    class log_line : private std::streambuf, public std::ostream
+    {
+    public:
+        enum { capacity = 256 };
+
+        log_line();
+
+        char const* data() const { return m_data; }
+
+        std::size_t length() const;
+
+    private:
+        std::streambuf::int_type overflow(std::streambuf::int_type c);
+
+        char m_data[capacity];
+    };
+
+    // Stream given to a websocketpp logger, which writes a line and flushes
+    // it. Each line goes to the log at the bridge's level.
+    class log_bridge : private std::streambuf, public std::ostream
+    {
+    public:
+        explicit log_bridge(logger::level l);
+
+    private:
+        std::streambuf::int_type overflow(std::streambuf::int_type c);
+
+        int sync();
+
+        logger::level m_level;
+
+        char m_data[log_line::capacity];
+    };
+
+    // Copies lines into a lock-free ring, a thread of its own hands them to
+    // the sink. Lines arriving while the ring is full are dropped.
+    class async_logger : public logger
+    {
+    public:
+        async_logger(std::shared_ptr<logger> const& sink, std::size_t capacity);
+
+        // Hands over what is queued, then stops the thread.
+        ~async_logger();
+
+        void log(level l, char const* message, std::size_t length);
+
+        std::size_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    private:
+        struct record
+        {
+            level l;
+            std::size_t length;
+            char text[log_line::capacity];
+        };
+
+        void run();
+
+        std::shared_ptr<logger> m_sink;
+
+        mpsc_ring<record> m_records;
+
+        std::atomic<std::size_t> m_dropped;
+
+        std::mutex m_mutex;
+
+        std::condition_variable m_wake;
+
+        bool m_stop;
+
+        std::thread m_thread;
+    };
+}
+#endif // SIO_LOG_H
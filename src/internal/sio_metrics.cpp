@@ -0,0 +1,107 @@
+//
+//  sio_metrics.cpp
+//
+//  Counters and latency histograms of a client.
+//
+
+#include "sio_metrics.h"
+
+namespace sio
+{
+    unsigned long long client::histogram::percentile(double q) const
+    {
+        if(count == 0)
+        {
+            return 0;
+        }
+        double rank = q * count;
+        unsigned long long seen = 0;
+        for(unsigned i = 0; i < bucket_count; ++i)
+        {
+            seen += buckets[i];
+            if(seen > 0 && seen >= rank)
+            {
+                return 1ull << i;
+            }
+        }
+        return 1ull << (bucket_count - 1);
+    }
+
+    latency_histogram::latency_histogram():
+        m_count(0),
+        m_sum(0)
+    {
+        for(unsigned i = 0; i < client::histogram::bucket_count; ++i)
+        {
+            m_buckets[i] = 0;
+        }
+    }
+
+    void latency_histogram::record(std::chrono::steady_clock::duration d)
+    {
+        long long us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        unsigned long long value = us > 0 ? static_cast<unsigned long long>(us) : 0;
+        unsigned bucket = 0;
+        for(unsigned long long v = value; v != 0 && bucket + 1 < client::histogram::bucket_count; v >>= 1)
+        {
+            ++bucket;
+        }
+        m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    void latency_histogram::snapshot(client::histogram& h) const
+    {
+        h.count = m_count.load(std::memory_order_relaxed);
+        h.sum = m_sum.load(std::memory_order_relaxed);
+        for(unsigned i = 0; i < client::histogram::bucket_count; ++i)
+        {
+            h.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    client_metrics::client_metrics():
+        m_bytes_in(0),
+        m_bytes_out(0),
+        m_frames_in(0),
+        m_frames_out(0),
+        m_encodes(0),
+        m_reconnect_attempts(0),
+        m_reconnects(0)
+    {
+        for(unsigned i = 0; i < type_count; ++i)
+        {
+            m_packets_in[i] = 0;
+            m_packets_out[i] = 0;
+        }
+    }
+
+    void client_metrics::count(std::atomic<unsigned long long>* counters, int type)
+    {
+        if(type < 0 || type >= type_count)
+        {
+            //undetermined, nothing to count.
+            return;
+        }
+        counters[type].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void client_metrics::snapshot(client::metrics& m) const
+    {
+        m.bytes_in = m_bytes_in.load(std::memory_order_relaxed);
+        m.bytes_out = m_bytes_out.load(std::memory_order_relaxed);
+        m.frames_in = m_frames_in.load(std::memory_order_relaxed);
+        m.frames_out = m_frames_out.load(std::memory_order_relaxed);
+        for(unsigned i = 0; i < type_count; ++i)
+        {
+            m.packets_in[i] = m_packets_in[i].load(std::memory_order_relaxed);
+            m.packets_out[i] = m_packets_out[i].load(std::memory_order_relaxed);
+        }
+        m_encode_time.snapshot(m.encode_time);
+        m_decode_time.snapshot(m.decode_time);
+        m_rtt.snapshot(m.rtt);
+        m.reconnect_attempts = m_reconnect_attempts.load(std::memory_order_relaxed);
+        m.reconnects = m_reconnects.load(std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,109 @@
+//
+//  sio_metrics.h
+//
+//  Counters and latency histograms of a client.
+//
+
+#ifndef SIO_METRICS_H
+#define SIO_METRICS_H
+
+#include "../sio_client.h"
+#include <atomic>
+#include <chrono>
+
+namespace sio
+{
+    // Durations by powers of two of microseconds, recorded from any thread.
+    class latency_histogram
+    {
+    public:
+        latency_histogram();
+
+        void record(std::chrono::steady_clock::duration d);
+
+        void snapshot(client::histogram& h) const;
+
+    private:
+        std::atomic<unsigned long long> m_buckets[client::histogram::bucket_count];
+
+        std::atomic<unsigned long long> m_count;
+
+        std::atomic<unsigned long long> m_sum;
+    };
+
+    // Relaxed atomics, a counter costs an uncontended add where it is bumped.
+    // Encoding happens on the emitting threads, the rest on the network thread.
+    class client_metrics
+    {
+    public:
+        // One packet in timing_period is timed, reading the clock twice per
+        // packet would cost more than the counting.
+        static const unsigned timing_period = 16;
+
+        client_metrics();
+
+        // Returns whether to time decoding this frame.
+        bool frame_in(std::size_t bytes)
+        {
+            m_bytes_in.fetch_add(bytes, std::memory_order_relaxed);
+            return m_frames_in.fetch_add(1, std::memory_order_relaxed) % timing_period == 0;
+        }
+
+        void frame_out(std::size_t bytes)
+        {
+            m_frames_out.fetch_add(1, std::memory_order_relaxed);
+            m_bytes_out.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        void packet_in(int type) { count(m_packets_in, type); }
+
+        // Counted as the packet is handed to the transport.
+        void packet_out(int type) { count(m_packets_out, type); }
+
+        // Returns whether to time encoding the next packet.
+        bool encoding() { return m_encodes.fetch_add(1, std::memory_order_relaxed) % timing_period == 0; }
+
+        void reconnect_attempt() { m_reconnect_attempts.fetch_add(1, std::memory_order_relaxed); }
+
+        void reconnected() { m_reconnects.fetch_add(1, std::memory_order_relaxed); }
+
+        latency_histogram& encode_time() { return m_encode_time; }
+
+        latency_histogram& decode_time() { return m_decode_time; }
+
+        latency_histogram& rtt() { return m_rtt; }
+
+        // Fills in what the client counts itself, not the queues, TLS and sockets.
+        void snapshot(client::metrics& m) const;
+
+    private:
+        enum { type_count = 7 };
+
+        static void count(std::atomic<unsigned long long>* counters, int type);
+
+        std::atomic<unsigned long long> m_bytes_in;
+
+        std::atomic<unsigned long long> m_bytes_out;
+
+        std::atomic<unsigned long long> m_frames_in;
+
+        std::atomic<unsigned long long> m_frames_out;
+
+        std::atomic<unsigned long long> m_packets_in[type_count];
+
+        std::atomic<unsigned long long> m_packets_out[type_count];
+
+        std::atomic<unsigned long long> m_encodes;
+
+        std::atomic<unsigned> m_reconnect_attempts;
+
+        std::atomic<unsigned> m_reconnects;
+
+        latency_histogram m_encode_time;
+
+        latency_histogram m_decode_time;
+
+        latency_histogram m_rtt;
+    };
+}
+#endif // SIO_METRICS_H
@@ -0,0 +1,112 @@
+//
+//  sio_mpsc_ring.h
+//
+//  Bounded lock-free queue, many threads push and one thread pops.
+//
+
+#ifndef SIO_MPSC_RING_H
+#define SIO_MPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace sio
+{
+    // Dmitry Vyukov's bounded queue: every cell carries a sequence number
+    // telling whose turn it is. Producers claim a position with a CAS on the
+    // tail and publish the cell by bumping its sequence, the consumer owns
+    // the head and needs no atomic read-modify-write at all.
+    template<typename T>
+    class mpsc_ring
+    {
+    public:
+        // Capacity is rounded up to a power of two.
+        explicit mpsc_ring(std::size_t capacity):
+            m_head(0),
+            m_tail(0)
+        {
+            std::size_t size = 2;
+            while(size < capacity)
+            {
+                size <<= 1;
+            }
+            m_mask = size - 1;
+            m_cells.reset(new cell[size]);
+            for(std::size_t i = 0; i < size; ++i)
+            {
+                m_cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        // Any thread, false when full.
+        bool push(T const& value)
+        {
+            std::size_t pos = m_tail.load(std::memory_order_relaxed);
+            while(true)
+            {
+                cell& c = m_cells[pos & m_mask];
+                std::size_t sequence = c.sequence.load(std::memory_order_acquire);
+                std::intptr_t diff = (std::intptr_t)sequence - (std::intptr_t)pos;
+                if(diff == 0)
+                {
+                    if(m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        c.value = value;
+                        c.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if(diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = m_tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Consumer thread only, false when empty or the next cell is still
+        // being written.
+        bool pop(T& value)
+        {
+            cell& c = m_cells[m_head & m_mask];
+            std::size_t sequence = c.sequence.load(std::memory_order_acquire);
+            if(sequence != m_head + 1)
+            {
+                return false;
+            }
+            value = std::move(c.value);
+            c.value = T();
+            c.sequence.store(m_head + m_mask + 1, std::memory_order_release);
+            ++m_head;
+            return true;
+        }
+
+        std::size_t capacity() const { return m_mask + 1; }
+
+    private:
+        struct cell
+        {
+            std::atomic<std::size_t> sequence;
+            T value;
+        };
+
+        std::unique_ptr<cell[]> m_cells;
+
+        std::size_t m_mask;
+
+        // Keeps the consumer's and the producers' index on separate cache lines.
+        char m_pad0[64];
+
+        std::size_t m_head;
+
+        char m_pad1[64];
+
+        std::atomic<std::size_t> m_tail;
+    };
+}
+#endif // SIO_MPSC_RING_H
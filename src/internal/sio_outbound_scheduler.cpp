@@ -0,0 +1,250 @@
+//
+//  sio_outbound_scheduler.cpp
+//
+//  Orders the packets waiting for the transport by lane and namespace.
+//
+
+#include "sio_outbound_scheduler.h"
+#include <algorithm>
+#include <limits>
+
+namespace sio
+{
+    bool conflation_slot::offer(outbound_packet const& value)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_payload = value.payload;
+        m_attachments = value.attachments;
+        bool queued = m_queued;
+        m_queued = true;
+        return queued;
+    }
+
+    void conflation_slot::take(outbound_packet& p)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        p.payload.swap(m_payload);
+        p.attachments.swap(m_attachments);
+        m_payload.reset();
+        m_attachments.clear();
+        m_queued = false;
+    }
+
+    void conflation_slot::cancel()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_payload.reset();
+        m_attachments.clear();
+        m_queued = false;
+    }
+
+    outbound_flow::outbound_flow(unsigned lanes):
+        m_lanes(lanes),
+        m_weight(1),
+        m_packets(0),
+        m_bytes(0)
+    {
+        for(std::size_t i = 0; i < m_lanes.size(); ++i)
+        {
+            m_lanes[i].deficit = 0;
+            m_lanes[i].active = false;
+        }
+    }
+
+    outbound_scheduler::outbound_scheduler(unsigned lanes, std::size_t quantum):
+        m_active(lanes),
+        m_quantum(quantum),
+        m_queued(0)
+    {
+    }
+
+    outbound_flow* outbound_scheduler::get_flow(std::string const& nsp)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        std::unique_ptr<outbound_flow>& f = m_flows[nsp];
+        if(!f)
+        {
+            f.reset(new outbound_flow((unsigned)m_active.size()));
+        }
+        return f.get();
+    }
+
+    void outbound_scheduler::set_weight(std::string const& nsp, unsigned weight)
+    {
+        this->get_flow(nsp)->m_weight.store(weight ? weight : 1, std::memory_order_relaxed);
+    }
+
+    void outbound_scheduler::push(outbound_packet& p)
+    {
+        if(p.lane == lane_trailing)
+        {
+            p.lane = 0;
+            bool found = false;
+            for(std::size_t lane = p.flow->m_lanes.size(); lane-- > 0;)
+            {
+                std::deque<outbound_packet> const& packets = p.flow->m_lanes[lane].packets;
+                if(packets.empty())
+                {
+                    continue;
+                }
+                if(!found)
+                {
+                    p.lane = (unsigned)lane;
+                    found = true;
+                }
+                //due times grow along a lane, a held back packet in a higher
+                //lane must not be overtaken from a lower one.
+                if(packets.back().not_before > p.not_before)
+                {
+                    p.not_before = packets.back().not_before;
+                }
+            }
+        }
+        outbound_flow::lane_queue& q = p.flow->m_lanes[p.lane];
+        if(!q.active)
+        {
+            q.active = true;
+            m_active[p.lane].push_back(p.flow);
+        }
+        q.packets.push_back(std::move(p));
+        ++m_queued;
+    }
+
+    bool outbound_scheduler::pop(outbound_packet& p, std::chrono::steady_clock::time_point now, std::chrono::steady_clock::time_point& next_due)
+    {
+        for(std::size_t lane = 0; lane < m_active.size(); ++lane)
+        {
+            std::deque<outbound_flow*>& active = m_active[lane];
+            //flows passed over in a row because they are held back.
+            std::size_t held = 0;
+            //turns in a row which ended without a packet sent.
+            std::size_t starved = 0;
+            while(held < active.size())
+            {
+                outbound_flow* f = active.front();
+                outbound_flow::lane_queue& q = f->m_lanes[lane];
+                outbound_packet const& front = q.packets.front();
+                if(front.not_before > now)
+                {
+                    if(front.not_before < next_due)
+                    {
+                        next_due = front.not_before;
+                    }
+                    ++held;
+                    active.pop_front();
+                    active.push_back(f);
+                    continue;
+                }
+                held = 0;
+                if(front.bytes <= q.deficit)
+                {
+                    p = std::move(q.packets.front());
+                    q.packets.pop_front();
+                    q.deficit -= p.bytes;
+                    f->remove(p.bytes);
+                    --m_queued;
+                    if(q.packets.empty())
+                    {
+                        //an idle flow doesn't save up credit.
+                        q.deficit = 0;
+                        q.active = false;
+                        active.pop_front();
+                    }
+                    return true;
+                }
+                //turn is over, earn the next quantum and let the others go.
+                q.deficit += m_quantum * f->m_weight.load(std::memory_order_relaxed);
+                active.pop_front();
+                active.push_back(f);
+                if(++starved >= active.size())
+                {
+                    //every flow had its turn, skip the rounds in which none
+                    //would earn enough instead of taking them one by one.
+                    this->skip_rounds(lane, now);
+                    starved = 0;
+                }
+            }
+        }
+        return false;
+    }
+
+    void outbound_scheduler::recharge(outbound_packet const& p, std::size_t queued_bytes)
+    {
+        outbound_flow::lane_queue& q = p.flow->m_lanes[p.lane];
+        if(!q.active)
+        {
+            //its turn ended with it, there's no credit left to charge.
+            return;
+        }
+        if(p.bytes > queued_bytes)
+        {
+            q.deficit -= std::min(q.deficit, p.bytes - queued_bytes);
+        }
+        else
+        {
+            q.deficit += queued_bytes - p.bytes;
+        }
+    }
+
+    void outbound_scheduler::skip_rounds(std::size_t lane, std::chrono::steady_clock::time_point now)
+    {
+        std::deque<outbound_flow*>& active = m_active[lane];
+        std::size_t rounds = std::numeric_limits<std::size_t>::max();
+        for(auto it = active.begin(); it != active.end() && rounds > 0; ++it)
+        {
+            outbound_flow::lane_queue const& q = (*it)->m_lanes[lane];
+            outbound_packet const& front = q.packets.front();
+            if(front.not_before > now)
+            {
+                continue;
+            }
+            std::size_t credit = m_quantum * (*it)->m_weight.load(std::memory_order_relaxed);
+            std::size_t missing = front.bytes > q.deficit ? front.bytes - q.deficit : 0;
+            rounds = std::min(rounds, (missing + credit - 1) / credit);
+        }
+        if(rounds == 0 || rounds == std::numeric_limits<std::size_t>::max())
+        {
+            return;
+        }
+        for(auto it = active.begin(); it != active.end(); ++it)
+        {
+            outbound_flow::lane_queue& q = (*it)->m_lanes[lane];
+            if(q.packets.front().not_before <= now)
+            {
+                q.deficit += rounds * m_quantum * (*it)->m_weight.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::size_t outbound_scheduler::clear(std::vector<std::shared_ptr<emit_trace> >* traces)
+    {
+        std::size_t bytes = 0;
+        for(std::size_t lane = 0; lane < m_active.size(); ++lane)
+        {
+            std::deque<outbound_flow*>& active = m_active[lane];
+            for(auto it = active.begin(); it != active.end(); ++it)
+            {
+                outbound_flow::lane_queue& q = (*it)->m_lanes[lane];
+                for(auto p = q.packets.begin(); p != q.packets.end(); ++p)
+                {
+                    bytes += p->bytes;
+                    (*it)->remove(p->bytes);
+                    if(p->slot)
+                    {
+                        p->slot->cancel();
+                    }
+                    if(p->trace && traces)
+                    {
+                        traces->push_back(p->trace);
+                    }
+                }
+                q.packets.clear();
+                q.deficit = 0;
+                q.active = false;
+            }
+            active.clear();
+        }
+        m_queued = 0;
+        return bytes;
+    }
+}
@@ -0,0 +1,174 @@
+//
+//  sio_outbound_scheduler.h
+//
+//  Orders the packets waiting for the transport by lane and namespace.
+//
+
+#ifndef SIO_OUTBOUND_SCHEDULER_H
+#define SIO_OUTBOUND_SCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace sio
+{
+    class outbound_flow;
+
+    class conflation_slot;
+
+    struct emit_trace;
+
+    // An encoded packet, its attachments have to follow it on the wire.
+    struct outbound_packet
+    {
+        std::shared_ptr<const std::string> payload;
+        std::vector<std::shared_ptr<const std::string> > attachments;
+        std::size_t bytes;
+        // Socket.IO packet type for the metrics, -1 for other frames.
+        int type;
+        unsigned lane;
+        outbound_flow* flow;
+        // Held back until then by a rate limit, default constructed to go now.
+        std::chrono::steady_clock::time_point not_before;
+        // For a conflated event, payload and attachments are taken from the
+        // slot when the packet is sent.
+        std::shared_ptr<conflation_slot> slot;
+        // Set for a sampled emit.
+        std::shared_ptr<emit_trace> trace;
+    };
+
+    // Latest value of a conflated event. One packet is queued for the slot
+    // at a time, newer values replace the one it will carry, so the event
+    // keeps its place in the queue and only the newest value goes out.
+    class conflation_slot
+    {
+    public:
+        conflation_slot(): m_queued(false) {}
+
+        // Any thread. False if no packet is queued for the slot, the caller
+        // queues one then.
+        bool offer(outbound_packet const& value);
+
+        // Network thread, fills in the newest value as the packet is sent.
+        void take(outbound_packet& p);
+
+        // The queued packet was dropped.
+        void cancel();
+
+    private:
+        std::mutex m_mutex;
+
+        std::shared_ptr<const std::string> m_payload;
+
+        std::vector<std::shared_ptr<const std::string> > m_attachments;
+
+        bool m_queued;
+    };
+
+    // Packets of one namespace. Counts what its socket queued and the
+    // transport didn't take yet, readable from any thread.
+    class outbound_flow
+    {
+    public:
+        std::size_t queued_packets() const { return m_packets.load(std::memory_order_relaxed); }
+
+        std::size_t queued_bytes() const { return m_bytes.load(std::memory_order_relaxed); }
+
+        void add(std::size_t bytes)
+        {
+            m_packets.fetch_add(1, std::memory_order_relaxed);
+            m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+        void remove(std::size_t bytes)
+        {
+            m_packets.fetch_sub(1, std::memory_order_relaxed);
+            m_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+        }
+
+    private:
+        explicit outbound_flow(unsigned lanes);
+
+        struct lane_queue
+        {
+            std::deque<outbound_packet> packets;
+            std::size_t deficit;
+            bool active;
+        };
+
+        std::vector<lane_queue> m_lanes;
+
+        std::atomic<unsigned> m_weight;
+
+        std::atomic<std::size_t> m_packets;
+
+        std::atomic<std::size_t> m_bytes;
+
+        friend class outbound_scheduler;
+    };
+
+    // Lanes are strict priorities, lane 0 first. Within a lane the namespaces
+    // take turns by deficit round robin: each turn a namespace earns quantum
+    // times its weight in bytes and sends packets while they fit, so a chatty
+    // namespace gets its share of bytes and no more while others wait.
+    // A packet held back by a rate limit holds back its flow in its lane,
+    // others go meanwhile. Flows are created on first use and live as long
+    // as the scheduler. push, pop and clear belong to the network thread.
+    class outbound_scheduler
+    {
+    public:
+        // Lane of a packet going after all its flow queued so far, in the
+        // lowest lane holding any and not before the last of them is due.
+        static const unsigned lane_trailing = ~0u;
+
+        explicit outbound_scheduler(unsigned lanes, std::size_t quantum = 4096);
+
+        // Any thread.
+        outbound_flow* get_flow(std::string const& nsp);
+
+        // Any thread, weight 1 by default, 0 is taken as 1.
+        void set_weight(std::string const& nsp, unsigned weight);
+
+        // p.flow and p.lane must be set. The caller counts the packet in its
+        // flow once queued anywhere, pop and clear count it out.
+        void push(outbound_packet& p);
+
+        // False when empty or all packets are held back, then next_due is
+        // lowered to the earliest time one will be ready.
+        bool pop(outbound_packet& p, std::chrono::steady_clock::time_point now, std::chrono::steady_clock::time_point& next_due);
+
+        // A popped packet went out with another size than it was queued
+        // with, a newer conflated value. Charges its flow's turn with the
+        // difference.
+        void recharge(outbound_packet const& p, std::size_t queued_bytes);
+
+        bool empty() const { return m_queued == 0; }
+
+        // Drops all packets, returns their bytes. The traces of traced ones
+        // are added to traces when given.
+        std::size_t clear(std::vector<std::shared_ptr<emit_trace> >* traces = NULL);
+
+    private:
+        // Credits the flows of lane ready to send with the rounds it takes
+        // until the first of them can, as if they had their turns.
+        void skip_rounds(std::size_t lane, std::chrono::steady_clock::time_point now);
+
+        std::mutex m_mutex;
+
+        std::map<std::string, std::unique_ptr<outbound_flow> > m_flows;
+
+        // Per lane, the flows with packets in their turn order.
+        std::vector<std::deque<outbound_flow*> > m_active;
+
+        std::size_t m_quantum;
+
+        std::size_t m_queued;
+    };
+}
+#endif // SIO_OUTBOUND_SCHEDULER_H
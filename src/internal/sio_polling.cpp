@@ -0,0 +1,644 @@
+//
+//  sio_polling.cpp
+//
+//  Engine.IO v4 HTTP long-polling transport.
+//
+
+#include "sio_polling.h"
+#include "sio_packet.h"
+#include "sio_log.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <sstream>
+
+#define kRECORD_SEPARATOR '\x1e'
+
+namespace sio
+{
+    using boost::asio::ip::tcp;
+    using std::string;
+    using std::shared_ptr;
+
+    namespace
+    {
+        const char s_base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        void base64_encode(const char* data, size_t length, string& out)
+        {
+            out.reserve(out.size() + (length + 2) / 3 * 4);
+            size_t i = 0;
+            for (; i + 2 < length; i += 3) {
+                unsigned v = (unsigned char)data[i] << 16 | (unsigned char)data[i+1] << 8 | (unsigned char)data[i+2];
+                out.push_back(s_base64_chars[(v >> 18) & 0x3F]);
+                out.push_back(s_base64_chars[(v >> 12) & 0x3F]);
+                out.push_back(s_base64_chars[(v >> 6) & 0x3F]);
+                out.push_back(s_base64_chars[v & 0x3F]);
+            }
+            if (i < length) {
+                unsigned v = (unsigned char)data[i] << 16;
+                if (i + 1 < length) v |= (unsigned char)data[i+1] << 8;
+                out.push_back(s_base64_chars[(v >> 18) & 0x3F]);
+                out.push_back(s_base64_chars[(v >> 12) & 0x3F]);
+                out.push_back(i + 1 < length ? s_base64_chars[(v >> 6) & 0x3F] : '=');
+                out.push_back('=');
+            }
+        }
+
+        int base64_value(char c)
+        {
+            if (c >= 'A' && c <= 'Z') return c - 'A';
+            if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+            if (c >= '0' && c <= '9') return c - '0' + 52;
+            if (c == '+') return 62;
+            if (c == '/') return 63;
+            return -1;
+        }
+
+        void base64_decode(const char* data, size_t length, string& out)
+        {
+            unsigned v = 0;
+            int bits = 0;
+            for (size_t i = 0; i < length; ++i) {
+                int d = base64_value(data[i]);
+                if (d < 0) {
+                    continue;//padding
+                }
+                v = (v << 6) | (unsigned)d;
+                bits += 6;
+                if (bits >= 8) {
+                    bits -= 8;
+                    out.push_back((char)((v >> bits) & 0xFF));
+                }
+            }
+        }
+
+        size_t encoded_length(string const& packet)
+        {
+            if (packet::is_binary_message(packet)) {
+                return 1 + (packet.size() - 1 + 2) / 3 * 4;
+            }
+            return packet.size();
+        }
+
+        bool iequals(string const& a, const char* b)
+        {
+            size_t i = 0;
+            for (; i < a.size() && b[i]; ++i) {
+                if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) {
+                    return false;
+                }
+            }
+            return i == a.size() && b[i] == 0;
+        }
+
+        boost::system::error_code bad_response()
+        {
+            return boost::system::errc::make_error_code(boost::system::errc::bad_message);
+        }
+
+        // Decimal digits only, false when empty, malformed or out of range.
+        bool parse_length(string const& value, size_t& length)
+        {
+            if (value.empty() || !isdigit((unsigned char)value[0])) {
+                return false;
+            }
+            char* end = NULL;
+            errno = 0;
+            unsigned long long parsed = std::strtoull(value.c_str(), &end, 10);
+            if (*end != '\0' || errno == ERANGE || parsed >= string::npos) {
+                return false;
+            }
+            length = (size_t)parsed;
+            return true;
+        }
+
+        // engine.io's default maxPayload, until the handshake tells.
+        const size_t s_default_max_payload = 1000000;
+
+        // Room for the record separators and the packet types around the payload.
+        const size_t s_max_framing = 64 * 1024;
+    }
+
+    struct polling_transport::channel
+    {
+#if SIO_TLS
+        typedef boost::asio::ssl::stream<tcp::socket> socket_type;
+
+        channel(boost::asio::io_service& io, boost::asio::ssl::context& ctx):
+            socket(io, ctx),
+            connected(false)
+        {
+        }
+#else
+        typedef tcp::socket socket_type;
+
+        channel(boost::asio::io_service& io):
+            socket(io),
+            connected(false)
+        {
+        }
+#endif
+        void close()
+        {
+            boost::system::error_code ec;
+            socket.lowest_layer().close(ec);
+            connected = false;
+        }
+
+        socket_type socket;
+        boost::asio::streambuf response;
+        string request;
+        bool connected;
+        bool keep_alive;
+    };
+
+#if SIO_TLS
+    polling_transport::polling_transport(boost::asio::io_service& io, context_ptr const& ctx):
+        m_io_service(io),
+        m_context(ctx),
+        m_sessions(nullptr),
+#else
+    polling_transport::polling_transport(boost::asio::io_service& io):
+        m_io_service(io),
+#endif
+        m_resolver(io),
+        m_max_payload(0),
+        m_request_count(0),
+        m_opened(false),
+        m_polling(false),
+        m_writing(false),
+        m_paused(false),
+        m_shutdown(false),
+        m_closed(false)
+    {
+    }
+
+    polling_transport::~polling_transport()
+    {
+    }
+
+    void polling_transport::open(string const& host, string const& port, string const& path,
+                                 std::map<string, string> const& headers)
+    {
+        m_host = host;
+        m_port = port;
+        m_path = path;
+        m_headers = headers;
+        m_polling = true;
+        shared_ptr<polling_transport> self = shared_from_this();
+        this->request(m_poll_channel, "GET", string(), [self](boost::system::error_code const& ec, string& body)
+        {
+            self->on_handshake(ec, body);
+        });
+    }
+
+    void polling_transport::start(string const& sid, size_t max_payload)
+    {
+        m_sid = sid;
+        m_max_payload = max_payload;
+        this->poll();
+        this->flush();
+    }
+
+    void polling_transport::send(shared_ptr<const string> const& packet)
+    {
+        m_write_queue.push_back(packet);
+        this->flush();
+    }
+
+    size_t polling_transport::queued_bytes() const
+    {
+        size_t bytes = 0;
+        for(auto it = m_write_queue.begin(); it != m_write_queue.end(); ++it)
+        {
+            bytes += (*it)->size();
+        }
+        return bytes;
+    }
+
+    void polling_transport::pause(pause_handler const& l)
+    {
+        m_paused = true;
+        m_pause_handler = l;
+        this->check_paused();
+    }
+
+    void polling_transport::shutdown()
+    {
+        if (m_closed) {
+            return;
+        }
+        if (m_sid.empty()) {
+            this->finish_shutdown();
+            return;
+        }
+        m_shutdown = true;
+        m_paused = false;
+        m_pause_handler = nullptr;
+        m_write_queue.push_back(std::make_shared<const string>(1, (char)('0' + packet::frame_close)));
+        this->flush();
+    }
+
+    void polling_transport::close()
+    {
+        if (m_closed) {
+            return;
+        }
+        m_closed = true;
+        m_resolver.cancel();
+        if (m_poll_channel) m_poll_channel->close();
+        if (m_send_channel) m_send_channel->close();
+    }
+
+    void polling_transport::encode_payload(std::deque<shared_ptr<const string> >& queue, size_t max_payload, string& payload)
+    {
+        payload.clear();
+        while (!queue.empty()) {
+            string const& packet = *queue.front();
+            size_t length = encoded_length(packet);
+            if (!payload.empty()) {
+                if (max_payload > 0 && payload.size() + 1 + length > max_payload) {
+                    break;
+                }
+                payload.push_back(kRECORD_SEPARATOR);
+            }
+            if (packet::is_binary_message(packet)) {
+                payload.push_back('b');
+                base64_encode(packet.data() + 1, packet.size() - 1, payload);
+            }
+            else {
+                payload.append(packet);
+            }
+            queue.pop_front();
+        }
+    }
+
+    void polling_transport::decode_payload(string const& payload, std::vector<string>& packets)
+    {
+        size_t start = 0;
+        while (start < payload.size()) {
+            size_t end = payload.find(kRECORD_SEPARATOR, start);
+            if (end == string::npos) {
+                end = payload.size();
+            }
+            if (end > start) {
+                if (payload[start] == 'b') {
+                    string packet(1, (char)packet::frame_message);
+                    base64_decode(payload.data() + start + 1, end - start - 1, packet);
+                    packets.push_back(std::move(packet));
+                }
+                else {
+                    packets.push_back(payload.substr(start, end - start));
+                }
+            }
+            start = end + 1;
+        }
+    }
+
+    /*************************private:*************************/
+    void polling_transport::request(std::unique_ptr<channel>& ch, string const& method, string const& body, response_handler const& handler)
+    {
+        if (ch && ch->connected) {
+            ch->request = this->build_request(method, body);
+            this->write_request(*ch, handler);
+            return;
+        }
+#if SIO_TLS
+        ch.reset(new channel(m_io_service, *m_context));
+#else
+        ch.reset(new channel(m_io_service));
+#endif
+        ch->request = this->build_request(method, body);
+        this->connect_channel(*ch, handler);
+    }
+
+    string polling_transport::build_request(string const& method, string const& body)
+    {
+        std::ostringstream ss;
+        ss << method << " " << m_path << "&t=" << std::hex << ++m_request_count << std::dec;
+        if (!m_sid.empty()) {
+            ss << "&sid=" << m_sid;
+        }
+        ss << " HTTP/1.1\r\nHost: ";
+        // As per RFC2732, literal IPv6 address should be enclosed in "[" and "]".
+        if (m_host.find(':') != string::npos) {
+            ss << "[" << m_host << "]";
+        }
+        else {
+            ss << m_host;
+        }
+        ss << ":" << m_port << "\r\nConnection: keep-alive\r\nAccept: */*\r\n";
+        if (!m_cookie.empty()) {
+            ss << "Cookie: " << m_cookie << "\r\n";
+        }
+        for (auto it = m_headers.begin(); it != m_headers.end(); ++it) {
+            ss << it->first << ": " << it->second << "\r\n";
+        }
+        if (method == "POST") {
+            ss << "Content-Type: text/plain;charset=UTF-8\r\nContent-Length: " << body.size() << "\r\n";
+        }
+        ss << "\r\n" << body;
+        return ss.str();
+    }
+
+    void polling_transport::connect_channel(channel& ch, response_handler const& handler)
+    {
+        shared_ptr<polling_transport> self = shared_from_this();
+        channel* ch_ptr = &ch;
+        auto on_connect = [self, ch_ptr, handler](boost::system::error_code const& ec, std::vector<tcp::endpoint>::iterator)
+        {
+            if (self->m_closed) return;
+            if (ec) {
+                handler(ec, ch_ptr->request);
+                return;
+            }
+            boost::system::error_code opt_ec;
+            ch_ptr->socket.lowest_layer().set_option(tcp::no_delay(true), opt_ec);
+#if SIO_TLS
+            boost::system::error_code address_ec;
+            boost::asio::ip::address::from_string(self->m_host, address_ec);
+            if (address_ec) {
+                //RFC 6066 leaves IP literals out of SNI.
+                SSL_set_tlsext_host_name(ch_ptr->socket.native_handle(), self->m_host.c_str());
+            }
+            if (self->m_sessions) self->m_sessions->prepare(ch_ptr->socket.native_handle());
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            ch_ptr->socket.async_handshake(boost::asio::ssl::stream_base::client, [self, ch_ptr, handler, start](boost::system::error_code const& ec)
+            {
+                if (self->m_closed) return;
+                if (ec) {
+                    handler(ec, ch_ptr->request);
+                    return;
+                }
+                if (self->m_sessions) {
+                    self->m_sessions->handshake_done(ch_ptr->socket.native_handle(), std::chrono::steady_clock::now() - start);
+                }
+                ch_ptr->connected = true;
+                self->write_request(*ch_ptr, handler);
+            });
+#else
+            ch_ptr->connected = true;
+            self->write_request(*ch_ptr, handler);
+#endif
+        };
+        if (m_socket) {
+#if SIO_TLS
+            ch.socket.next_layer() = std::move(*m_socket);
+#else
+            ch.socket = std::move(*m_socket);
+#endif
+            m_socket.reset();
+            on_connect(boost::system::error_code(), m_endpoints.end());
+            return;
+        }
+        if (!m_endpoints.empty()) {
+            boost::asio::async_connect(ch.socket.lowest_layer(), m_endpoints.begin(), m_endpoints.end(), on_connect);
+            return;
+        }
+        tcp::resolver::query query(m_host, m_port);
+        m_resolver.async_resolve(query, [self, ch_ptr, handler, on_connect](boost::system::error_code const& ec, tcp::resolver::iterator it)
+        {
+            if (self->m_closed) return;
+            if (ec) {
+                handler(ec, ch_ptr->request);
+                return;
+            }
+            self->m_endpoints.assign(it, tcp::resolver::iterator());
+            boost::asio::async_connect(ch_ptr->socket.lowest_layer(), self->m_endpoints.begin(), self->m_endpoints.end(), on_connect);
+        });
+    }
+
+    void polling_transport::write_request(channel& ch, response_handler const& handler)
+    {
+        shared_ptr<polling_transport> self = shared_from_this();
+        channel* ch_ptr = &ch;
+        boost::asio::async_write(ch.socket, boost::asio::buffer(ch.request), [self, ch_ptr, handler](boost::system::error_code const& ec, size_t)
+        {
+            if (self->m_closed) return;
+            if (ec) {
+                ch_ptr->close();
+                handler(ec, ch_ptr->request);
+                return;
+            }
+            self->read_headers(*ch_ptr, handler);
+        });
+    }
+
+    void polling_transport::read_headers(channel& ch, response_handler const& handler)
+    {
+        shared_ptr<polling_transport> self = shared_from_this();
+        channel* ch_ptr = &ch;
+        boost::asio::async_read_until(ch.socket, ch.response, "\r\n\r\n", [self, ch_ptr, handler](boost::system::error_code const& ec, size_t length)
+        {
+            if (self->m_closed) return;
+            if (ec) {
+                ch_ptr->close();
+                handler(ec, ch_ptr->request);
+                return;
+            }
+            string headers(boost::asio::buffers_begin(ch_ptr->response.data()),
+                           boost::asio::buffers_begin(ch_ptr->response.data()) + length);
+            ch_ptr->response.consume(length);
+
+            std::istringstream ss(headers);
+            string line, version;
+            unsigned status = 0;
+            ss >> version >> status;
+            std::getline(ss, line);
+            size_t content_length = string::npos;
+            ch_ptr->keep_alive = version != "HTTP/1.0";
+            while (std::getline(ss, line) && line != "\r") {
+                size_t colon = line.find(':');
+                if (colon == string::npos) {
+                    continue;
+                }
+                string name = line.substr(0, colon);
+                size_t value_start = line.find_first_not_of(" \t", colon + 1);
+                size_t value_end = line.find_last_not_of("\r \t");
+                string value = value_start == string::npos || value_end < value_start ? string() : line.substr(value_start, value_end - value_start + 1);
+                if (iequals(name, "Content-Length")) {
+                    if (!parse_length(value, content_length)) {
+                        SIO_LOG_DEBUG("Invalid content length:" << value << std::endl);
+                        ch_ptr->close();
+                        handler(bad_response(), ch_ptr->request);
+                        return;
+                    }
+                }
+                else if (iequals(name, "Connection")) {
+                    ch_ptr->keep_alive = !iequals(value, "close");
+                }
+                else if (iequals(name, "Set-Cookie")) {
+                    //keep sticky session cookies for the load balancers.
+                    self->m_cookie = value.substr(0, value.find(';'));
+                }
+                else if (iequals(name, "Transfer-Encoding") && !iequals(value, "identity")) {
+                    SIO_LOG_DEBUG("Unsupported transfer encoding:" << value << std::endl);
+                    ch_ptr->close();
+                    handler(bad_response(), ch_ptr->request);
+                    return;
+                }
+            }
+            if (status != 200) {
+                SIO_LOG_DEBUG("Polling request failed with status:" << status << std::endl);
+                ch_ptr->close();
+                handler(bad_response(), ch_ptr->request);
+                return;
+            }
+            size_t max_length = (self->m_max_payload ? self->m_max_payload : s_default_max_payload) + s_max_framing;
+            if (content_length != string::npos && content_length > max_length) {
+                SIO_LOG_DEBUG("Response too large:" << content_length << std::endl);
+                ch_ptr->close();
+                handler(bad_response(), ch_ptr->request);
+                return;
+            }
+            if (content_length == string::npos) {
+                //body ends with the connection.
+                ch_ptr->keep_alive = false;
+            }
+            self->read_body(*ch_ptr, content_length, handler);
+        });
+    }
+
+    void polling_transport::read_body(channel& ch, size_t length, response_handler const& handler)
+    {
+        shared_ptr<polling_transport> self = shared_from_this();
+        channel* ch_ptr = &ch;
+        auto on_read = [self, ch_ptr, length, handler](boost::system::error_code const& ec, size_t)
+        {
+            if (self->m_closed) return;
+            if (ec && !(ec == boost::asio::error::eof && length == string::npos)) {
+                ch_ptr->close();
+                handler(ec, ch_ptr->request);
+                return;
+            }
+            size_t size = std::min(length, ch_ptr->response.size());
+            string body(boost::asio::buffers_begin(ch_ptr->response.data()),
+                        boost::asio::buffers_begin(ch_ptr->response.data()) + size);
+            ch_ptr->response.consume(size);
+            if (!ch_ptr->keep_alive) {
+                ch_ptr->close();
+            }
+            handler(boost::system::error_code(), body);
+        };
+        if (length == string::npos) {
+            boost::asio::async_read(ch.socket, ch.response, boost::asio::transfer_all(), on_read);
+        }
+        else if (ch.response.size() >= length) {
+            on_read(boost::system::error_code(), 0);
+        }
+        else {
+            boost::asio::async_read(ch.socket, ch.response, boost::asio::transfer_exactly(length - ch.response.size()), on_read);
+        }
+    }
+
+    void polling_transport::on_handshake(boost::system::error_code const& ec, string& body)
+    {
+        m_polling = false;
+        if (ec) {
+            this->on_error(ec);
+            return;
+        }
+        m_opened = true;
+        if (m_open_handler) m_open_handler();
+        this->dispatch_payload(body);
+    }
+
+    void polling_transport::poll()
+    {
+        if (m_polling || m_paused || m_closed || m_sid.empty()) {
+            return;
+        }
+        m_polling = true;
+        shared_ptr<polling_transport> self = shared_from_this();
+        this->request(m_poll_channel, "GET", string(), [self](boost::system::error_code const& ec, string& body)
+        {
+            self->on_poll(ec, body);
+        });
+    }
+
+    void polling_transport::on_poll(boost::system::error_code const& ec, string& body)
+    {
+        m_polling = false;
+        if (ec) {
+            this->on_error(ec);
+            return;
+        }
+        this->dispatch_payload(body);
+        if (m_paused) {
+            this->check_paused();
+        }
+        else {
+            this->poll();
+        }
+    }
+
+    void polling_transport::flush()
+    {
+        if (m_writing || m_paused || m_closed || m_sid.empty() || m_write_queue.empty()) {
+            return;
+        }
+        m_writing = true;
+        string payload;
+        encode_payload(m_write_queue, m_max_payload, payload);
+        shared_ptr<polling_transport> self = shared_from_this();
+        this->request(m_send_channel, "POST", payload, [self](boost::system::error_code const& ec, string& body)
+        {
+            self->on_flush(ec, body);
+        });
+    }
+
+    void polling_transport::on_flush(boost::system::error_code const& ec, string&)
+    {
+        m_writing = false;
+        if (ec) {
+            this->on_error(ec);
+            return;
+        }
+        if (m_shutdown && m_write_queue.empty()) {
+            this->finish_shutdown();
+        }
+        else if (m_paused) {
+            this->check_paused();
+        }
+        else {
+            this->flush();
+        }
+    }
+
+    void polling_transport::check_paused()
+    {
+        if (m_pause_handler && !m_polling && !m_writing && !m_closed) {
+            pause_handler l;
+            l.swap(m_pause_handler);
+            l(m_write_queue);
+        }
+    }
+
+    void polling_transport::dispatch_payload(string const& body)
+    {
+        std::vector<string> packets;
+        decode_payload(body, packets);
+        for (auto it = packets.begin(); it != packets.end() && !m_closed; ++it) {
+            if (m_packet_handler) m_packet_handler(*it);
+        }
+    }
+
+    void polling_transport::on_error(boost::system::error_code const& ec)
+    {
+        if (m_closed) {
+            return;
+        }
+        SIO_LOG_DEBUG("Polling transport error:" << ec.message() << std::endl);
+        this->close();
+        close_handler l = m_opened ? m_close_handler : m_fail_handler;
+        if (l) l(ec);
+    }
+
+    void polling_transport::finish_shutdown()
+    {
+        this->close();
+        if (m_close_handler) m_close_handler(boost::system::error_code());
+    }
+}
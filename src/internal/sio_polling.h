@@ -0,0 +1,184 @@
+//
+//  sio_polling.h
+//
+//  Engine.IO v4 HTTP long-polling transport.
+//
+
+#ifndef SIO_POLLING_H
+#define SIO_POLLING_H
+
+#include <boost/asio.hpp>
+#include <chrono>
+#if SIO_TLS
+#include <boost/asio/ssl.hpp>
+#endif
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "sio_tls.h"
+
+namespace sio
+{
+    // Carries engine.io packets over HTTP requests. Outgoing packets are batched
+    // into one POST per round trip (separated by the EIO4 record separator),
+    // incoming ones arrive in the responses of a pending GET.
+    //
+    // Packets use the same representation as on the websocket: text packets start
+    // with their type digit, binary packets with the packet::frame_message byte.
+    // All members must be called on the thread running the io_service.
+    class polling_transport : public std::enable_shared_from_this<polling_transport>
+    {
+    public:
+        typedef std::function<void(void)> open_handler;
+
+        typedef std::function<void(std::string const& packet)> packet_handler;
+
+        typedef std::function<void(boost::system::error_code const& ec)> close_handler;
+
+        typedef std::function<void(std::deque<std::shared_ptr<const std::string> >& unsent)> pause_handler;
+
+#if SIO_TLS
+        typedef std::shared_ptr<boost::asio::ssl::context> context_ptr;
+
+        polling_transport(boost::asio::io_service& io, context_ptr const& ctx);
+#else
+        polling_transport(boost::asio::io_service& io);
+#endif
+
+        ~polling_transport();
+
+        void set_open_handler(open_handler const& l) { m_open_handler = l; }
+
+        void set_packet_handler(packet_handler const& l) { m_packet_handler = l; }
+
+        // Called once if the handshake request fails.
+        void set_fail_handler(close_handler const& l) { m_fail_handler = l; }
+
+        // Called once if the transport breaks after it was opened.
+        void set_close_handler(close_handler const& l) { m_close_handler = l; }
+
+#if SIO_TLS
+        // Resumes TLS sessions from, and reports handshakes to, the cache.
+        void set_session_cache(tls_session_cache* cache) { m_sessions = cache; }
+
+#endif
+        // Connects to this address instead of resolving the host passed to open.
+        void set_endpoint(boost::asio::ip::tcp::endpoint const& ep) { m_endpoints.assign(1, ep); }
+
+        // Sends the handshake request over this connection, already open to
+        // the endpoint, instead of connecting again.
+        void set_socket(std::unique_ptr<boost::asio::ip::tcp::socket> socket) { m_socket = std::move(socket); }
+
+        // Sends the handshake request, path is "/socket.io/?EIO=4&transport=polling..."
+        void open(std::string const& host, std::string const& port, std::string const& path,
+                  std::map<std::string, std::string> const& headers);
+
+        // Starts the poll cycle once the handshake packet has been processed.
+        void start(std::string const& sid, size_t max_payload);
+
+        void send(std::shared_ptr<const std::string> const& packet);
+
+        // Stops polling for an upgrade. The handler runs once no request is in
+        // flight anymore and receives the packets which were not written yet.
+        void pause(pause_handler const& l);
+
+        // Writes the close packet, then closes and invokes the close handler.
+        void shutdown();
+
+        // Aborts all requests, no handler is invoked afterwards.
+        void close();
+
+        bool opened() const { return m_opened; }
+
+        // Bytes waiting for the next post request.
+        size_t queued_bytes() const;
+
+        // Moves packets from the queue into a payload until max_payload would be
+        // exceeded. At least one packet is always taken.
+        static void encode_payload(std::deque<std::shared_ptr<const std::string> >& queue, size_t max_payload, std::string& payload);
+
+        static void decode_payload(std::string const& payload, std::vector<std::string>& packets);
+
+    private:
+        struct channel;
+
+        typedef std::function<void(boost::system::error_code const&, std::string&)> response_handler;
+
+        void request(std::unique_ptr<channel>& ch, std::string const& method, std::string const& body, response_handler const& handler);
+
+        void connect_channel(channel& ch, response_handler const& handler);
+
+        void write_request(channel& ch, response_handler const& handler);
+
+        void read_headers(channel& ch, response_handler const& handler);
+
+        void read_body(channel& ch, size_t length, response_handler const& handler);
+
+        std::string build_request(std::string const& method, std::string const& body);
+
+        void on_handshake(boost::system::error_code const& ec, std::string& body);
+
+        void poll();
+
+        void on_poll(boost::system::error_code const& ec, std::string& body);
+
+        void flush();
+
+        void on_flush(boost::system::error_code const& ec, std::string& body);
+
+        void check_paused();
+
+        void dispatch_payload(std::string const& body);
+
+        void on_error(boost::system::error_code const& ec);
+
+        void finish_shutdown();
+
+        boost::asio::io_service& m_io_service;
+#if SIO_TLS
+        context_ptr m_context;
+
+        tls_session_cache* m_sessions;
+#endif
+        boost::asio::ip::tcp::resolver m_resolver;
+
+        std::vector<boost::asio::ip::tcp::endpoint> m_endpoints;
+
+        // Taken by the first channel.
+        std::unique_ptr<boost::asio::ip::tcp::socket> m_socket;
+
+        std::unique_ptr<channel> m_poll_channel;
+
+        std::unique_ptr<channel> m_send_channel;
+
+        std::string m_host;
+        std::string m_port;
+        std::string m_path;
+        std::string m_sid;
+        std::string m_cookie;
+        std::map<std::string, std::string> m_headers;
+
+        size_t m_max_payload;
+
+        unsigned m_request_count;
+
+        std::deque<std::shared_ptr<const std::string> > m_write_queue;
+
+        open_handler m_open_handler;
+        packet_handler m_packet_handler;
+        close_handler m_fail_handler;
+        close_handler m_close_handler;
+        pause_handler m_pause_handler;
+
+        bool m_opened;
+        bool m_polling;
+        bool m_writing;
+        bool m_paused;
+        bool m_shutdown;
+        bool m_closed;
+    };
+}
+#endif // SIO_POLLING_H
@@ -0,0 +1,112 @@
+//
+//  sio_rate_limiter.cpp
+//
+//  Token buckets limiting the events a socket emits.
+//
+
+#include "sio_rate_limiter.h"
+#include <algorithm>
+
+namespace sio
+{
+    void rate_limiter::bucket::refill(clock::time_point now)
+    {
+        if(now > last)
+        {
+            double elapsed = std::chrono::duration<double>(now - last).count();
+            tokens = std::min(burst, tokens + elapsed * rate);
+            last = now;
+        }
+    }
+
+    rate_limiter::rate_limiter():
+        m_enabled(false)
+    {
+        configure(m_socket, 0, 0, socket::rate_limit_delay);
+    }
+
+    void rate_limiter::configure(bucket& b, double rate, unsigned burst, socket::rate_limit_action action)
+    {
+        b.rate = rate;
+        b.burst = std::max(1u, burst);
+        b.tokens = b.burst;
+        b.last = clock::now();
+        b.action = action;
+    }
+
+    void rate_limiter::set(double rate, unsigned burst, socket::rate_limit_action action)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        configure(m_socket, rate > 0 ? rate : 0, burst, action);
+        m_enabled.store(m_socket.rate > 0 || !m_names.empty(), std::memory_order_release);
+    }
+
+    void rate_limiter::set(std::string const& name, double rate, unsigned burst, socket::rate_limit_action action)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if(rate > 0)
+        {
+            configure(m_names[name], rate, burst, action);
+        }
+        else
+        {
+            m_names.erase(name);
+        }
+        m_enabled.store(m_socket.rate > 0 || !m_names.empty(), std::memory_order_release);
+    }
+
+    rate_limiter::result rate_limiter::acquire(std::string const& name, clock::time_point now, bool may_delay, clock::time_point& due)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        bucket* buckets[2];
+        std::size_t count = 0;
+        if(m_socket.rate > 0)
+        {
+            buckets[count++] = &m_socket;
+        }
+        if(!m_names.empty())
+        {
+            auto it = m_names.find(name);
+            if(it != m_names.end())
+            {
+                buckets[count++] = &it->second;
+            }
+        }
+        //check all before taking from any, a refused event costs nothing.
+        result refused = accepted;
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            bucket& b = *buckets[i];
+            b.refill(now);
+            if(b.tokens >= 1)
+            {
+                continue;
+            }
+            if(b.action == socket::rate_limit_reject)
+            {
+                refused = rejected;
+            }
+            else if(refused == accepted && (b.action == socket::rate_limit_drop || !may_delay))
+            {
+                refused = dropped;
+            }
+        }
+        if(refused != accepted)
+        {
+            return refused;
+        }
+        due = now;
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            bucket& b = *buckets[i];
+            b.tokens -= 1;
+            if(b.tokens < 0)
+            {
+                //borrowed, due once the bucket is back at zero.
+                clock::time_point ready = now + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(-b.tokens / b.rate));
+                due = std::max(due, ready);
+            }
+        }
+        return accepted;
+    }
+}
@@ -0,0 +1,71 @@
+//
+//  sio_rate_limiter.h
+//
+//  Token buckets limiting the events a socket emits.
+//
+
+#ifndef SIO_RATE_LIMITER_H
+#define SIO_RATE_LIMITER_H
+
+#include "../sio_socket.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace sio
+{
+    // One bucket for the whole socket and one per limited event name, an
+    // event takes a token from each that applies. A delaying bucket lends
+    // tokens it doesn't have yet and tells when they are due, so callers
+    // schedule the event instead of waiting for it.
+    class rate_limiter
+    {
+    public:
+        typedef std::chrono::steady_clock clock;
+
+        enum result
+        {
+            accepted,
+            dropped,
+            rejected
+        };
+
+        rate_limiter();
+
+        // A rate of 0 removes the limit.
+        void set(double rate, unsigned burst, socket::rate_limit_action action);
+
+        void set(std::string const& name, double rate, unsigned burst, socket::rate_limit_action action);
+
+        bool enabled() const { return m_enabled.load(std::memory_order_acquire); }
+
+        // When accepted, due is when the event may go, now or later. With
+        // may_delay false a bucket short of tokens drops the event instead.
+        result acquire(std::string const& name, clock::time_point now, bool may_delay, clock::time_point& due);
+
+    private:
+        struct bucket
+        {
+            double rate;
+            double burst;
+            double tokens;
+            clock::time_point last;
+            socket::rate_limit_action action;
+
+            void refill(clock::time_point now);
+        };
+
+        static void configure(bucket& b, double rate, unsigned burst, socket::rate_limit_action action);
+
+        std::mutex m_mutex;
+
+        bucket m_socket;
+
+        std::unordered_map<std::string, bucket> m_names;
+
+        std::atomic<bool> m_enabled;
+    };
+}
+#endif // SIO_RATE_LIMITER_H
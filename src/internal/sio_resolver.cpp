@@ -0,0 +1,229 @@
+//
+//  sio_resolver.cpp
+//
+//  Cached name resolution and RFC 8305 style racing of the resolved addresses.
+//
+
+#include "sio_resolver.h"
+#include <boost/asio/ip/tcp.hpp>
+
+namespace sio
+{
+    using boost::asio::ip::tcp;
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+
+    endpoint_cache::endpoint_cache(boost::asio::io_service& io):
+        m_io(io),
+        m_ttl(60)
+    {
+    }
+
+    void endpoint_cache::resolve(std::string const& host, std::string const& port, resolve_handler const& handler)
+    {
+        std::string key = host + ":" + port;
+        auto it = m_entries.find(key);
+        if(it != m_entries.end())
+        {
+            if(clock_type::now() < it->second.expires)
+            {
+                endpoint_list endpoints = it->second.endpoints;
+                m_io.post([handler, endpoints]()
+                {
+                    handler(boost::system::error_code(), endpoints);
+                });
+                return;
+            }
+            m_entries.erase(it);
+        }
+        resolve_handler done = std::bind(&endpoint_cache::on_resolved, this, key, handler, _1, _2);
+        if(m_hook)
+        {
+            boost::asio::io_service& io = m_io;
+            resolve_hook hook = m_hook;
+            m_io.post([&io, hook, host, port, done]()
+            {
+                hook(host, port, [&io, done](boost::system::error_code const& ec, endpoint_list const& endpoints)
+                {
+                    io.post(std::bind(done, ec, endpoints));
+                });
+            });
+            return;
+        }
+        std::shared_ptr<tcp::resolver> resolver = std::make_shared<tcp::resolver>(m_io);
+        tcp::resolver::query query(host, port);
+        resolver->async_resolve(query, [resolver, done](boost::system::error_code const& ec, tcp::resolver::iterator it)
+        {
+            endpoint_list endpoints;
+            for(; !ec && it != tcp::resolver::iterator(); ++it)
+            {
+                endpoints.push_back(it->endpoint());
+            }
+            done(ec, endpoints);
+        });
+    }
+
+    void endpoint_cache::evict(std::string const& host, std::string const& port)
+    {
+        m_entries.erase(host + ":" + port);
+    }
+
+    void endpoint_cache::on_resolved(std::string const& key, resolve_handler const& handler,
+                                     boost::system::error_code const& ec, endpoint_list const& endpoints)
+    {
+        if(!ec && !endpoints.empty() && m_ttl > 0)
+        {
+            entry& e = m_entries[key];
+            e.endpoints = endpoints;
+            e.expires = clock_type::now() + std::chrono::seconds(m_ttl);
+        }
+        if(!ec && endpoints.empty())
+        {
+            handler(boost::asio::error::host_not_found, endpoints);
+            return;
+        }
+        handler(ec, endpoints);
+    }
+
+    endpoint_racer::endpoint_racer(boost::asio::io_service& io, endpoint_list const& endpoints):
+        m_io(io),
+        m_endpoints(interleave(endpoints)),
+        m_delay_timer(io),
+        m_attempt_delay(250),
+        m_pending(0),
+        m_delay_id(0),
+        m_done(false)
+    {
+    }
+
+    endpoint_list endpoint_racer::interleave(endpoint_list const& endpoints)
+    {
+        if(endpoints.empty())
+        {
+            return endpoints;
+        }
+        bool first_v6 = endpoints.front().address().is_v6();
+        endpoint_list preferred, other, result;
+        for(auto it = endpoints.begin(); it != endpoints.end(); ++it)
+        {
+            (it->address().is_v6() == first_v6 ? preferred : other).push_back(*it);
+        }
+        for(std::size_t i = 0; i < preferred.size() || i < other.size(); ++i)
+        {
+            if(i < preferred.size()) result.push_back(preferred[i]);
+            if(i < other.size()) result.push_back(other[i]);
+        }
+        return result;
+    }
+
+    void endpoint_racer::start(race_handler const& handler)
+    {
+        m_handler = handler;
+        if(m_endpoints.empty())
+        {
+            std::shared_ptr<endpoint_racer> self = shared_from_this();
+            m_io.post([self]()
+            {
+                self->finish(boost::asio::error::host_not_found, tcp::endpoint());
+            });
+            return;
+        }
+        if(m_endpoints.size() == 1)
+        {
+            //nothing to race, the caller's own connect tells if it's reachable.
+            std::shared_ptr<endpoint_racer> self = shared_from_this();
+            m_io.post([self]()
+            {
+                self->finish(boost::system::error_code(), self->m_endpoints.front());
+            });
+            return;
+        }
+        this->next_attempt();
+    }
+
+    void endpoint_racer::cancel()
+    {
+        m_handler = nullptr;
+        this->finish(boost::asio::error::operation_aborted, tcp::endpoint());
+    }
+
+    void endpoint_racer::next_attempt()
+    {
+        //every address is being tried already.
+        if(m_sockets.size() >= m_endpoints.size())
+        {
+            return;
+        }
+        std::size_t index = m_sockets.size();
+        m_sockets.push_back(std::unique_ptr<tcp::socket>(new tcp::socket(m_io)));
+        m_pending++;
+        m_sockets.back()->async_connect(m_endpoints[index], std::bind(&endpoint_racer::on_attempt, shared_from_this(), index, _1));
+        if(m_sockets.size() < m_endpoints.size())
+        {
+            m_delay_timer.expires_from_now(boost::posix_time::milliseconds(m_attempt_delay));
+            m_delay_timer.async_wait(std::bind(&endpoint_racer::on_delay, shared_from_this(), ++m_delay_id, _1));
+        }
+    }
+
+    void endpoint_racer::on_attempt(std::size_t index, boost::system::error_code const& ec)
+    {
+        if(m_done)
+        {
+            return;
+        }
+        m_pending--;
+        if(!ec)
+        {
+            m_winner = std::move(m_sockets[index]);
+            this->finish(ec, m_endpoints[index]);
+            return;
+        }
+        m_last_error = ec;
+        if(m_sockets.size() < m_endpoints.size())
+        {
+            //don't wait out the delay once an attempt failed. A delay that
+            //expired already still runs its handler, which is then stale.
+            boost::system::error_code cancel_ec;
+            m_delay_timer.cancel(cancel_ec);
+            ++m_delay_id;
+            this->next_attempt();
+        }
+        else if(m_pending == 0)
+        {
+            this->finish(m_last_error, tcp::endpoint());
+        }
+    }
+
+    void endpoint_racer::on_delay(unsigned delay_id, boost::system::error_code const& ec)
+    {
+        if(ec || m_done || delay_id != m_delay_id)
+        {
+            return;
+        }
+        this->next_attempt();
+    }
+
+    void endpoint_racer::finish(boost::system::error_code const& ec, tcp::endpoint const& ep)
+    {
+        if(m_done)
+        {
+            return;
+        }
+        m_done = true;
+        boost::system::error_code ignored;
+        m_delay_timer.cancel(ignored);
+        for(auto it = m_sockets.begin(); it != m_sockets.end(); ++it)
+        {
+            if(*it)
+            {
+                (*it)->close(ignored);
+            }
+        }
+        race_handler handler;
+        handler.swap(m_handler);
+        if(handler)
+        {
+            handler(ec, ep);
+        }
+    }
+}
@@ -0,0 +1,131 @@
+//
+//  sio_resolver.h
+//
+//  Cached name resolution and RFC 8305 style racing of the resolved addresses.
+//
+
+#ifndef SIO_RESOLVER_H
+#define SIO_RESOLVER_H
+
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sio
+{
+    typedef std::vector<boost::asio::ip::tcp::endpoint> endpoint_list;
+
+    // Keeps resolved endpoints per host and port for a TTL so reconnects
+    // don't wait for DNS. Used from the network thread only.
+    class endpoint_cache
+    {
+    public:
+        typedef std::function<void(boost::system::error_code const&, endpoint_list const&)> resolve_handler;
+
+        // Replaces the system resolver, the hook must invoke the handler once.
+        typedef std::function<void(std::string const& host, std::string const& port, resolve_handler const&)> resolve_hook;
+
+        explicit endpoint_cache(boost::asio::io_service& io);
+
+        // 0 disables caching.
+        void set_ttl(unsigned seconds) { m_ttl = seconds; }
+
+        unsigned get_ttl() const { return m_ttl; }
+
+        void set_resolve_hook(resolve_hook const& hook) { m_hook = hook; }
+
+        // The handler always runs from the io_service, never inline.
+        void resolve(std::string const& host, std::string const& port, resolve_handler const& handler);
+
+        // Drops the entry, e.g. after none of its endpoints were reachable.
+        void evict(std::string const& host, std::string const& port);
+
+    private:
+        typedef std::chrono::steady_clock clock_type;
+
+        struct entry
+        {
+            endpoint_list endpoints;
+            clock_type::time_point expires;
+        };
+
+        void on_resolved(std::string const& key, resolve_handler const& handler,
+                         boost::system::error_code const& ec, endpoint_list const& endpoints);
+
+        boost::asio::io_service& m_io;
+
+        unsigned m_ttl;
+
+        resolve_hook m_hook;
+
+        std::map<std::string, entry> m_entries;
+    };
+
+    // Starts a TCP connect to each endpoint in turn, the next one after the
+    // attempt delay or as soon as the previous failed, and reports the first
+    // that succeeds. The other connections are closed, the winning one can be
+    // taken over; otherwise the race was only a probe and the caller
+    // connects to the winning address again.
+    class endpoint_racer : public std::enable_shared_from_this<endpoint_racer>
+    {
+    public:
+        typedef std::function<void(boost::system::error_code const&, boost::asio::ip::tcp::endpoint const&)> race_handler;
+
+        endpoint_racer(boost::asio::io_service& io, endpoint_list const& endpoints);
+
+        // Connection Attempt Delay of RFC 8305, 250ms by default.
+        void set_attempt_delay(unsigned millis) { m_attempt_delay = millis; }
+
+        void start(race_handler const& handler);
+
+        // Stops all attempts without invoking the handler.
+        void cancel();
+
+        // The open connection to the winning address, from the handler on.
+        // Null when there was nothing to race, with a single address.
+        std::unique_ptr<boost::asio::ip::tcp::socket> take_socket() { return std::move(m_winner); }
+
+        // Alternates address families, starting with the family of the first endpoint.
+        static endpoint_list interleave(endpoint_list const& endpoints);
+
+    private:
+        void next_attempt();
+
+        void on_attempt(std::size_t index, boost::system::error_code const& ec);
+
+        void on_delay(unsigned delay_id, boost::system::error_code const& ec);
+
+        void finish(boost::system::error_code const& ec, boost::asio::ip::tcp::endpoint const& ep);
+
+        boost::asio::io_service& m_io;
+
+        endpoint_list m_endpoints;
+
+        std::vector<std::unique_ptr<boost::asio::ip::tcp::socket> > m_sockets;
+
+        std::unique_ptr<boost::asio::ip::tcp::socket> m_winner;
+
+        boost::asio::deadline_timer m_delay_timer;
+
+        unsigned m_attempt_delay;
+
+        std::size_t m_pending;
+
+        // Wait of the delay timer whose expiry starts the next attempt.
+        unsigned m_delay_id;
+
+        bool m_done;
+
+        boost::system::error_code m_last_error;
+
+        race_handler m_handler;
+    };
+}
+#endif // SIO_RESOLVER_H
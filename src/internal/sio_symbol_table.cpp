@@ -0,0 +1,146 @@
+//
+//  sio_symbol_table.cpp
+//
+//  Per client table of interned event names.
+//
+
+#include "sio_symbol_table.h"
+#include <cstring>
+
+namespace sio
+{
+    symbol_table::symbol_table(std::size_t max_auto):
+        m_slots(nullptr),
+        m_max_auto(max_auto),
+        m_auto(0)
+    {
+        std::unique_ptr<slots> initial(new slots());
+        initial->mask = 63;
+        initial->cells.reset(new std::atomic<const symbol*>[64]);
+        for(std::size_t i = 0; i < 64; ++i)
+        {
+            initial->cells[i].store(nullptr, std::memory_order_relaxed);
+        }
+        m_slots.store(initial.get());
+        m_all_slots.push_back(std::move(initial));
+    }
+
+    std::uint64_t symbol_table::hash(const char* str, std::size_t length)
+    {
+        //same as event_name::hash, without the recursion.
+        std::uint64_t h = 14695981039346656037ULL;
+        for(std::size_t i = 0; i < length; ++i)
+        {
+            h = (h ^ (unsigned char)str[i]) * 1099511628211ULL;
+        }
+        return h;
+    }
+
+    const symbol* symbol_table::intern(std::string const& name)
+    {
+        return this->intern(hash(name.data(), name.size()), name.data(), name.size(), false);
+    }
+
+    const symbol* symbol_table::intern(event_name const& name)
+    {
+        return this->intern(name.hash(), name.data(), name.size(), false);
+    }
+
+    const symbol* symbol_table::find(std::string const& name) const
+    {
+        return this->find(hash(name.data(), name.size()), name.data(), name.size());
+    }
+
+    const symbol* symbol_table::find(std::uint64_t h, const char* str, std::size_t length) const
+    {
+        const slots* table = m_slots.load(std::memory_order_acquire);
+        for(std::size_t i = (std::size_t)h;; ++i)
+        {
+            const symbol* s = table->cells[i & table->mask].load(std::memory_order_acquire);
+            if(!s)
+            {
+                return nullptr;
+            }
+            if(s->hash == h && s->name.size() == length && std::memcmp(s->name.data(), str, length) == 0)
+            {
+                return s;
+            }
+        }
+    }
+
+    const symbol* symbol_table::lookup_or_intern(std::string const& name)
+    {
+        std::uint64_t h = hash(name.data(), name.size());
+        const symbol* s = this->find(h, name.data(), name.size());
+        if(s || m_auto.load(std::memory_order_relaxed) >= m_max_auto)
+        {
+            return s;
+        }
+        return this->intern(h, name.data(), name.size(), true);
+    }
+
+    std::size_t symbol_table::size() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_symbols.size();
+    }
+
+    const symbol* symbol_table::intern(std::uint64_t h, const char* str, std::size_t length, bool automatic)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        const symbol* found = this->find(h, str, length);
+        if(found)
+        {
+            return found;
+        }
+        if(automatic)
+        {
+            if(m_auto.load(std::memory_order_relaxed) >= m_max_auto)
+            {
+                return nullptr;
+            }
+            ++m_auto;
+        }
+        //keep the load at most a half.
+        if((m_symbols.size() + 1) * 2 > m_slots.load()->mask + 1)
+        {
+            this->grow();
+        }
+        m_symbols.push_back(symbol());
+        symbol& s = m_symbols.back();
+        s.name.assign(str, length);
+        s.hash = h;
+        slots* table = m_slots.load();
+        std::size_t i = (std::size_t)h;
+        while(table->cells[i & table->mask].load(std::memory_order_relaxed))
+        {
+            ++i;
+        }
+        table->cells[i & table->mask].store(&s, std::memory_order_release);
+        return &s;
+    }
+
+    void symbol_table::grow()
+    {
+        slots* old = m_slots.load();
+        std::unique_ptr<slots> bigger(new slots());
+        std::size_t size = (old->mask + 1) * 2;
+        bigger->mask = size - 1;
+        bigger->cells.reset(new std::atomic<const symbol*>[size]);
+        for(std::size_t i = 0; i < size; ++i)
+        {
+            bigger->cells[i].store(nullptr, std::memory_order_relaxed);
+        }
+        for(auto it = m_symbols.begin(); it != m_symbols.end(); ++it)
+        {
+            std::size_t i = (std::size_t)it->hash;
+            while(bigger->cells[i & bigger->mask].load(std::memory_order_relaxed))
+            {
+                ++i;
+            }
+            bigger->cells[i & bigger->mask].store(&*it, std::memory_order_relaxed);
+        }
+        m_slots.store(bigger.get(), std::memory_order_release);
+        m_all_slots.push_back(std::move(bigger));
+    }
+}
@@ -0,0 +1,78 @@
+//
+//  sio_symbol_table.h
+//
+//  Per client table of interned event names.
+//
+
+#ifndef SIO_SYMBOL_TABLE_H
+#define SIO_SYMBOL_TABLE_H
+
+#include "../sio_socket.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace sio
+{
+    struct symbol
+    {
+        std::string name;
+        std::uint64_t hash;
+    };
+
+    // Open addressing on the FNV-1a hash of the name. Symbols are never
+    // removed and keep their address, so a symbol pointer is the name's id.
+    // Lookups are lock-free and interning takes a mutex. Growing publishes
+    // a bigger slot array and keeps the old ones until the table goes,
+    // so a lookup still probing an old array stays valid.
+    class symbol_table
+    {
+    public:
+        // Names interned by lookup_or_intern, what the server sends, stop at
+        // max_auto so a server can't grow the table forever.
+        explicit symbol_table(std::size_t max_auto = 1024);
+
+        const symbol* intern(std::string const& name);
+
+        const symbol* intern(event_name const& name);
+
+        const symbol* find(std::string const& name) const;
+
+        const symbol* find(std::uint64_t hash, const char* str, std::size_t length) const;
+
+        // For inbound names, nullptr once max_auto names were added this way.
+        const symbol* lookup_or_intern(std::string const& name);
+
+        std::size_t size() const;
+
+        static std::uint64_t hash(const char* str, std::size_t length);
+
+    private:
+        struct slots
+        {
+            std::size_t mask;
+            std::unique_ptr<std::atomic<const symbol*>[]> cells;
+        };
+
+        const symbol* intern(std::uint64_t hash, const char* str, std::size_t length, bool automatic);
+
+        void grow();
+
+        mutable std::mutex m_mutex;
+
+        std::deque<symbol> m_symbols;
+
+        std::vector<std::unique_ptr<slots> > m_all_slots;
+
+        std::atomic<slots*> m_slots;
+
+        std::size_t m_max_auto;
+
+        std::atomic<std::size_t> m_auto;
+    };
+}
+#endif // SIO_SYMBOL_TABLE_H
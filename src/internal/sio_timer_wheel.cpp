@@ -0,0 +1,340 @@
+//
+//  sio_timer_wheel.cpp
+//
+//  Hierarchical timer wheel sharing one asio timer between all timeouts of a client.
+//
+
+#include "sio_timer_wheel.h"
+
+namespace sio
+{
+    using std::placeholders::_1;
+
+    namespace
+    {
+        const std::uint64_t kSLOT_MASK = 63;
+
+        inline unsigned lowest_bit(std::uint64_t v)
+        {
+#if defined(__GNUC__)
+            return (unsigned)__builtin_ctzll(v);
+#else
+            unsigned i = 0;
+            while(!(v & 1))
+            {
+                v >>= 1;
+                ++i;
+            }
+            return i;
+#endif
+        }
+
+        inline std::uint64_t rotate_right(std::uint64_t v, unsigned n)
+        {
+            n &= 63;
+            return n == 0 ? v : (v >> n) | (v << (64 - n));
+        }
+    }
+
+    timer_wheel::timer_wheel(boost::asio::io_service& io, unsigned tick_millis):
+        m_io(io),
+        m_timer(io),
+        m_start(std::chrono::steady_clock::now()),
+        m_tick(tick_millis > 0 ? tick_millis : 1),
+        m_free(kNIL),
+        m_now(0),
+        m_count(0),
+        m_scheduled(0)
+    {
+        for(unsigned i = 0; i < kLEVELS * kSLOTS; ++i)
+        {
+            m_heads[i] = kNIL;
+        }
+        for(unsigned l = 0; l < kLEVELS; ++l)
+        {
+            m_occupied[l] = 0;
+        }
+    }
+
+    timer_wheel::~timer_wheel()
+    {
+        boost::system::error_code ec;
+        m_timer.cancel(ec);
+    }
+
+    timer_wheel::timer_id timer_wheel::arm(unsigned delay_millis, handler const& h)
+    {
+        std::uint64_t expiry;
+        timer_id id;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            std::uint32_t index;
+            if(m_free != kNIL)
+            {
+                index = m_free;
+                m_free = m_nodes[index].next;
+            }
+            else
+            {
+                index = (std::uint32_t)m_nodes.size();
+                m_nodes.push_back(node());
+                m_nodes[index].generation = 1;
+            }
+            node& n = m_nodes[index];
+            std::uint64_t elapsed = (std::uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - m_start).count();
+            //never early: round the deadline up to the next tick.
+            expiry = (elapsed + delay_millis + m_tick - 1) / m_tick;
+            if(expiry <= m_now)
+            {
+                expiry = m_now + 1;
+            }
+            n.expiry = expiry;
+            n.fn = h;
+            this->place(index);
+            ++m_count;
+            id = ((timer_id)n.generation << 32) | (index + 1);
+        }
+        std::uint64_t scheduled = m_scheduled;
+        if(scheduled == 0 || expiry < scheduled)
+        {
+            m_io.post(std::bind(&timer_wheel::schedule, this));
+        }
+        return id;
+    }
+
+    bool timer_wheel::cancel(timer_id id)
+    {
+        std::uint32_t index = (std::uint32_t)(id & 0xFFFFFFFF);
+        if(index == 0)
+        {
+            return false;
+        }
+        --index;
+        handler fn;
+        bool idle;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            if(index >= m_nodes.size())
+            {
+                return false;
+            }
+            node& n = m_nodes[index];
+            if(!n.linked || n.generation != (std::uint32_t)(id >> 32))
+            {
+                return false;
+            }
+            this->unlink(index);
+            //destroy the handler outside the lock, it may own the caller.
+            fn.swap(n.fn);
+            this->release(index);
+            --m_count;
+            idle = m_count == 0;
+        }
+        if(idle && m_scheduled != 0)
+        {
+            //let the io_service run out once nothing is pending.
+            m_io.post(std::bind(&timer_wheel::schedule, this));
+        }
+        return true;
+    }
+
+    std::size_t timer_wheel::pending() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_count;
+    }
+
+    void timer_wheel::poll()
+    {
+        std::vector<handler> due;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            this->advance_to(this->current_tick(), due);
+        }
+        for(std::size_t i = 0; i < due.size(); ++i)
+        {
+            due[i]();
+        }
+        this->schedule();
+    }
+
+    std::uint64_t timer_wheel::current_tick() const
+    {
+        return (std::uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - m_start).count() / m_tick;
+    }
+
+    void timer_wheel::place(std::uint32_t index)
+    {
+        node& n = m_nodes[index];
+        unsigned level = 0;
+        std::uint64_t at = n.expiry > m_now ? n.expiry : m_now;
+        std::uint64_t delta = at - m_now;
+        while(level < kLEVELS - 1 && delta >= ((std::uint64_t)1 << (kSLOT_BITS * (level + 1))))
+        {
+            ++level;
+        }
+        std::uint64_t span = (std::uint64_t)1 << (kSLOT_BITS * kLEVELS);
+        if(delta >= span)
+        {
+            //beyond the top level, park it in the farthest slot and place it
+            //again when that slot cascades.
+            at = m_now + span - 1;
+        }
+        unsigned slot = level * kSLOTS + (unsigned)((at >> (kSLOT_BITS * level)) & kSLOT_MASK);
+        n.slot = (std::uint16_t)slot;
+        n.prev = kNIL;
+        n.next = m_heads[slot];
+        if(n.next != kNIL)
+        {
+            m_nodes[n.next].prev = index;
+        }
+        m_heads[slot] = index;
+        n.linked = true;
+        m_occupied[level] |= (std::uint64_t)1 << (slot & kSLOT_MASK);
+    }
+
+    void timer_wheel::unlink(std::uint32_t index)
+    {
+        node& n = m_nodes[index];
+        if(n.prev != kNIL)
+        {
+            m_nodes[n.prev].next = n.next;
+        }
+        else
+        {
+            m_heads[n.slot] = n.next;
+        }
+        if(n.next != kNIL)
+        {
+            m_nodes[n.next].prev = n.prev;
+        }
+        if(m_heads[n.slot] == kNIL)
+        {
+            m_occupied[n.slot / kSLOTS] &= ~((std::uint64_t)1 << (n.slot & kSLOT_MASK));
+        }
+        n.linked = false;
+    }
+
+    void timer_wheel::release(std::uint32_t index)
+    {
+        node& n = m_nodes[index];
+        n.fn = handler();
+        ++n.generation;
+        if(n.generation == 0)
+        {
+            n.generation = 1;
+        }
+        n.next = m_free;
+        m_free = index;
+    }
+
+    void timer_wheel::advance_to(std::uint64_t target, std::vector<handler>& due)
+    {
+        while(m_now < target)
+        {
+            std::uint64_t wake = this->next_wake();
+            if(wake == 0 || wake > target)
+            {
+                //nothing happens in between, skip the empty ticks.
+                m_now = target;
+                return;
+            }
+            m_now = wake;
+            for(unsigned level = kLEVELS - 1; level > 0; --level)
+            {
+                if((m_now & (((std::uint64_t)1 << (kSLOT_BITS * level)) - 1)) == 0)
+                {
+                    this->cascade(level);
+                }
+            }
+            unsigned slot = (unsigned)(m_now & kSLOT_MASK);
+            while(m_heads[slot] != kNIL)
+            {
+                std::uint32_t index = m_heads[slot];
+                this->unlink(index);
+                due.push_back(handler());
+                due.back().swap(m_nodes[index].fn);
+                this->release(index);
+                --m_count;
+            }
+        }
+    }
+
+    void timer_wheel::cascade(unsigned level)
+    {
+        unsigned slot = level * kSLOTS + (unsigned)((m_now >> (kSLOT_BITS * level)) & kSLOT_MASK);
+        std::uint32_t index = m_heads[slot];
+        m_heads[slot] = kNIL;
+        m_occupied[level] &= ~((std::uint64_t)1 << (slot & kSLOT_MASK));
+        while(index != kNIL)
+        {
+            std::uint32_t next = m_nodes[index].next;
+            this->place(index);
+            index = next;
+        }
+    }
+
+    std::uint64_t timer_wheel::next_wake() const
+    {
+        std::uint64_t wake = 0;
+        for(unsigned level = 0; level < kLEVELS; ++level)
+        {
+            if(m_occupied[level] == 0)
+            {
+                continue;
+            }
+            unsigned shift = kSLOT_BITS * level;
+            std::uint64_t block = m_now >> shift;
+            unsigned current = (unsigned)(block & kSLOT_MASK);
+            //distance to the first occupied slot after the current one.
+            std::uint64_t distance = lowest_bit(rotate_right(m_occupied[level], current + 1)) + 1;
+            std::uint64_t at = (block + distance) << shift;
+            if(wake == 0 || at < wake)
+            {
+                wake = at;
+            }
+        }
+        return wake;
+    }
+
+    void timer_wheel::schedule()
+    {
+        std::uint64_t wake;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            wake = this->next_wake();
+        }
+        boost::system::error_code ec;
+        if(wake == 0)
+        {
+            if(m_scheduled != 0)
+            {
+                m_scheduled = 0;
+                m_timer.cancel(ec);
+            }
+            return;
+        }
+        std::uint64_t scheduled = m_scheduled;
+        if(scheduled != 0 && scheduled <= wake)
+        {
+            return;
+        }
+        m_scheduled = wake;
+        long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_start).count();
+        long long wait = (long long)(wake * m_tick) - elapsed;
+        m_timer.expires_from_now(boost::posix_time::milliseconds(wait > 0 ? wait : 0), ec);
+        m_timer.async_wait(std::bind(&timer_wheel::on_timer, this, _1));
+    }
+
+    void timer_wheel::on_timer(boost::system::error_code const& ec)
+    {
+        if(ec)
+        {
+            return;
+        }
+        m_scheduled = 0;
+        this->poll();
+    }
+}
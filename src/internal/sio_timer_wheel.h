@@ -0,0 +1,117 @@
+//
+//  sio_timer_wheel.h
+//
+//  Hierarchical timer wheel sharing one asio timer between all timeouts of a client.
+//
+
+#ifndef SIO_TIMER_WHEEL_H
+#define SIO_TIMER_WHEEL_H
+
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/io_service.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace sio
+{
+    // Four levels of 64 slots, a timer sits in the level matching how far it
+    // is due and moves down as the wheel turns. Timers live in a slab and are
+    // linked into their slot, arm and cancel are O(1). Occupancy bitmaps let
+    // the asio timer sleep until the next occupied slot instead of ticking.
+    //
+    // arm and cancel may be called from any thread, handlers run on the
+    // thread running the io_service.
+    class timer_wheel
+    {
+    public:
+        typedef std::function<void()> handler;
+
+        // Slab index and generation, 0 is never a valid timer.
+        typedef std::uint64_t timer_id;
+
+        timer_wheel(boost::asio::io_service& io, unsigned tick_millis = 10);
+
+        ~timer_wheel();
+
+        timer_id arm(unsigned delay_millis, handler const& h);
+
+        // Returns false if the timer already fired or was cancelled,
+        // otherwise its handler won't be invoked.
+        bool cancel(timer_id id);
+
+        std::size_t pending() const;
+
+        // Moves the wheel to now and runs what is due, normally done by the
+        // asio timer. Exposed for tests.
+        void poll();
+
+    private:
+        static const unsigned kLEVELS = 4;
+
+        static const unsigned kSLOT_BITS = 6;
+
+        static const unsigned kSLOTS = 1 << kSLOT_BITS;
+
+        static const std::uint32_t kNIL = 0xFFFFFFFF;
+
+        struct node
+        {
+            std::uint64_t expiry;
+            std::uint32_t generation;
+            std::uint32_t prev;
+            std::uint32_t next;
+            std::uint16_t slot; // level * kSLOTS + index
+            bool linked;
+            handler fn;
+        };
+
+        std::uint64_t current_tick() const;
+
+        void place(std::uint32_t index);
+
+        void unlink(std::uint32_t index);
+
+        void release(std::uint32_t index);
+
+        void advance_to(std::uint64_t target, std::vector<handler>& due);
+
+        void cascade(unsigned level);
+
+        // Next tick at which something has to be done, 0 when empty.
+        std::uint64_t next_wake() const;
+
+        void schedule();
+
+        void on_timer(boost::system::error_code const& ec);
+
+        boost::asio::io_service& m_io;
+
+        boost::asio::deadline_timer m_timer;
+
+        std::chrono::steady_clock::time_point m_start;
+
+        unsigned m_tick;
+
+        mutable std::mutex m_mutex;
+
+        std::vector<node> m_nodes;
+
+        std::uint32_t m_free;
+
+        std::uint32_t m_heads[kLEVELS * kSLOTS];
+
+        std::uint64_t m_occupied[kLEVELS];
+
+        std::uint64_t m_now;
+
+        std::size_t m_count;
+
+        // Tick the asio timer waits for, 0 when idle.
+        std::atomic<std::uint64_t> m_scheduled;
+    };
+}
+#endif // SIO_TIMER_WHEEL_H
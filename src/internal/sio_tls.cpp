@@ -0,0 +1,152 @@
+//
+//  sio_tls.cpp
+//
+//  TLS context shared by the connections of a client and session resumption.
+//
+
+#include "sio_tls.h"
+
+#if SIO_TLS
+#include "sio_log.h"
+#include <ctime>
+
+namespace sio
+{
+    namespace
+    {
+        // asio keeps its verify callback in the context's app data, the cache
+        // pointer goes into an ex_data slot of its own.
+        int cache_index()
+        {
+            static int index = SSL_CTX_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+            return index;
+        }
+    }
+
+    tls_session_cache::tls_session_cache():
+        m_session(nullptr),
+        m_handshakes(0),
+        m_resumed(0),
+        m_handshake_time(0)
+    {
+    }
+
+    tls_session_cache::~tls_session_cache()
+    {
+        this->clear();
+    }
+
+    tls_session_cache::context_ptr tls_session_cache::create_context()
+    {
+        using boost::asio::ssl::context;
+        context_ptr ctx = context_ptr(new context(context::sslv23_client));
+        boost::system::error_code ec;
+        ctx->set_options(context::default_workarounds |
+                         context::no_sslv2 |
+                         context::no_sslv3 |
+                         context::no_tlsv1 |
+                         context::no_tlsv1_1 |
+                         context::single_dh_use,ec);
+        if(ec)
+        {
+            SIO_LOG(logger::level_error, "Init tls failed,reason:"<< ec.message());
+        }
+        SSL_CTX* native = ctx->native_handle();
+        // Sessions live in this cache only, the internal store is server side
+        // style lookup by id which a client never does.
+        SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_set_ex_data(native, cache_index(), this);
+        SSL_CTX_sess_set_new_cb(native, &tls_session_cache::on_new_session);
+        return ctx;
+    }
+
+    void tls_session_cache::prepare(SSL* ssl)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if(m_session && static_cast<long>(std::time(NULL)) >= SSL_SESSION_get_time(m_session) + SSL_SESSION_get_timeout(m_session))
+        {
+            //the server would only turn it down.
+            SSL_SESSION_free(m_session);
+            m_session = nullptr;
+            m_server_name.clear();
+        }
+        if(m_session && m_server_name == server_name(ssl))
+        {
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+            //a dropped connection spoils the session it used, hand out a copy.
+            SSL_SESSION* copy = SSL_SESSION_dup(m_session);
+            if(copy)
+            {
+                SSL_set_session(ssl, copy);
+                SSL_SESSION_free(copy);
+            }
+#else
+            SSL_set_session(ssl, m_session);
+#endif
+        }
+    }
+
+    void tls_session_cache::handshake_done(SSL* ssl, std::chrono::steady_clock::duration elapsed)
+    {
+        if(!SSL_is_init_finished(ssl))
+        {
+            return;
+        }
+        m_handshakes++;
+        if(SSL_session_reused(ssl))
+        {
+            m_resumed++;
+        }
+        m_handshake_time += std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    }
+
+    void tls_session_cache::clear()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if(m_session)
+        {
+            SSL_SESSION_free(m_session);
+            m_session = nullptr;
+        }
+        m_server_name.clear();
+    }
+
+    int tls_session_cache::on_new_session(SSL* ssl, SSL_SESSION* session)
+    {
+        tls_session_cache* self = static_cast<tls_session_cache*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), cache_index()));
+        if(!self)
+        {
+            return 0;
+        }
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+        // OpenSSL marks the session of a connection which drops without
+        // close_notify as not resumable, a copy stays usable for the reconnect.
+        SSL_SESSION* copy = SSL_SESSION_dup(session);
+        if(!copy)
+        {
+            return 0;
+        }
+#else
+        SSL_SESSION* copy = session;
+#endif
+        std::lock_guard<std::mutex> guard(self->m_mutex);
+        if(self->m_session)
+        {
+            SSL_SESSION_free(self->m_session);
+        }
+        self->m_session = copy;
+        self->m_server_name = server_name(ssl);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+        return 0;
+#else
+        return 1;//keeps the reference.
+#endif
+    }
+
+    std::string tls_session_cache::server_name(SSL* ssl)
+    {
+        const char* name = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+        return name ? name : std::string();
+    }
+}
+#endif // SIO_TLS
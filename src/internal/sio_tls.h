@@ -0,0 +1,72 @@
+//
+//  sio_tls.h
+//
+//  TLS context shared by the connections of a client and session resumption.
+//
+
+#ifndef SIO_TLS_H
+#define SIO_TLS_H
+
+#if SIO_TLS
+#include <boost/asio/ssl.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace sio
+{
+    // Keeps the last TLS session (session id or ticket) per server name so a
+    // reconnect does an abbreviated handshake, and counts the handshakes.
+    // prepare and handshake_done may be called from any thread.
+    class tls_session_cache
+    {
+    public:
+        typedef std::shared_ptr<boost::asio::ssl::context> context_ptr;
+
+        tls_session_cache();
+
+        ~tls_session_cache();
+
+        // TLS 1.2 or newer client context handing its new sessions to this cache.
+        context_ptr create_context();
+
+        // Offers the cached session before the handshake, after SNI was set.
+        // An expired session is dropped instead.
+        void prepare(SSL* ssl);
+
+        // Counts the handshake if it completed, websocketpp's tcp post init
+        // handler runs after a failed one too.
+        void handshake_done(SSL* ssl, std::chrono::steady_clock::duration elapsed);
+
+        void clear();
+
+        unsigned handshakes() const { return m_handshakes; }
+
+        unsigned resumed() const { return m_resumed; }
+
+        // Total time spent in handshakes, microseconds.
+        unsigned long long handshake_time() const { return m_handshake_time; }
+
+    private:
+        static int on_new_session(SSL* ssl, SSL_SESSION* session);
+
+        static std::string server_name(SSL* ssl);
+
+        std::mutex m_mutex;
+
+        std::string m_server_name;
+
+        SSL_SESSION* m_session;
+
+        std::atomic<unsigned> m_handshakes;
+
+        std::atomic<unsigned> m_resumed;
+
+        std::atomic<unsigned long long> m_handshake_time;
+    };
+}
+#endif // SIO_TLS
+
+#endif // SIO_TLS_H
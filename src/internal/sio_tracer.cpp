@@ -0,0 +1,123 @@
+//
+//  sio_tracer.cpp
+//
+//  Sampled tracing of emits from socket::emit to the ack.
+//
+
+#include "sio_tracer.h"
+
+namespace sio
+{
+    emit_tracer::emit_tracer():
+        m_every(0),
+        m_count(0),
+        m_done(1024)
+    {
+    }
+
+    void emit_tracer::set(unsigned sample_every, client::trace_listener const& listener)
+    {
+        m_listener = listener;
+        m_count = 0;
+        m_every.store(sample_every, std::memory_order_relaxed);
+    }
+
+    std::shared_ptr<emit_trace> emit_tracer::sample(unsigned every, std::string const& nsp, std::string const& name)
+    {
+        if(m_count.fetch_add(1, std::memory_order_relaxed) % every != 0)
+        {
+            return std::shared_ptr<emit_trace>();
+        }
+        std::shared_ptr<emit_trace> trace = std::make_shared<emit_trace>();
+        trace->emitted = clock::now();
+        trace->nsp = nsp;
+        trace->name = name;
+        trace->ack_id = -1;
+        trace->status = socket::ack_ok;
+        return trace;
+    }
+
+    void emit_tracer::written(std::shared_ptr<emit_trace> const& trace, clock::time_point now)
+    {
+        trace->written = now;
+        if(trace->ack_id < 0 || trace->status != socket::ack_ok)
+        {
+            this->done(trace);
+        }
+        else
+        {
+            m_waiting[std::make_pair(trace->nsp, trace->ack_id)] = trace;
+        }
+    }
+
+    void emit_tracer::ack_arrived(std::string const& nsp, int ack_id)
+    {
+        auto it = m_waiting.find(std::make_pair(nsp, ack_id));
+        if(it != m_waiting.end())
+        {
+            std::shared_ptr<emit_trace> trace = it->second;
+            m_waiting.erase(it);
+            trace->acked = clock::now();
+            this->done(trace);
+        }
+    }
+
+    void emit_tracer::ack_failed(std::shared_ptr<emit_trace> const& trace, socket::ack_status status)
+    {
+        trace->status = status;
+        if(trace->written != clock::time_point())
+        {
+            auto it = m_waiting.find(std::make_pair(trace->nsp, trace->ack_id));
+            if(it != m_waiting.end() && it->second == trace)
+            {
+                m_waiting.erase(it);
+                this->done(trace);
+            }
+        }
+    }
+
+    void emit_tracer::dropped(std::shared_ptr<emit_trace> const& trace, socket::ack_status status)
+    {
+        if(trace->status == socket::ack_ok)
+        {
+            trace->status = status;
+        }
+        this->done(trace);
+    }
+
+    void emit_tracer::abandon()
+    {
+        for(auto it = m_waiting.begin(); it != m_waiting.end(); ++it)
+        {
+            it->second->status = socket::ack_disconnected;
+            this->done(it->second);
+        }
+        m_waiting.clear();
+    }
+
+    void emit_tracer::done(std::shared_ptr<emit_trace> const& trace)
+    {
+        if(m_listener)
+        {
+            m_listener(*trace);
+        }
+        else
+        {
+            //full, the reader is behind and loses the newest.
+            m_done.push(trace);
+        }
+    }
+
+    std::size_t emit_tracer::drain(std::vector<emit_trace>& out)
+    {
+        std::lock_guard<std::mutex> guard(m_drain_mutex);
+        std::size_t count = 0;
+        std::shared_ptr<emit_trace> trace;
+        while(m_done.pop(trace))
+        {
+            out.push_back(*trace);
+            ++count;
+        }
+        return count;
+    }
+}
@@ -0,0 +1,89 @@
+//
+//  sio_tracer.h
+//
+//  Sampled tracing of emits from socket::emit to the ack.
+//
+
+#ifndef SIO_TRACER_H
+#define SIO_TRACER_H
+
+#include "../sio_client.h"
+#include "sio_mpsc_ring.h"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sio
+{
+    // The trace travels with the packet, each stage stamps it on the thread
+    // that owns the packet at that point. start runs on the emitting
+    // threads, drain on the reader's, the rest on the network thread. With
+    // tracing off start costs a relaxed load.
+    class emit_tracer
+    {
+    public:
+        typedef std::chrono::steady_clock clock;
+
+        emit_tracer();
+
+        // Before the network thread runs.
+        void set(unsigned sample_every, client::trace_listener const& listener);
+
+        // nullptr unless this emit is sampled.
+        std::shared_ptr<emit_trace> start(std::string const& nsp, std::string const& name)
+        {
+            unsigned every = m_every.load(std::memory_order_relaxed);
+            return every ? this->sample(every, nsp, name) : std::shared_ptr<emit_trace>();
+        }
+
+        // Handed to the transport, done unless it waits for an ack.
+        void written(std::shared_ptr<emit_trace> const& trace, clock::time_point now);
+
+        void acked(std::string const& nsp, int ack_id)
+        {
+            if(!m_waiting.empty())
+            {
+                this->ack_arrived(nsp, ack_id);
+            }
+        }
+
+        // The ack of a traced emit failed. Done now if it waits for the ack,
+        // else once written.
+        void ack_failed(std::shared_ptr<emit_trace> const& trace, socket::ack_status status);
+
+        // Never written, done with status unless its ack failed first.
+        void dropped(std::shared_ptr<emit_trace> const& trace, socket::ack_status status);
+
+        // The connection closed, traces waiting for an ack are done without it.
+        void abandon();
+
+        std::size_t drain(std::vector<emit_trace>& out);
+
+    private:
+        std::shared_ptr<emit_trace> sample(unsigned every, std::string const& nsp, std::string const& name);
+
+        void ack_arrived(std::string const& nsp, int ack_id);
+
+        void done(std::shared_ptr<emit_trace> const& trace);
+
+        std::atomic<unsigned> m_every;
+
+        std::atomic<unsigned> m_count;
+
+        client::trace_listener m_listener;
+
+        mpsc_ring<std::shared_ptr<emit_trace> > m_done;
+
+        // The ring has a single consumer.
+        std::mutex m_drain_mutex;
+
+        // Written and waiting for their ack, by namespace and ack id.
+        std::map<std::pair<std::string, int>, std::shared_ptr<emit_trace> > m_waiting;
+    };
+}
+#endif // SIO_TRACER_H
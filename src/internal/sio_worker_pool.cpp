@@ -0,0 +1,173 @@
+//
+//  sio_worker_pool.cpp
+//
+//  Work stealing thread pool running listeners in order per key.
+//
+
+#include "sio_worker_pool.h"
+
+namespace sio
+{
+    namespace
+    {
+        // Tasks a strand runs before it lets the next strand in line go.
+        const unsigned kBATCH = 16;
+    }
+
+    worker_pool::worker_pool(unsigned threads):
+        m_runnable(0),
+        m_next_worker(0),
+        m_stopping(false)
+    {
+        if(threads == 0)
+        {
+            threads = std::thread::hardware_concurrency();
+            if(threads == 0)
+            {
+                threads = 2;
+            }
+        }
+        for(unsigned i = 0; i < threads; ++i)
+        {
+            m_workers.push_back(std::unique_ptr<worker>(new worker()));
+        }
+        for(unsigned i = 0; i < threads; ++i)
+        {
+            m_workers[i]->thread = std::thread(&worker_pool::run, this, i);
+        }
+    }
+
+    worker_pool::~worker_pool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_idle_mutex);
+            m_stopping = true;
+        }
+        m_idle.notify_all();
+        for(std::size_t i = 0; i < m_workers.size(); ++i)
+        {
+            m_workers[i]->thread.join();
+        }
+    }
+
+    void worker_pool::submit(std::size_t key, std::function<void()> const& task)
+    {
+        strand_ptr s;
+        bool idle = false;
+        {
+            std::lock_guard<std::mutex> guard(m_strand_mutex);
+            strand_ptr& slot = m_strands[key];
+            if(!slot)
+            {
+                slot = std::make_shared<strand>();
+                slot->key = key;
+                idle = true;
+            }
+            s = slot;
+            std::lock_guard<std::mutex> strand_guard(s->mutex);
+            s->tasks.push_back(task);
+        }
+        if(idle)
+        {
+            this->schedule(s);
+        }
+    }
+
+    void worker_pool::schedule(strand_ptr const& s)
+    {
+        worker& w = *m_workers[m_next_worker++ % m_workers.size()];
+        {
+            std::lock_guard<std::mutex> guard(w.mutex);
+            w.runnable.push_back(s);
+        }
+        ++m_runnable;
+        {
+            //pairs with the predicate check of an idle worker.
+            std::lock_guard<std::mutex> guard(m_idle_mutex);
+        }
+        m_idle.notify_one();
+    }
+
+    bool worker_pool::next(unsigned index, strand_ptr& s)
+    {
+        {
+            worker& own = *m_workers[index];
+            std::lock_guard<std::mutex> guard(own.mutex);
+            if(!own.runnable.empty())
+            {
+                s = own.runnable.front();
+                own.runnable.pop_front();
+                --m_runnable;
+                return true;
+            }
+        }
+        for(std::size_t i = 1; i < m_workers.size(); ++i)
+        {
+            worker& victim = *m_workers[(index + i) % m_workers.size()];
+            std::lock_guard<std::mutex> guard(victim.mutex);
+            if(!victim.runnable.empty())
+            {
+                s = victim.runnable.back();
+                victim.runnable.pop_back();
+                --m_runnable;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool worker_pool::run_strand(strand_ptr const& s)
+    {
+        for(unsigned i = 0; i < kBATCH; ++i)
+        {
+            std::function<void()> task;
+            {
+                std::lock_guard<std::mutex> guard(s->mutex);
+                if(s->tasks.empty())
+                {
+                    break;
+                }
+                task.swap(s->tasks.front());
+                s->tasks.pop_front();
+            }
+            task();
+        }
+        std::lock_guard<std::mutex> guard(m_strand_mutex);
+        std::lock_guard<std::mutex> strand_guard(s->mutex);
+        if(s->tasks.empty())
+        {
+            //a later submit starts a new strand, this one has nothing running anymore.
+            m_strands.erase(s->key);
+            return false;
+        }
+        return true;
+    }
+
+    void worker_pool::run(unsigned index)
+    {
+        while(true)
+        {
+            strand_ptr s;
+            if(this->next(index, s))
+            {
+                if(this->run_strand(s))
+                {
+                    worker& own = *m_workers[index];
+                    {
+                        std::lock_guard<std::mutex> guard(own.mutex);
+                        own.runnable.push_back(s);
+                    }
+                    ++m_runnable;
+                    m_idle.notify_one();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_idle_mutex);
+            m_idle.wait(lock, [this]() { return m_runnable > 0 || m_stopping; });
+            if(m_stopping && m_runnable == 0)
+            {
+                return;
+            }
+        }
+    }
+}
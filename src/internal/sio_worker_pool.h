@@ -0,0 +1,85 @@
+//
+//  sio_worker_pool.h
+//
+//  Work stealing thread pool running listeners in order per key.
+//
+
+#ifndef SIO_WORKER_POOL_H
+#define SIO_WORKER_POOL_H
+
+#include "../sio_client.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace sio
+{
+    // Tasks of one key form a strand, at most one worker runs a strand at a
+    // time so they keep their order. Runnable strands sit in per worker
+    // deques: a worker takes from the front of its own and steals from the
+    // back of the others when it runs dry. A strand runs a batch of tasks and
+    // then goes back in line so a busy key can't starve the others.
+    class worker_pool : public event_executor
+    {
+    public:
+        // 0 threads uses one per core.
+        explicit worker_pool(unsigned threads = 0);
+
+        // Runs what was submitted before returning.
+        ~worker_pool();
+
+        void submit(std::size_t key, std::function<void()> const& task);
+
+        unsigned size() const { return (unsigned)m_workers.size(); }
+
+    private:
+        struct strand
+        {
+            std::size_t key;
+            std::mutex mutex;
+            std::deque<std::function<void()> > tasks;
+        };
+
+        typedef std::shared_ptr<strand> strand_ptr;
+
+        struct worker
+        {
+            std::mutex mutex;
+            std::deque<strand_ptr> runnable;
+            std::thread thread;
+        };
+
+        void run(unsigned index);
+
+        bool next(unsigned index, strand_ptr& s);
+
+        // Runs a batch, returns whether the strand has tasks left.
+        bool run_strand(strand_ptr const& s);
+
+        void schedule(strand_ptr const& s);
+
+        std::vector<std::unique_ptr<worker> > m_workers;
+
+        // Strands with queued or running tasks, a strand is in here exactly
+        // while it's scheduled.
+        std::mutex m_strand_mutex;
+
+        std::unordered_map<std::size_t, strand_ptr> m_strands;
+
+        std::mutex m_idle_mutex;
+
+        std::condition_variable m_idle;
+
+        std::atomic<std::size_t> m_runnable;
+
+        std::atomic<unsigned> m_next_worker;
+
+        bool m_stopping;
+    };
+}
+#endif // SIO_WORKER_POOL_H
@@ -6,6 +6,7 @@
 
 #include "sio_client.h"
 #include "internal/sio_client_impl.h"
+#include "internal/sio_worker_pool.h"
 
 using namespace websocketpp;
 using boost::posix_time::milliseconds;
@@ -110,6 +111,11 @@ namespace sio
         return m_impl->get_sessionid();
     }
 
+    unsigned client::get_rtt() const
+    {
+        return m_impl->get_rtt();
+    }
+
     void client::set_reconnect_attempts(int attempts)
     {
         m_impl->set_reconnect_attempts(attempts);
@@ -124,5 +130,100 @@ namespace sio
     {
         m_impl->set_reconnect_delay_max(millis);
     }
+
+    void client::set_reconnect_jitter(reconnect_jitter jitter)
+    {
+        m_impl->set_reconnect_jitter(jitter);
+    }
+
+    void client::set_max_concurrent_reconnects(unsigned max)
+    {
+        reconnect_gate::global().set_limit(max);
+    }
+
+    void client::set_logger(std::shared_ptr<logger> const& l)
+    {
+        log_sink::global().set_logger(l);
+    }
+
+    void client::set_log_level(logger::level l)
+    {
+        log_sink::global().set_level(l);
+    }
+
+    std::shared_ptr<logger> client::create_async_logger(std::shared_ptr<logger> const& sink, std::size_t capacity)
+    {
+        return std::make_shared<async_logger>(sink ? sink : log_sink::console(), capacity);
+    }
+
+    void client::set_connection_state_recovery(bool enable)
+    {
+        m_impl->set_connection_state_recovery(enable);
+    }
+
+    void client::set_transport(transport t)
+    {
+        m_impl->set_transport(t);
+    }
+
+    void client::set_upgrade(bool upgrade)
+    {
+        m_impl->set_upgrade(upgrade);
+    }
+
+    client::tls_stats client::get_tls_stats() const
+    {
+        return m_impl->get_tls_stats();
+    }
+
+    client::metrics client::get_metrics() const
+    {
+        return m_impl->get_metrics();
+    }
+
+    void client::set_emit_tracing(unsigned sample_every, trace_listener const& listener)
+    {
+        m_impl->get_tracer().set(sample_every, listener);
+    }
+
+    std::size_t client::drain_emit_traces(std::vector<emit_trace>& out)
+    {
+        return m_impl->get_tracer().drain(out);
+    }
+
+    void client::set_open_timeout(unsigned millis)
+    {
+        m_impl->set_open_timeout(millis);
+    }
+
+    void client::set_handshake_timeout(unsigned millis)
+    {
+        m_impl->set_handshake_timeout(millis);
+    }
+
+    void client::set_dns_cache_ttl(unsigned seconds)
+    {
+        m_impl->set_dns_cache_ttl(seconds);
+    }
+
+    void client::set_volatile_buffer_limit(std::size_t bytes)
+    {
+        m_impl->set_volatile_buffer_limit(bytes);
+    }
+
+    void client::set_namespace_weight(std::string const& nsp, unsigned weight)
+    {
+        m_impl->set_namespace_weight(nsp, weight);
+    }
+
+    void client::set_event_executor(std::shared_ptr<event_executor> const& executor, dispatch_key const& key)
+    {
+        m_impl->set_event_executor(executor, key);
+    }
+
+    std::shared_ptr<event_executor> client::create_worker_pool(unsigned threads)
+    {
+        return std::make_shared<worker_pool>(threads);
+    }
     
 }
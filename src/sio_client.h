@@ -7,13 +7,72 @@
 #ifndef SIO_CLIENT_H
 #define SIO_CLIENT_H
 #include <string>
+#include <chrono>
 #include <functional>
+#include <map>
+#include <memory>
+#include <vector>
 #include "sio_message.h"
 #include "sio_socket.h"
 
 namespace sio
 {
     class client_impl;
+
+    // Runs event listeners and ack callbacks away from the network thread.
+    // Tasks submitted with the same key must run one at a time, in order.
+    class event_executor
+    {
+    public:
+        virtual ~event_executor() {}
+
+        virtual void submit(std::size_t key, std::function<void()> const& task) = 0;
+    };
+
+    // Receives the library's log lines, without trailing newline. Called
+    // from any thread, the network thread included, so it should return quickly.
+    class logger
+    {
+    public:
+        enum level
+        {
+            level_debug,
+            level_info,
+            level_warning,
+            level_error,
+            level_none
+        };
+
+        virtual ~logger() {}
+
+        virtual void log(level l, char const* message, std::size_t length) = 0;
+    };
+
+    // Steady clock timestamps of a traced emit at each stage on its way out.
+    // A stage not reached is left default constructed.
+    struct emit_trace
+    {
+        std::string nsp;
+        std::string name;
+        // -1 when no ack was asked for.
+        int ack_id;
+        // socket::emit called.
+        std::chrono::steady_clock::time_point emitted;
+        // Encoded, once the socket is connected and the rate limits let it go.
+        std::chrono::steady_clock::time_point encoded;
+        // Pushed to the client's outbound queue.
+        std::chrono::steady_clock::time_point queued;
+        // Taken from the queue on the network thread.
+        std::chrono::steady_clock::time_point dispatched;
+        // Handed to the transport, after its turn in the priority lanes.
+        std::chrono::steady_clock::time_point written;
+        // Ack received.
+        std::chrono::steady_clock::time_point acked;
+        // ack_ok unless it ended early: ack_timeout or ack_disconnected when
+        // its ack failed, ack_rejected when a rate limit or the pending ack
+        // cap discarded it, ack_disconnected when it was dropped unwritten.
+        socket::ack_status status;
+    };
     
     class client {
     public:
@@ -22,6 +81,19 @@ namespace sio
             close_reason_normal,
             close_reason_drop
         };
+
+        enum reconnect_jitter
+        {
+            jitter_none,
+            jitter_full,
+            jitter_decorrelated
+        };
+
+        enum transport
+        {
+            transport_websocket,
+            transport_polling
+        };
         
         typedef std::function<void(void)> con_listener;
         
@@ -30,6 +102,9 @@ namespace sio
         typedef std::function<void(unsigned, unsigned)> reconnect_listener;
         
         typedef std::function<void(std::string const& nsp)> socket_listener;
+
+        // Ordering key of an event for the executor, the event name is empty for acks.
+        typedef std::function<std::size_t(std::string const& nsp, std::string const& event_name)> dispatch_key;
         
         client();
         ~client();
@@ -66,6 +141,68 @@ namespace sio
         void set_reconnect_delay(unsigned millis);
 
         void set_reconnect_delay_max(unsigned millis);
+
+        void set_reconnect_jitter(reconnect_jitter jitter);
+
+        // Caps reconnect attempts in flight across all clients of the process, 0 for no cap.
+        static void set_max_concurrent_reconnects(unsigned max);
+
+        // Where all clients of the process log, nullptr for the console.
+        static void set_logger(std::shared_ptr<logger> const& l);
+
+        // Lines below this level are skipped before they are formatted.
+        // level_info by default, level_debug in debug builds.
+        static void set_log_level(logger::level l);
+
+        // Hands lines to sink (nullptr for the console) on a thread of its
+        // own, so logging never waits for I/O. Lines beyond capacity waiting
+        // are dropped.
+        static std::shared_ptr<logger> create_async_logger(std::shared_ptr<logger> const& sink = nullptr, std::size_t capacity = 1024);
+
+        // Resume namespace sessions after a reconnect (socket.io v4.6+ servers).
+        void set_connection_state_recovery(bool enable);
+
+        // Transport used to open the connection, takes effect on next connect.
+        void set_transport(transport t);
+
+        // Whether a polling connection probes and upgrades to websocket.
+        void set_upgrade(bool upgrade);
+
+        // TLS handshakes made, how many resumed a session and their total duration in microseconds.
+        struct tls_stats
+        {
+            unsigned handshakes;
+            unsigned resumed;
+            unsigned long long handshake_time;
+        };
+
+        tls_stats get_tls_stats() const;
+
+        // Time allowed to resolve the host and, if it has several addresses,
+        // to find one accepting a TCP connection.
+        void set_open_timeout(unsigned millis);
+
+        // Time allowed for the websocket opening handshake once connected.
+        void set_handshake_timeout(unsigned millis);
+
+        // How long resolved addresses are reused, 0 resolves on every attempt.
+        void set_dns_cache_ttl(unsigned seconds);
+
+        // socket::emit_volatile drops events while this many bytes or more
+        // wait to be written, 64 KiB by default.
+        void set_volatile_buffer_limit(std::size_t bytes);
+
+        // Share of the connection a namespace gets while others have packets
+        // waiting too, in proportion to the weights of those namespaces. 1 by default.
+        void set_namespace_weight(std::string const& nsp, unsigned weight);
+
+        // Run listeners on executor instead of the network thread, in order per
+        // namespace or per key if given. nullptr runs them inline again.
+        // Set it before connecting.
+        void set_event_executor(std::shared_ptr<event_executor> const& executor, dispatch_key const& key = nullptr);
+
+        // Work stealing pool keeping the order per key, 0 threads for one per core.
+        static std::shared_ptr<event_executor> create_worker_pool(unsigned threads = 0);
         
         sio::socket::ptr const& socket(const std::string& nsp = "");
         
@@ -77,6 +214,65 @@ namespace sio
         bool opened() const;
         
         std::string const& get_sessionid() const;
+
+        // Round trip time in microseconds measured on the last server ping, 0 until measured.
+        unsigned get_rtt() const;
+
+        // Durations by powers of two: buckets[0] counts those under 1 microsecond,
+        // buckets[i] those from 2^(i-1) to 2^i microseconds, the last also all longer.
+        struct histogram
+        {
+            enum { bucket_count = 24 };
+            unsigned long long count;
+            // Microseconds.
+            unsigned long long sum;
+            unsigned long long buckets[bucket_count];
+
+            // Upper bound in microseconds of the bucket holding quantile q (0 to 1), 0 when empty.
+            unsigned long long percentile(double q) const;
+        };
+
+        // Counters since the client was created. Each is read on its own, a
+        // snapshot taken under load needn't add up exactly.
+        struct metrics
+        {
+            // Engine.IO frames and their bytes, both transports.
+            unsigned long long bytes_in;
+            unsigned long long bytes_out;
+            unsigned long long frames_in;
+            unsigned long long frames_out;
+            // Socket.IO packets indexed by type: connect, disconnect, event,
+            // ack, error, binary event, binary ack. Outgoing ones count once
+            // handed to the transport, not those dropped before.
+            unsigned long long packets_in[7];
+            unsigned long long packets_out[7];
+            // Sampled, one packet encoded and one frame decoded in 16 is timed.
+            histogram encode_time;
+            histogram decode_time;
+            histogram rtt;
+            unsigned reconnect_attempts;
+            unsigned reconnects;
+            // Bytes emitted but not handed to the transport yet, and handed
+            // over but not written yet.
+            std::size_t outbound_bytes;
+            std::size_t transport_bytes;
+            tls_stats tls;
+            std::map<std::string, socket::metrics> sockets;
+        };
+
+        metrics get_metrics() const;
+
+        typedef std::function<void(emit_trace const&)> trace_listener;
+
+        // Trace one in every sample_every emits, 0 (default) traces none. A
+        // trace is done once written, or acked if it asked for an ack. Done
+        // traces go to listener on the network thread, or without one to a
+        // ring of 1024 traces read by drain_emit_traces. Set it before connecting.
+        void set_emit_tracing(unsigned sample_every, trace_listener const& listener = nullptr);
+
+        // Appends the done traces to out, returns how many. Traces done while
+        // the ring is full are lost.
+        std::size_t drain_emit_traces(std::vector<emit_trace>& out);
         
     private:
         //disable copy constructor and assign operator.
@@ -1,16 +1,15 @@
 #include "sio_socket.h"
 #include "internal/sio_packet.h"
 #include "internal/sio_client_impl.h"
-#include <boost/asio/deadline_timer.hpp>
+#include "internal/sio_journal.h"
+#include "internal/sio_ack_table.h"
+#include "internal/sio_event_index.h"
+#include "internal/sio_rate_limiter.h"
+#include "internal/sio_log.h"
 #include <boost/system/error_code.hpp>
 #include <queue>
 #include <cstdarg>
-
-#if DEBUG || _DEBUG
-#define LOG(x) std::cout << x
-#else
-#define LOG(x)
-#endif
+#include <condition_variable>
 
 #define NULL_GUARD(_x_)  \
     if(_x_ == NULL) return
@@ -32,7 +31,12 @@ namespace sio
         
         static inline event create_event(std::string const& nsp,std::string const& name,message::list&& message,bool need_ack)
         {
-            return event(nsp,name,message,need_ack);
+            return event(nsp,name,std::move(message),need_ack);
+        }
+
+        static inline event create_event(std::string const& nsp,std::string const* name,message::list&& message,bool need_ack)
+        {
+            return event(nsp,name,std::move(message),need_ack);
         }
     };
     
@@ -43,7 +47,7 @@ namespace sio
     
     const std::string& event::get_name() const
     {
-        return m_name;
+        return *m_name;
     }
     
     const message::ptr& event::get_message() const
@@ -76,7 +80,8 @@ namespace sio
     inline
     event::event(std::string const& nsp,std::string const& name,message::list&& messages,bool need_ack):
         m_nsp(nsp),
-        m_name(name),
+        m_name_storage(name),
+        m_name(&m_name_storage),
         m_messages(std::move(messages)),
         m_need_ack(need_ack)
     {
@@ -85,11 +90,31 @@ namespace sio
     inline
     event::event(std::string const& nsp,std::string const& name,message::list const& messages,bool need_ack):
         m_nsp(nsp),
-        m_name(name),
+        m_name_storage(name),
+        m_name(&m_name_storage),
         m_messages(messages),
         m_need_ack(need_ack)
     {
     }
+
+    inline
+    event::event(std::string const& nsp,std::string const* name,message::list&& messages,bool need_ack):
+        m_nsp(nsp),
+        m_name(name),
+        m_messages(std::move(messages)),
+        m_need_ack(need_ack)
+    {
+    }
+
+    event::event(event const& other):
+        m_nsp(other.m_nsp),
+        m_name_storage(other.m_name_storage),
+        m_name(other.m_name == &other.m_name_storage ? &m_name_storage : other.m_name),
+        m_messages(other.m_messages),
+        m_need_ack(other.m_need_ack),
+        m_ack_message(other.m_ack_message)
+    {
+    }
     
     message::list const& event::get_ack_message() const
     {
@@ -114,8 +139,24 @@ namespace sio
         void on(std::string const& event_name,event_listener const& func);
         
         void off(std::string const& event_name);
+
+        void on(sio::event_name const& name,event_listener const& func);
+
+        void off(sio::event_name const& name);
         
         void off_all();
+
+        void on_pattern(std::string const& pattern,event_listener const& func);
+
+        void set_inbound_policy(std::string const& name, std::shared_ptr<inbound_policy> const& policy);
+
+        std::size_t get_inbound_conflated_count() const {return m_inbound_conflated;}
+
+        std::size_t get_inbound_dropped_count() const {return m_inbound_dropped;}
+
+        void off_pattern(std::string const& pattern);
+
+        void on_any(event_listener const& func);
         
 #define SYNTHESIS_SETTER(__TYPE__,__FIELD__) \
     void set_##__FIELD__(__TYPE__ const& l) \
@@ -131,9 +172,37 @@ namespace sio
         
         void close();
         
-        void emit(std::string const& name, message::list const& msglist, std::function<void (message::list const&)> const& ack);
+        void emit(std::string const& name, message::list const& msglist, std::function<void (message::list const&)> const& ack, priority p);
+
+        void emit_with_ack(std::string const& name, message::list const& msglist, ack_listener const& ack, unsigned timeout_millis, priority p);
+
+        void set_max_pending_acks(unsigned max);
+
+        std::size_t get_pending_ack_count() const;
+
+        bool emit_volatile(std::string const& name, message::list const& msglist);
+
+        void emit_conflated(std::string const& name, std::string const& key, message::list const& msglist, priority p);
+
+        std::size_t get_conflated_count() const {return m_conflated_count;}
+
+        std::size_t get_volatile_drop_count() const {return m_volatile_drops;}
+
+        std::size_t get_outbound_queue_length() const {return m_flow ? m_flow->queued_packets() : 0;}
+
+        std::size_t get_outbound_queue_bytes() const {return m_flow ? m_flow->queued_bytes() : 0;}
+
+        void set_rate_limit(double rate, unsigned burst, rate_limit_action action) {m_limiter.set(rate, burst, action);}
+
+        void set_rate_limit(std::string const& name, double rate, unsigned burst, rate_limit_action action) {m_limiter.set(name, rate, burst, action);}
+
+        std::size_t get_rate_limited_count() const {return m_rate_limited;}
         
         std::string const& get_namespace() const {return m_nsp;}
+
+        bool recovered() const {return m_recovered;}
+
+        bool set_outbound_journal(std::string const& path, std::size_t capacity);
         
     protected:
         void on_connected();
@@ -152,39 +221,154 @@ namespace sio
         void on_socketio_event(const std::string& nsp, int msgId,const std::string& name, message::list&& message);
         void on_socketio_ack(int msgId, message::list const& message);
         void on_socketio_error(message::ptr const& err_message);
+
+        void on_connect_reply(message::ptr const& reply);
+
+        void track_offset(message::list const& message);
         
-        event_listener get_bind_listener_locked(string const& event);
+        void bind(const symbol* name,event_listener const& func);
+
+        void unbind(const symbol* name);
+
+        // Publishes bindings as the new snapshot, call with m_event_mutex held.
+        void publish_bindings(std::shared_ptr<const event_index> const& bindings);
         
         void ack(int msgId,string const& name,message::list const& ack_message);
         
-        void timeout_connection(const boost::system::error_code &ec);
+        void timeout_connection();
+
+        // Registers the ack, returns its packet id or -1 if ack was already
+        // failed. The trace, if any, is finished with the ack's failure.
+        int add_ack(ack_listener const& ack, unsigned timeout_millis, std::shared_ptr<emit_trace> const& trace);
+
+        void timeout_ack(unsigned int msgId);
+
+        // Resolves the ack of a packet that won't be sent with ack_rejected.
+        void reject_ack(int msgId);
+
+        // Takes the event's tokens, false if a limit refused it. due is when
+        // it may be sent.
+        bool pace(std::string const& name, int msgId, std::chrono::steady_clock::time_point& due);
+
+        void fail_acks(client_impl* client, ack_status status);
+
+        // Calls the listener of a resolved ack, on the executor if there is
+        // one. A failed ack finishes its trace.
+        void resolve_ack(client_impl* client, ack_table::entry& e, ack_status status, message::list const& reply);
+
+        // Wakes emitters waiting for room under the pending ack cap.
+        void ack_done();
+
+        void arm_connection_timer(unsigned delay, std::function<void()> const& handler);
+
+        void cancel_connection_timer(client_impl* client);
         
         void send_connect();
         
-        void send_packet(packet& p);
+        // name is the event's, for its rate limit.
+        void send_packet(packet& p, unsigned lane, std::string const& name = std::string(),
+                         std::shared_ptr<emit_trace> const& trace = std::shared_ptr<emit_trace>());
+
+        bool journal_packet(packet const& p);
+
+        void send_journal();
+
+        // Sends the journal and the memory queue, in that order.
+        void send_backlog();
         
         static event_listener s_null_event_listener;
         
-        static unsigned int s_global_event_id;
-        
         sio::client_impl *m_client;
         
         bool m_connected;
         std::string m_nsp;
+
+        // Connection state recovery: session id and offset of the last event
+        // received, sent along with the next CONNECT of the namespace.
+        std::string m_pid;
+        std::string m_offset;
+        bool m_recovered;
+
+        // Events received before the namespace is connected, replayed in order.
+        std::queue<packet> m_receive_queue;
         
-        std::map<unsigned int, std::function<void (message::list const&)> > m_acks;
+        // Packet ids are allocated by the table, per socket.
+        ack_table m_acks;
+
+        std::atomic<unsigned> m_max_acks;
+
+        // Emitters blocked by m_max_acks wait here, signalled when acks resolve.
+        std::mutex m_ack_mutex;
+
+        std::condition_variable m_ack_space;
+
+        std::atomic<unsigned> m_ack_waiters;
+
+        std::atomic<std::size_t> m_volatile_drops;
+
+        // The namespace's share of the client's outbound scheduler.
+        outbound_flow* m_flow;
+
+        rate_limiter m_limiter;
+
+        std::atomic<std::size_t> m_rate_limited;
+
+        // Slots of emit_conflated by name and key, kept for reuse.
+        std::unordered_map<std::string, std::shared_ptr<conflation_slot> > m_conflation_slots;
+
+        std::mutex m_conflation_mutex;
+
+        std::atomic<std::size_t> m_conflated_count;
+
+        std::atomic<std::size_t> m_inbound_conflated;
+
+        std::atomic<std::size_t> m_inbound_dropped;
         
-        std::map<std::string, event_listener> m_event_binding;
+        // Immutable snapshot of the bindings, replaced as a whole by on/off
+        // under m_event_mutex. Events are dispatched on the network thread
+        // only, so a replaced snapshot is released through the io_service:
+        // once that runs no dispatch can still be reading it.
+        std::shared_ptr<const event_index> m_event_binding;
+
+        std::atomic<const event_index*> m_event_binding_snapshot;
+
+        // Listeners matched by a dispatch, kept to reuse the allocation. Network thread only.
+        std::vector<const event_listener*> m_matched;
+
+        // Pattern walk of the dispatch, reused as m_matched. Done with
+        // before any listener runs, so a nested dispatch can use it too.
+        event_index::scratch m_match_scratch;
         
         error_listener m_error_listener;
         
-        std::unique_ptr<boost::asio::deadline_timer> m_connection_timer;
+        timer_wheel::timer_id m_connection_timer;
         
-        std::queue<packet> m_packet_queue;
+        struct queued_packet
+        {
+            packet p;
+            unsigned lane;
+            std::string name;
+            // Encoded already, for a conflated event.
+            outbound_packet conflated;
+            std::shared_ptr<emit_trace> trace;
+        };
+
+        // Call with m_packet_mutex held.
+        void drop_packet_queue(client_impl* client);
+
+        std::queue<queued_packet> m_packet_queue;
+
+        // Optional file backed queue for events emitted while disconnected,
+        // drained ahead of m_packet_queue. Guarded by m_packet_mutex.
+        journal m_journal;
         
         std::mutex m_event_mutex;
 
 		std::mutex m_packet_mutex;
+
+        // Set while the journal or m_packet_queue may hold packets, lets a
+        // connected send skip m_packet_mutex.
+        std::atomic<bool> m_backlog;
         
         friend class socket;
     };
@@ -196,24 +380,109 @@ namespace sio
     
     void socket::impl::on(std::string const& event_name,event_listener const& func)
     {
-        std::lock_guard<std::mutex> guard(m_event_mutex);
-        m_event_binding[event_name] = func;
+        NULL_GUARD(m_client);
+        this->bind(m_client->get_symbols().intern(event_name), func);
     }
     
     void socket::impl::off(std::string const& event_name)
+    {
+        NULL_GUARD(m_client);
+        const symbol* sym = m_client->get_symbols().find(event_name);
+        if(sym)
+        {
+            this->unbind(sym);
+        }
+    }
+
+    void socket::impl::on(sio::event_name const& name,event_listener const& func)
+    {
+        NULL_GUARD(m_client);
+        this->bind(m_client->get_symbols().intern(name), func);
+    }
+
+    void socket::impl::off(sio::event_name const& name)
+    {
+        NULL_GUARD(m_client);
+        const symbol* sym = m_client->get_symbols().find(name.hash(), name.data(), name.size());
+        if(sym)
+        {
+            this->unbind(sym);
+        }
+    }
+
+    void socket::impl::bind(const symbol* name,event_listener const& func)
     {
         std::lock_guard<std::mutex> guard(m_event_mutex);
-        auto it = m_event_binding.find(event_name);
-        if(it!=m_event_binding.end())
+        std::shared_ptr<event_index> bindings = std::make_shared<event_index>(*m_event_binding);
+        bindings->set(name, func);
+        this->publish_bindings(bindings);
+    }
+
+    void socket::impl::unbind(const symbol* name)
+    {
+        std::lock_guard<std::mutex> guard(m_event_mutex);
+        std::shared_ptr<event_index> bindings = std::make_shared<event_index>(*m_event_binding);
+        if(bindings->erase(name))
         {
-            m_event_binding.erase(it);
+            this->publish_bindings(bindings);
         }
     }
+
+    void socket::impl::on_pattern(std::string const& pattern,event_listener const& func)
+    {
+        std::lock_guard<std::mutex> guard(m_event_mutex);
+        std::shared_ptr<event_index> bindings = std::make_shared<event_index>(*m_event_binding);
+        bindings->set_pattern(pattern, func);
+        this->publish_bindings(bindings);
+    }
+
+    void socket::impl::off_pattern(std::string const& pattern)
+    {
+        std::lock_guard<std::mutex> guard(m_event_mutex);
+        std::shared_ptr<event_index> bindings = std::make_shared<event_index>(*m_event_binding);
+        if(bindings->erase_pattern(pattern))
+        {
+            this->publish_bindings(bindings);
+        }
+    }
+
+    void socket::impl::on_any(event_listener const& func)
+    {
+        std::lock_guard<std::mutex> guard(m_event_mutex);
+        std::shared_ptr<event_index> bindings = std::make_shared<event_index>(*m_event_binding);
+        bindings->set_any(func);
+        this->publish_bindings(bindings);
+    }
     
     void socket::impl::off_all()
     {
         std::lock_guard<std::mutex> guard(m_event_mutex);
-        m_event_binding.clear();
+        std::shared_ptr<event_index> bindings = std::make_shared<event_index>(*m_event_binding);
+        bindings->clear();
+        this->publish_bindings(bindings);
+    }
+
+    void socket::impl::set_inbound_policy(std::string const& name, std::shared_ptr<inbound_policy> const& policy)
+    {
+        NULL_GUARD(m_client);
+        const symbol* sym = m_client->get_symbols().intern(name);
+        std::lock_guard<std::mutex> guard(m_event_mutex);
+        std::shared_ptr<event_index> bindings = std::make_shared<event_index>(*m_event_binding);
+        bindings->set_policy(sym, policy);
+        this->publish_bindings(bindings);
+    }
+
+    void socket::impl::publish_bindings(std::shared_ptr<const event_index> const& bindings)
+    {
+        std::shared_ptr<const event_index> retired = m_event_binding;
+        m_event_binding = bindings;
+        m_event_binding_snapshot.store(bindings.get(), std::memory_order_release);
+        if(m_client && m_client->has_network_thread())
+        {
+            //a dispatch in progress may still read the old snapshot, without
+            //a network thread nothing dispatches and it goes right away.
+            m_client->get_io_service().post([retired]() {});
+        }
     }
     
     void socket::impl::on_error(error_listener const& l)
@@ -229,7 +498,20 @@ namespace sio
     socket::impl::impl(client_impl *client,std::string const& nsp):
         m_client(client),
         m_connected(false),
-        m_nsp(nsp)
+        m_nsp(nsp),
+        m_recovered(false),
+        m_max_acks(0),
+        m_ack_waiters(0),
+        m_volatile_drops(0),
+        m_flow(client ? client->get_flow(nsp) : NULL),
+        m_rate_limited(0),
+        m_conflated_count(0),
+        m_inbound_conflated(0),
+        m_inbound_dropped(0),
+        m_event_binding(std::make_shared<event_index>()),
+        m_event_binding_snapshot(m_event_binding.get()),
+        m_connection_timer(0),
+        m_backlog(false)
     {
         NULL_GUARD(client);
         if(m_client->opened())
@@ -240,43 +522,322 @@ namespace sio
     
     socket::impl::~impl()
     {
-        
+        this->cancel_connection_timer(m_client);
+        this->fail_acks(m_client, ack_disconnected);
     }
     
-    unsigned int socket::impl::s_global_event_id = 1;
-    
-    void socket::impl::emit(std::string const& name, message::list const& msglist, std::function<void (message::list const&)> const& ack)
+    void socket::impl::emit(std::string const& name, message::list const& msglist, std::function<void (message::list const&)> const& ack, priority p)
     {
-        NULL_GUARD(m_client);
-        message::ptr msg_ptr = msglist.to_array_message(name);
-        int pack_id;
+        ack_listener l;
         if(ack)
         {
-            pack_id = s_global_event_id++;
-            std::lock_guard<std::mutex> guard(m_event_mutex);
-            m_acks[pack_id] = ack;
+            l = [ack](ack_status status, message::list const& ack_message)
+            {
+                if(status == ack_ok) ack(ack_message);
+            };
         }
-        else
+        this->emit_with_ack(name, msglist, l, 0, p);
+    }
+
+    void socket::impl::emit_with_ack(std::string const& name, message::list const& msglist, ack_listener const& ack, unsigned timeout_millis, priority pri)
+    {
+        NULL_GUARD(m_client);
+        std::shared_ptr<emit_trace> trace = m_client->get_tracer().start(m_nsp, name);
+        int pack_id = -1;
+        if(ack)
         {
-            pack_id = -1;
+            pack_id = this->add_ack(ack, timeout_millis, trace);
+            if(pack_id < 0)
+            {
+                return;
+            }
+            if(trace)
+            {
+                trace->ack_id = pack_id;
+            }
         }
+        message::ptr msg_ptr = msglist.to_array_message(name);
         packet p(m_nsp, msg_ptr,pack_id);
-        send_packet(p);
+        send_packet(p, client_impl::lane_of(pri), name, trace);
+    }
+
+    bool socket::impl::emit_volatile(std::string const& name, message::list const& msglist)
+    {
+        //never queued, what is stale by the time the link drains is dropped instead.
+        if(!m_client || !m_connected || m_backlog.load(std::memory_order_acquire) || !m_client->can_send_volatile())
+        {
+            ++m_volatile_drops;
+            return false;
+        }
+        std::chrono::steady_clock::time_point due;
+        if(m_limiter.enabled() && m_limiter.acquire(name, std::chrono::steady_clock::now(), false, due) != rate_limiter::accepted)
+        {
+            //not delayed either, it would be stale.
+            ++m_volatile_drops;
+            return false;
+        }
+        packet p(m_nsp, msglist.to_array_message(name));
+        m_client->send(p, client_impl::lane_of(priority_normal), m_flow);
+        return true;
+    }
+
+    void socket::impl::emit_conflated(std::string const& name, std::string const& key, message::list const& msglist, priority pri)
+    {
+        NULL_GUARD(m_client);
+        packet p(m_nsp, msglist.to_array_message(name));
+        outbound_packet op;
+        m_client->encode(p, op);
+        std::shared_ptr<conflation_slot> slot;
+        {
+            std::lock_guard<std::mutex> guard(m_conflation_mutex);
+            std::shared_ptr<conflation_slot>& s = m_conflation_slots[name + '\0' + key];
+            if(!s)
+            {
+                s = std::make_shared<conflation_slot>();
+            }
+            slot = s;
+        }
+        if(slot->offer(op))
+        {
+            //replaced the value of the packet still queued.
+            ++m_conflated_count;
+            return;
+        }
+        op.lane = client_impl::lane_of(pri);
+        op.flow = m_flow;
+        op.slot = slot;
+        if(m_connected)
+        {
+            if(m_backlog.load(std::memory_order_acquire))
+            {
+                this->send_backlog();
+            }
+            if(!this->pace(name, -1, op.not_before))
+            {
+                slot->cancel();
+                return;
+            }
+            m_client->send(op);
+            return;
+        }
+        std::lock_guard<std::mutex> guard(m_packet_mutex);
+        queued_packet q;
+        q.p = p;
+        q.lane = op.lane;
+        q.name = name;
+        q.conflated = op;
+        m_packet_queue.push(std::move(q));
+        m_backlog.store(true, std::memory_order_release);
+    }
+
+    void socket::impl::drop_packet_queue(client_impl* client)
+    {
+        while (!m_packet_queue.empty()) {
+            if(m_packet_queue.front().conflated.slot)
+            {
+                m_packet_queue.front().conflated.slot->cancel();
+            }
+            if(m_packet_queue.front().trace)
+            {
+                client->trace_dropped(m_packet_queue.front().trace, ack_disconnected);
+            }
+            m_packet_queue.pop();
+        }
+    }
+
+    int socket::impl::add_ack(ack_listener const& ack, unsigned timeout_millis, std::shared_ptr<emit_trace> const& trace)
+    {
+        client_impl* client = m_client;
+        ack_status failed = ack_ok;
+        if(!m_acks.acquire(m_max_acks))
+        {
+            if(client->on_network_thread())
+            {
+                //acks resolve on this thread, waiting would never end.
+                failed = ack_rejected;
+            }
+            else
+            {
+                std::unique_lock<std::mutex> guard(m_ack_mutex);
+                ++m_ack_waiters;
+                auto acquired = [this]() { return m_acks.acquire(m_max_acks); };
+                if(timeout_millis > 0)
+                {
+                    if(!m_ack_space.wait_for(guard, std::chrono::milliseconds(timeout_millis), acquired))
+                    {
+                        failed = ack_timeout;
+                    }
+                }
+                else
+                {
+                    m_ack_space.wait(guard, acquired);
+                }
+                --m_ack_waiters;
+                if(failed == ack_ok && !m_client)
+                {
+                    m_acks.release();
+                    failed = ack_disconnected;
+                }
+            }
+        }
+        if(failed != ack_ok)
+        {
+            SIO_LOG_DEBUG("Ack not registered:"<<failed<<std::endl);
+            if(trace)
+            {
+                client->trace_dropped(trace, failed);
+            }
+            ack(failed, message::list());
+            return -1;
+        }
+        unsigned pack_id = m_acks.reserve();
+        ack_table::entry e;
+        e.listener = ack;
+        e.timer = 0;
+        e.trace = trace;
+        m_acks.publish(pack_id, e);
+        if(timeout_millis > 0)
+        {
+            //armed once published, so the timeout always finds the ack.
+            timer_wheel::timer_id timer = client->get_timer_wheel().arm(timeout_millis, std::bind(&socket::impl::timeout_ack, this, pack_id));
+            if(!m_acks.set_timer(pack_id, timer))
+            {
+                //resolved already.
+                client->get_timer_wheel().cancel(timer);
+            }
+        }
+        return (int)pack_id;
+    }
+
+    void socket::impl::reject_ack(int msgId)
+    {
+        ack_table::entry e;
+        if(msgId < 0 || !m_acks.take((unsigned)msgId, e))
+        {
+            return;
+        }
+        this->ack_done();
+        if(e.timer && m_client)
+        {
+            m_client->get_timer_wheel().cancel(e.timer);
+        }
+        this->resolve_ack(m_client, e, ack_rejected, message::list());
+    }
+
+    bool socket::impl::pace(std::string const& name, int msgId, std::chrono::steady_clock::time_point& due)
+    {
+        if(!m_limiter.enabled())
+        {
+            return true;
+        }
+        rate_limiter::result r = m_limiter.acquire(name, std::chrono::steady_clock::now(), true, due);
+        if(r == rate_limiter::accepted)
+        {
+            return true;
+        }
+        ++m_rate_limited;
+        SIO_LOG_DEBUG("Rate limited:"<<name<<std::endl);
+        this->reject_ack(msgId);
+        if(r == rate_limiter::rejected && m_error_listener)
+        {
+            m_error_listener(string_message::create("rate limit exceeded: " + name));
+        }
+        return false;
+    }
+
+    void socket::impl::ack_done()
+    {
+        if(m_ack_waiters > 0)
+        {
+            //pairs with the waiter checking for space under the mutex.
+            std::lock_guard<std::mutex> guard(m_ack_mutex);
+        }
+        m_ack_space.notify_all();
+    }
+
+    void socket::impl::timeout_ack(unsigned int msgId)
+    {
+        ack_table::entry e;
+        if(!m_acks.take(msgId, e))
+        {
+            return;
+        }
+        this->ack_done();
+        SIO_LOG_DEBUG("Ack timeout:"<<msgId<<std::endl);
+        this->resolve_ack(m_client, e, ack_timeout, message::list());
+    }
+
+    void socket::impl::fail_acks(client_impl* client, ack_status status)
+    {
+        std::vector<ack_table::entry> acks;
+        m_acks.take_all(acks);
+        this->ack_done();
+        for(auto it = acks.begin(); it != acks.end(); ++it)
+        {
+            if(client && it->timer)
+            {
+                client->get_timer_wheel().cancel(it->timer);
+            }
+            this->resolve_ack(client, *it, status, message::list());
+        }
+    }
+
+    void socket::impl::resolve_ack(client_impl* client, ack_table::entry& e, ack_status status, message::list const& reply)
+    {
+        if(e.trace && client && status != ack_ok)
+        {
+            client->trace_ack_failed(e.trace, status);
+        }
+        ack_listener& l = e.listener;
+        if(!l)
+        {
+            return;
+        }
+        if(client && client->has_executor())
+        {
+            ack_listener listener;
+            listener.swap(l);
+            client->dispatch(m_nsp, std::string(), [listener, status, reply]()
+            {
+                listener(status, reply);
+            });
+            return;
+        }
+        l(status, reply);
+    }
+
+    void socket::impl::set_max_pending_acks(unsigned max)
+    {
+        m_max_acks = max;
+        this->ack_done();
+    }
+
+    std::size_t socket::impl::get_pending_ack_count() const
+    {
+        return m_acks.size();
     }
     
     void socket::impl::send_connect()
     {
         NULL_GUARD(m_client);
-        if(m_nsp == "/")
+        message::ptr session;
+        if(m_client->recovery_enabled())
+        {
+            //servers supporting recovery expect an explicit CONNECT for the main namespace too.
+            if(!m_pid.empty())
+            {
+                session = object_message::create();
+                session->get_map()["pid"] = string_message::create(m_pid);
+                session->get_map()["offset"] = string_message::create(m_offset);
+            }
+        }
+        else if(m_nsp == "/")
         {
             return;
         }
-        packet p(packet::type_connect,m_nsp);
-        m_client->send(p);
-        m_connection_timer.reset(new boost::asio::deadline_timer(m_client->get_io_service()));
-        boost::system::error_code ec;
-        m_connection_timer->expires_from_now(boost::posix_time::milliseconds(20000), ec);
-        m_connection_timer->async_wait(std::bind(&socket::impl::timeout_connection,this, std::placeholders::_1));
+        packet p(packet::type_connect,m_nsp,session);
+        m_client->send(p, client_impl::lane_control, m_flow);
+        this->arm_connection_timer(20000, std::bind(&socket::impl::timeout_connection,this));
     }
     
     void socket::impl::close()
@@ -285,42 +846,28 @@ namespace sio
         if(m_connected)
         {
             packet p(packet::type_disconnect,m_nsp);
-            send_packet(p);
+            //behind the events emitted before closing.
+            send_packet(p, client_impl::lane_trailing);
             
-            if(!m_connection_timer)
-            {
-                m_connection_timer.reset(new boost::asio::deadline_timer(m_client->get_io_service()));
-            }
-            boost::system::error_code ec;
-            m_connection_timer->expires_from_now(boost::posix_time::milliseconds(3000), ec);
-            m_connection_timer->async_wait(lib::bind(&socket::impl::on_close, this));
+            this->arm_connection_timer(3000, lib::bind(&socket::impl::on_close, this));
         }
     }
     
     void socket::impl::on_connected()
     {
-        if(m_connection_timer)
-        {
-            m_connection_timer->cancel();
-            m_connection_timer.reset();
-        }
+        this->cancel_connection_timer(m_client);
         if(!m_connected)
         {
             m_connected = true;
             m_client->on_socket_opened(m_nsp);
 
-            while (true) {
-				m_packet_mutex.lock();
-				if(m_packet_queue.empty())
-				{
-					m_packet_mutex.unlock();
-					return;
-				}
-				sio::packet front_pack = std::move(m_packet_queue.front());
-                m_packet_queue.pop();
-				m_packet_mutex.unlock();
-				m_client->send(front_pack);
+            while (!m_receive_queue.empty()) {
+                packet front_pack = std::move(m_receive_queue.front());
+                m_receive_queue.pop();
+                this->on_message_packet(front_pack);
             }
+
+            this->send_backlog();
         }
     }
     
@@ -330,18 +877,17 @@ namespace sio
         sio::client_impl *client = m_client;
         m_client = NULL;
 
-        if(m_connection_timer)
-        {
-            m_connection_timer->cancel();
-            m_connection_timer.reset();
-        }
+        this->cancel_connection_timer(client);
+        this->fail_acks(client, ack_disconnected);
         m_connected = false;
 		{
 			std::lock_guard<std::mutex> guard(m_packet_mutex);
-			while (!m_packet_queue.empty()) {
-				m_packet_queue.pop();
-			}
+			this->drop_packet_queue(client);
 		}
+        //the session ends with the namespace.
+        m_pid.clear();
+        m_offset.clear();
+        m_receive_queue = std::queue<packet>();
         client->on_socket_closed(m_nsp);
         client->remove_socket(m_nsp);
     }
@@ -357,10 +903,15 @@ namespace sio
         if(m_connected)
         {
             m_connected = false;
-			std::lock_guard<std::mutex> guard(m_packet_mutex);
-            while (!m_packet_queue.empty()) {
-                m_packet_queue.pop();
+            //the server won't answer what it got before the drop.
+            this->fail_acks(m_client, ack_disconnected);
+            if(!m_pid.empty())
+            {
+                //keep the queue, it's sent once the session is resumed.
+                return;
             }
+			std::lock_guard<std::mutex> guard(m_packet_mutex);
+            this->drop_packet_queue(m_client);
         }
     }
     
@@ -374,21 +925,27 @@ namespace sio
             // Connect open
             case packet::type_connect:
             {
-                LOG("Received Message type (Connect)"<<std::endl);
+                SIO_LOG_DEBUG("Received Message type (Connect)"<<std::endl);
 
+                this->on_connect_reply(p.get_message());
                 this->on_connected();
                 break;
             }
             case packet::type_disconnect:
             {
-                LOG("Received Message type (Disconnect)"<<std::endl);
+                SIO_LOG_DEBUG("Received Message type (Disconnect)"<<std::endl);
                 this->on_close();
                 break;
             }
             case packet::type_event:
             case packet::type_binary_event:
             {
-                LOG("Received Message type (Event)"<<std::endl);
+                SIO_LOG_DEBUG("Received Message type (Event)"<<std::endl);
+                if(!m_connected && m_client->recovery_enabled())
+                {
+                    m_receive_queue.push(p);
+                    break;
+                }
                 const message::ptr ptr = p.get_message();
                 if(ptr->get_flag() == message::flag_array)
                 {
@@ -411,7 +968,7 @@ namespace sio
             case packet::type_ack:
             case packet::type_binary_ack:
             {
-                LOG("Received Message type (ACK)"<<std::endl);
+                SIO_LOG_DEBUG("Received Message type (ACK)"<<std::endl);
                 const message::ptr ptr = p.get_message();
                 if(ptr->get_flag() == message::flag_array)
                 {
@@ -427,7 +984,7 @@ namespace sio
                 // Error
             case packet::type_error:
             {
-                LOG("Received Message type (ERROR)"<<std::endl);
+                SIO_LOG_DEBUG("Received Message type (ERROR)"<<std::endl);
                 this->on_socketio_error(p.get_message());
                 break;
             }
@@ -437,12 +994,109 @@ namespace sio
         }
     }
     
+    void socket::impl::on_connect_reply(message::ptr const& reply)
+    {
+        std::string pid;
+        if(reply && reply->get_flag() == message::flag_object)
+        {
+            auto it = reply->get_map().find("pid");
+            if(it != reply->get_map().end() && it->second->get_flag() == message::flag_string)
+            {
+                pid = it->second->get_string();
+            }
+        }
+        m_recovered = !pid.empty() && pid == m_pid;
+        if(!m_recovered)
+        {
+            m_offset.clear();
+        }
+        m_pid = pid;
+        SIO_LOG_DEBUG("Namespace "<<m_nsp<<" connected, recovered:"<<m_recovered<<std::endl);
+    }
+
+    void socket::impl::track_offset(message::list const& message)
+    {
+        //with recovery the server appends the offset of each broadcast event as last argument.
+        if(!m_pid.empty() && message.size() > 0 && message[message.size()-1]->get_flag() == message::flag_string)
+        {
+            m_offset = message[message.size()-1]->get_string();
+        }
+    }
+
     void socket::impl::on_socketio_event(const std::string& nsp,int msgId,const std::string& name, message::list && message)
     {
+        this->track_offset(message);
         bool needAck = msgId >= 0;
-        event ev = event_adapter::create_event(nsp,name, std::move(message),needAck);
-        event_listener func = this->get_bind_listener_locked(name);
-        if(func)func(ev);
+        const event_index* bindings = m_event_binding_snapshot.load(std::memory_order_acquire);
+        //a listener may emit to this socket and dispatch again, that one gets its own vector.
+        std::vector<const event_listener*> matched;
+        matched.swap(m_matched);
+        matched.clear();
+        //after the snapshot, a name interned for a listener in it is visible here.
+        const symbol* sym = m_client->get_symbols().lookup_or_intern(name);
+        bindings->match(sym, name, matched, m_match_scratch);
+        if(m_client->has_executor())
+        {
+            if(matched.empty() && !needAck)
+            {
+                matched.swap(m_matched);
+                return;
+            }
+            //the snapshot may go once this returns, the task gets its own listeners.
+            std::vector<event_listener> funcs;
+            for(std::size_t i = 0; i < matched.size(); ++i)
+            {
+                funcs.push_back(*matched[i]);
+            }
+            matched.swap(m_matched);
+            std::shared_ptr<event> ev = std::make_shared<event>(sym ?
+                event_adapter::create_event(nsp, &sym->name, std::move(message), needAck) :
+                event_adapter::create_event(nsp, name, std::move(message), needAck));
+            std::shared_ptr<inbound_policy> policy;
+            std::shared_ptr<inbound_policy::slot> slot;
+            if(sym && !needAck)
+            {
+                policy = bindings->policy(sym);
+            }
+            if(policy)
+            {
+                inbound_policy::verdict verdict = policy->admit(policy->key(*ev), ev, slot);
+                if(verdict != inbound_policy::deliver)
+                {
+                    ++(verdict == inbound_policy::conflated ? m_inbound_conflated : m_inbound_dropped);
+                    return;
+                }
+                if(slot)
+                {
+                    //the slot hands over the newest event when the task starts.
+                    ev.reset();
+                }
+            }
+            m_client->dispatch(m_nsp, name, [this, funcs, ev, msgId, policy, slot]()
+            {
+                std::shared_ptr<event> current = slot ? slot->take() : ev;
+                for(std::size_t i = 0; i < funcs.size(); ++i)
+                {
+                    funcs[i](*current);
+                }
+                if(current->need_ack())
+                {
+                    this->ack(msgId, current->get_name(), current->get_ack_message());
+                }
+                if(policy)
+                {
+                    policy->done();
+                }
+            });
+            return;
+        }
+        event ev = sym ? event_adapter::create_event(nsp, &sym->name, std::move(message), needAck) :
+                         event_adapter::create_event(nsp, name, std::move(message), needAck);
+        for(std::size_t i = 0; i < matched.size(); ++i)
+        {
+            (*matched[i])(ev);
+        }
+        matched.swap(m_matched);
         if(needAck)
         {
             this->ack(msgId, name, ev.get_ack_message());
@@ -452,22 +1106,22 @@ namespace sio
     void socket::impl::ack(int msgId, const string &, const message::list &ack_message)
     {
         packet p(m_nsp, ack_message.to_array_message(),msgId,true);
-        send_packet(p);
+        send_packet(p, client_impl::lane_control);
     }
     
     void socket::impl::on_socketio_ack(int msgId, message::list const& message)
     {
-        std::function<void (message::list const&)> l;
+        ack_table::entry e;
+        if(msgId < 0 || !m_acks.take((unsigned)msgId, e))
         {
-            std::lock_guard<std::mutex> guard(m_event_mutex);
-            auto it = m_acks.find(msgId);
-            if(it!=m_acks.end())
-            {
-                l = it->second;
-                m_acks.erase(it);
-            }
+            return;
+        }
+        this->ack_done();
+        if(e.timer && m_client)
+        {
+            m_client->get_timer_wheel().cancel(e.timer);
         }
-        if(l)l(message);
+        this->resolve_ack(m_client, e, ack_ok, message);
     }
     
     void socket::impl::on_socketio_error(message::ptr const& err_message)
@@ -475,54 +1129,197 @@ namespace sio
         if(m_error_listener)m_error_listener(err_message);
     }
     
-    void socket::impl::timeout_connection(const boost::system::error_code &ec)
+    void socket::impl::timeout_connection()
     {
         NULL_GUARD(m_client);
-        if(ec)
-        {
-            return;
-        }
-        m_connection_timer.reset();
-        LOG("Connection timeout,close socket."<<std::endl);
+        m_connection_timer = 0;
+        SIO_LOG_DEBUG("Connection timeout,close socket."<<std::endl);
         //Should close socket if no connected message arrive.Otherwise we'll never ask for open again.
         this->on_close();
     }
     
-    void socket::impl::send_packet(sio::packet &p)
+    void socket::impl::arm_connection_timer(unsigned delay, std::function<void()> const& handler)
+    {
+        timer_wheel& wheel = m_client->get_timer_wheel();
+        wheel.cancel(m_connection_timer);
+        m_connection_timer = wheel.arm(delay, handler);
+    }
+
+    void socket::impl::cancel_connection_timer(client_impl* client)
+    {
+        if(client && m_connection_timer)
+        {
+            client->get_timer_wheel().cancel(m_connection_timer);
+        }
+        m_connection_timer = 0;
+    }
+
+    void socket::impl::send_packet(sio::packet &p, unsigned lane, std::string const& name, std::shared_ptr<emit_trace> const& trace)
     {
         NULL_GUARD(m_client);
         if(m_connected)
         {
-            while (true) {
-				m_packet_mutex.lock();
-				if(m_packet_queue.empty())
-				{
-					m_packet_mutex.unlock();
-					break;
-				}
-				sio::packet front_pack = std::move(m_packet_queue.front());
-                m_packet_queue.pop();
-				m_packet_mutex.unlock();
-				m_client->send(front_pack);
+            if(m_backlog.load(std::memory_order_acquire))
+            {
+                this->send_backlog();
             }
-            m_client->send(p);
+            std::chrono::steady_clock::time_point due;
+            if(lane != client_impl::lane_control && lane != client_impl::lane_trailing && !this->pace(name, p.get_pack_id(), due))
+            {
+                if(trace)
+                {
+                    m_client->trace_dropped(trace, ack_rejected);
+                }
+                return;
+            }
+            m_client->send(p, lane, m_flow, due, trace);
         }
         else
         {
 			std::lock_guard<std::mutex> guard(m_packet_mutex);
-            m_packet_queue.push(p);
+            //once something is queued in memory, keep the order by queuing behind it.
+            if(!m_packet_queue.empty() || lane != client_impl::lane_of(priority_normal) || !this->journal_packet(p))
+            {
+                //rate limits apply once it is sent, not to what piles up meanwhile.
+                queued_packet q;
+                q.p = p;
+                q.lane = lane;
+                q.name = name;
+                q.trace = trace;
+                m_packet_queue.push(std::move(q));
+            }
+            m_backlog.store(true, std::memory_order_release);
         }
     }
-    
-    socket::event_listener socket::impl::get_bind_listener_locked(const string &event)
+
+    void socket::impl::send_backlog()
     {
-        std::lock_guard<std::mutex> guard(m_event_mutex);
-        auto it = m_event_binding.find(event);
-        if(it!=m_event_binding.end())
+        this->send_journal();
+        while (true) {
+            m_packet_mutex.lock();
+            if(m_packet_queue.empty())
+            {
+                if(m_journal.empty())
+                {
+                    m_backlog.store(false, std::memory_order_release);
+                }
+                m_packet_mutex.unlock();
+                return;
+            }
+            queued_packet front = std::move(m_packet_queue.front());
+            m_packet_queue.pop();
+            m_packet_mutex.unlock();
+            std::chrono::steady_clock::time_point due;
+            if(front.lane != client_impl::lane_control && front.lane != client_impl::lane_trailing && !this->pace(front.name, front.p.get_pack_id(), due))
+            {
+                if(front.conflated.slot)
+                {
+                    front.conflated.slot->cancel();
+                }
+                if(front.trace)
+                {
+                    m_client->trace_dropped(front.trace, ack_rejected);
+                }
+                continue;
+            }
+            if(front.conflated.slot)
+            {
+                front.conflated.not_before = due;
+                m_client->send(front.conflated);
+                continue;
+            }
+            m_client->send(front.p, front.lane, m_flow, due, front.trace);
+        }
+    }
+
+    bool socket::impl::set_outbound_journal(std::string const& path, std::size_t capacity)
+    {
+        bool opened = false;
+        {
+            std::lock_guard<std::mutex> guard(m_packet_mutex);
+            if(path.empty())
+            {
+                m_journal.close();
+                return true;
+            }
+            opened = m_journal.open(path, capacity);
+            if(opened && !m_journal.empty())
+            {
+                m_backlog.store(true, std::memory_order_release);
+            }
+        }
+        if(opened && m_connected)
+        {
+            this->send_backlog();
+        }
+        return opened;
+    }
+
+    bool socket::impl::journal_packet(packet const& p)
+    {
+        if(!m_journal.is_open() || static_cast<int>(p.get_pack_id()) >= 0)
         {
-            return it->second;
+            //acks can't be matched after a restart, they stay in memory.
+            return false;
+        }
+        packet encoded(p);
+        std::shared_ptr<std::string> payload = std::make_shared<std::string>();
+        std::vector<std::shared_ptr<const std::string> > buffers;
+        encoded.accept(*payload, buffers);
+        if(encoded.get_type() != packet::type_event && encoded.get_type() != packet::type_binary_event)
+        {
+            return false;
+        }
+        journal::record r;
+        r.reserve(buffers.size() + 1);
+        journal::frame f;
+        f.binary = false;
+        f.payload = payload;
+        r.push_back(f);
+        for(auto it = buffers.begin(); it != buffers.end(); ++it)
+        {
+            f.binary = true;
+            f.payload = *it;
+            r.push_back(f);
+        }
+        return m_journal.append(r);
+    }
+
+    void socket::impl::send_journal()
+    {
+        journal::record r;
+        while (true) {
+            {
+                std::lock_guard<std::mutex> guard(m_packet_mutex);
+                if(!m_journal.front(r))
+                {
+                    return;
+                }
+                m_journal.pop();
+            }
+            //only normal priority events without ack are journaled, their
+            //names aren't, so only the socket's rate limit applies.
+            outbound_packet op;
+            op.lane = client_impl::lane_of(priority_normal);
+            op.flow = m_flow;
+            if(!this->pace(std::string(), -1, op.not_before))
+            {
+                continue;
+            }
+            for(auto it = r.begin(); it != r.end(); ++it)
+            {
+                if(it->binary)
+                {
+                    op.attachments.push_back(it->payload);
+                }
+                else
+                {
+                    op.payload = it->payload;
+                }
+            }
+            op.type = op.attachments.empty() ? packet::type_event : packet::type_binary_event;
+            m_client->send(op);
         }
-        return socket::event_listener();
     }
     
     socket::socket(client_impl* client,std::string const& nsp):
@@ -549,11 +1346,71 @@ namespace sio
     {
         m_impl->off(event_name);
     }
+
+    void socket::on(sio::event_name const& name,event_listener const& func)
+    {
+        m_impl->on(name, func);
+    }
+
+    void socket::on(sio::event_name const& name,event_listener_aux const& func)
+    {
+        m_impl->on(name, event_adapter::do_adapt(func));
+    }
+
+    void socket::off(sio::event_name const& name)
+    {
+        m_impl->off(name);
+    }
     
     void socket::off_all()
     {
         m_impl->off_all();
     }
+
+    void socket::set_inbound_conflation(std::string const& event_name, conflation_key const& key)
+    {
+        m_impl->set_inbound_policy(event_name, inbound_policy::conflate(key));
+    }
+
+    void socket::set_inbound_sampling(std::string const& event_name, unsigned every_nth)
+    {
+        m_impl->set_inbound_policy(event_name, inbound_policy::sample(every_nth));
+    }
+
+    void socket::clear_inbound_policy(std::string const& event_name)
+    {
+        m_impl->set_inbound_policy(event_name, std::shared_ptr<inbound_policy>());
+    }
+
+    std::size_t socket::get_inbound_conflated_count() const
+    {
+        return m_impl->get_inbound_conflated_count();
+    }
+
+    std::size_t socket::get_inbound_dropped_count() const
+    {
+        return m_impl->get_inbound_dropped_count();
+    }
+
+    void socket::on_pattern(std::string const& pattern,event_listener const& func)
+    {
+        m_impl->on_pattern(pattern, func);
+    }
+
+    void socket::off_pattern(std::string const& pattern)
+    {
+        m_impl->off_pattern(pattern);
+    }
+
+    void socket::on_any(event_listener const& func)
+    {
+        m_impl->on_any(func);
+    }
+
+    void socket::off_any()
+    {
+        m_impl->on_any(nullptr);
+    }
     
     void socket::close()
     {
@@ -570,15 +1427,99 @@ namespace sio
         m_impl->off_error();
     }
 
-    void socket::emit(std::string const& name, message::list const& msglist, std::function<void (message::list const&)> const& ack)
+    void socket::emit(std::string const& name, message::list const& msglist, std::function<void (message::list const&)> const& ack, priority p)
+    {
+        m_impl->emit(name, msglist,ack,p);
+    }
+
+    void socket::emit_with_ack(std::string const& name, message::list const& msglist, ack_listener const& ack, unsigned timeout_millis, priority p)
+    {
+        m_impl->emit_with_ack(name, msglist, ack, timeout_millis, p);
+    }
+
+    void socket::set_max_pending_acks(unsigned max)
+    {
+        m_impl->set_max_pending_acks(max);
+    }
+
+    std::size_t socket::get_pending_ack_count() const
+    {
+        return m_impl->get_pending_ack_count();
+    }
+
+    bool socket::emit_volatile(std::string const& name, message::list const& msglist)
+    {
+        return m_impl->emit_volatile(name, msglist);
+    }
+
+    std::size_t socket::get_volatile_drop_count() const
+    {
+        return m_impl->get_volatile_drop_count();
+    }
+
+    std::size_t socket::get_outbound_queue_length() const
+    {
+        return m_impl->get_outbound_queue_length();
+    }
+
+    std::size_t socket::get_outbound_queue_bytes() const
+    {
+        return m_impl->get_outbound_queue_bytes();
+    }
+
+    void socket::emit_conflated(std::string const& name, std::string const& key, message::list const& msglist, priority p)
     {
-        m_impl->emit(name, msglist,ack);
+        m_impl->emit_conflated(name, key, msglist, p);
+    }
+
+    std::size_t socket::get_conflated_count() const
+    {
+        return m_impl->get_conflated_count();
+    }
+
+    void socket::set_rate_limit(double events_per_second, unsigned burst, rate_limit_action action)
+    {
+        m_impl->set_rate_limit(events_per_second, burst, action);
+    }
+
+    void socket::set_rate_limit(std::string const& event_name, double events_per_second, unsigned burst, rate_limit_action action)
+    {
+        m_impl->set_rate_limit(event_name, events_per_second, burst, action);
+    }
+
+    std::size_t socket::get_rate_limited_count() const
+    {
+        return m_impl->get_rate_limited_count();
+    }
+
+    socket::metrics socket::get_metrics() const
+    {
+        metrics m;
+        m.pending_acks = m_impl->get_pending_ack_count();
+        m.outbound_queue_length = m_impl->get_outbound_queue_length();
+        m.outbound_queue_bytes = m_impl->get_outbound_queue_bytes();
+        m.volatile_dropped = m_impl->get_volatile_drop_count();
+        m.conflated = m_impl->get_conflated_count();
+        m.rate_limited = m_impl->get_rate_limited_count();
+        m.inbound_conflated = m_impl->get_inbound_conflated_count();
+        m.inbound_dropped = m_impl->get_inbound_dropped_count();
+        return m;
     }
     
     std::string const& socket::get_namespace() const
     {
         return m_impl->get_namespace();
     }
+
+    bool socket::recovered() const
+    {
+        return m_impl->recovered();
+    }
+
+    bool socket::set_outbound_journal(std::string const& path, std::size_t capacity)
+    {
+        return m_impl->set_outbound_journal(path, capacity);
+    }
     
     void socket::on_connected()
     {
@@ -1,10 +1,53 @@
 #ifndef SIO_SOCKET_H
 #define SIO_SOCKET_H
 #include "sio_message.h"
+#include <cstdint>
 #include <functional>
 namespace sio
 {
     class event_adapter;
+
+    // Event name with its hash computed at compile time, write "name"_ev.
+    // hash recurses once per character and compilers cap constexpr
+    // recursion (512 deep by default for GCC and Clang), so longer
+    // literals don't compile; use the std::string overloads for those.
+    class event_name
+    {
+    public:
+        constexpr event_name(const char* str, std::size_t length):
+            m_str(str),
+            m_length(length),
+            m_hash(hash(str, length))
+        {
+        }
+
+        // 64 bit FNV-1a, also used for names arriving at run time.
+        static constexpr std::uint64_t hash(const char* str, std::size_t length, std::uint64_t h = 14695981039346656037ULL)
+        {
+            return length == 0 ? h : hash(str + 1, length - 1, (h ^ (unsigned char)str[0]) * 1099511628211ULL);
+        }
+
+        constexpr const char* data() const { return m_str; }
+
+        constexpr std::size_t size() const { return m_length; }
+
+        constexpr std::uint64_t hash() const { return m_hash; }
+
+        std::string str() const { return std::string(m_str, m_length); }
+
+    private:
+        const char* m_str;
+        std::size_t m_length;
+        std::uint64_t m_hash;
+    };
+
+    inline namespace literals
+    {
+        constexpr event_name operator"" _ev(const char* str, std::size_t length)
+        {
+            return event_name(str, length);
+        }
+    }
     
     class event
     {
@@ -23,15 +66,23 @@ namespace sio
         
         message::list const& get_ack_message() const;
         
+        event(event const& other);
+
     protected:
         event(std::string const& nsp,std::string const& name,message::list const& messages,bool need_ack);
         event(std::string const& nsp,std::string const& name,message::list&& messages,bool need_ack);
+        // name is interned by the client and outlives the event's dispatch.
+        event(std::string const& nsp,std::string const* name,message::list&& messages,bool need_ack);
 
         message::list& get_ack_message_impl();
         
     private:
+        void operator=(event const&);
+
         const std::string m_nsp;
-        const std::string m_name;
+        // Points to m_name_storage or to an interned name.
+        const std::string m_name_storage;
+        const std::string* const m_name;
         const message::list m_messages;
         const bool m_need_ack;
         message::list m_ack_message;
@@ -53,16 +104,87 @@ namespace sio
         typedef std::function<void(message::ptr const& message)> error_listener;
         
         typedef std::shared_ptr<socket> ptr;
+
+        // Key of an inbound event for conflation, e.g. the instrument of a quote.
+        typedef std::function<std::string(event const& ev)> conflation_key;
+
+        enum ack_status
+        {
+            ack_ok,
+            ack_timeout,        // no ack within the timeout
+            ack_disconnected,   // the connection dropped or the socket closed first
+            ack_rejected        // too many pending acks, the event wasn't sent
+        };
+
+        typedef std::function<void(ack_status status, message::list const& ack_message)> ack_listener;
+
+        // Outbound lane of an emit. A higher lane is sent ahead of packets
+        // waiting in lower ones, order is kept within a lane. Acks and
+        // namespace connect go ahead of all of them, close() sends the
+        // disconnect behind what the socket emitted before.
+        enum priority
+        {
+            priority_high,
+            priority_normal,
+            priority_low
+        };
+
+        // What an emit over its rate limit does.
+        enum rate_limit_action
+        {
+            rate_limit_delay,   // queued, sent once the bucket has a token again
+            rate_limit_drop,    // discarded
+            rate_limit_reject   // discarded and reported to the error listener
+        };
         
         ~socket();
         
+        // Names are interned by the client, so once the socket closed on and
+        // off by name do nothing. A closed socket gets no more events, bind
+        // on the one client::socket() returns next.
         void on(std::string const& event_name,event_listener const& func);
         
         void on(std::string const& event_name,event_listener_aux const& func);
+
+        void on(sio::event_name const& name,event_listener const& func);
+
+        void on(sio::event_name const& name,event_listener_aux const& func);
         
         void off(std::string const& event_name);
+
+        void off(sio::event_name const& name);
         
         void off_all();
+
+        // Glob pattern listener, '*' matches any run of characters and '?' one,
+        // e.g. "market.*". Runs after the listener bound to the exact name.
+        void on_pattern(std::string const& pattern,event_listener const& func);
+
+        void off_pattern(std::string const& pattern);
+
+        // Catch-all listener, runs for every event before the others.
+        void on_any(event_listener const& func);
+
+        void off_any();
+
+        // Inbound policies, before the listeners of the event name are run on
+        // the client's event executor. Conflation keeps one event per key
+        // waiting for the executor, a newer one replaces it; key nullptr
+        // conflates all events of the name. Sampling delivers one in
+        // every_nth events while the listeners are busy with an earlier one.
+        // Without an executor events aren't queued and both have no effect.
+        // Events asking for an ack are always delivered.
+        void set_inbound_conflation(std::string const& event_name, conflation_key const& key = nullptr);
+
+        void set_inbound_sampling(std::string const& event_name, unsigned every_nth);
+
+        void clear_inbound_policy(std::string const& event_name);
+
+        // Inbound events replaced by a newer one before their listeners ran.
+        std::size_t get_inbound_conflated_count() const;
+
+        // Inbound events dropped by sampling.
+        std::size_t get_inbound_dropped_count() const;
         
         void close();
         
@@ -70,9 +192,78 @@ namespace sio
         
         void off_error();
 
-        void emit(std::string const& name, message::list const& msglist = nullptr, std::function<void (message::list const&)> const& ack = nullptr);
+        void emit(std::string const& name, message::list const& msglist = nullptr, std::function<void (message::list const&)> const& ack = nullptr, priority p = priority_normal);
+
+        // Emit expecting an ack, ack is always called exactly once. With a
+        // timeout_millis of 0 it only fails on disconnect.
+        void emit_with_ack(std::string const& name, message::list const& msglist, ack_listener const& ack, unsigned timeout_millis = 0, priority p = priority_normal);
+
+        // Caps the acks waiting for the server, 0 (default) for no cap. When the
+        // cap is reached emit_with_ack blocks until one resolves, or rejects the
+        // event when called from the network thread.
+        void set_max_pending_acks(unsigned max);
+
+        std::size_t get_pending_ack_count() const;
+
+        // Emit only if the socket is connected and the client's outbound
+        // buffer is below client::set_volatile_buffer_limit, otherwise drop
+        // the event. Never queued, for values that are useless once stale.
+        // Returns whether the event was sent.
+        bool emit_volatile(std::string const& name, message::list const& msglist = nullptr);
+
+        // Events emit_volatile dropped so far.
+        std::size_t get_volatile_drop_count() const;
+
+        // Latest value wins: while an event emitted with the same name and
+        // key hasn't been sent yet, this replaces its content and it keeps
+        // its place in the queue. E.g. key is the instrument of a quote.
+        void emit_conflated(std::string const& name, std::string const& key, message::list const& msglist, priority p = priority_normal);
+
+        // Values emit_conflated replaced before they were sent.
+        std::size_t get_conflated_count() const;
+
+        // Packets of this namespace waiting for the connection, not counting
+        // those queued while the socket is disconnected.
+        std::size_t get_outbound_queue_length() const;
+
+        std::size_t get_outbound_queue_bytes() const;
+
+        // Token bucket on the events this socket emits, refilled at
+        // events_per_second up to burst tokens. A rate of 0 removes it.
+        // Acks and namespace connect/disconnect aren't limited.
+        void set_rate_limit(double events_per_second, unsigned burst, rate_limit_action action = rate_limit_delay);
+
+        // Another bucket for one event name, taken from along with the socket's.
+        void set_rate_limit(std::string const& event_name, double events_per_second, unsigned burst, rate_limit_action action = rate_limit_delay);
+
+        // Events dropped or rejected by the rate limits so far.
+        std::size_t get_rate_limited_count() const;
+
+        // The counters above read at once, each read on its own.
+        struct metrics
+        {
+            std::size_t pending_acks;
+            std::size_t outbound_queue_length;
+            std::size_t outbound_queue_bytes;
+            std::size_t volatile_dropped;
+            std::size_t conflated;
+            std::size_t rate_limited;
+            std::size_t inbound_conflated;
+            std::size_t inbound_dropped;
+        };
+
+        metrics get_metrics() const;
         
         std::string const& get_namespace() const;
+
+        // Whether the last namespace connect resumed the previous session.
+        bool recovered() const;
+
+        // Keep events emitted while disconnected in a file of at most capacity
+        // bytes, sent in order once connected, also after a process restart.
+        // An empty path turns the journal off. Returns false if the file can't be
+        // mapped or holds something other than a journal, which is left as is.
+        bool set_outbound_journal(std::string const& path, std::size_t capacity);
         
     protected:
         socket(client_impl*,std::string const&);
@@ -6,9 +6,33 @@
 
 #include <sio_client.h>
 #include <internal/sio_packet.h>
+#include <internal/sio_polling.h>
+#include <internal/sio_backoff.h>
+#include <internal/sio_journal.h>
+#include <internal/sio_resolver.h>
+#include <internal/sio_timer_wheel.h>
+#include <internal/sio_ack_table.h>
+#include <internal/sio_worker_pool.h>
+#include <internal/sio_mpsc_ring.h>
+#include <internal/sio_event_index.h>
+#include <internal/sio_symbol_table.h>
+#include <internal/sio_outbound_scheduler.h>
+#include <internal/sio_rate_limiter.h>
+#include <internal/sio_inbound_policy.h>
+#include <internal/sio_metrics.h>
+#include <internal/sio_tracer.h>
+#include <internal/sio_log.h>
 #include <functional>
 #include <iostream>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <sstream>
+#include <fstream>
+#include <cmath>
+#include <cstdio>
+#include <atomic>
+#include <algorithm>
 
 #define BOOST_TEST_MODULE sio_test
 
@@ -225,5 +249,2346 @@ BOOST_AUTO_TEST_CASE( test_packet_parse_4 )
 
 }
 
+BOOST_AUTO_TEST_CASE( test_packet_recovery_connect )
+{
+    message::ptr session = object_message::create();
+    session->get_map()["pid"] = string_message::create("p1");
+    session->get_map()["offset"] = string_message::create("o9");
+    packet p(packet::type_connect,"/",session);
+    std::string payload;
+    std::vector<std::shared_ptr<const std::string> > buffers;
+    p.accept(payload,buffers);
+    BOOST_CHECK(buffers.size() == 0);
+    BOOST_CHECK_MESSAGE(payload == "40{\"offset\":\"o9\",\"pid\":\"p1\"}",std::string("outputing payload:")+payload);
+
+    packet reply;
+    reply.parse("40/nsp,{\"sid\":\"s1\",\"pid\":\"p1\"}");
+    BOOST_CHECK(reply.get_type() == packet::type_connect);
+    BOOST_CHECK(reply.get_nsp() == "/nsp");
+    BOOST_REQUIRE(reply.get_message() && reply.get_message()->get_flag() == message::flag_object);
+    BOOST_CHECK(reply.get_message()->get_map()["pid"]->get_string() == "p1");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_polling)
+
+BOOST_AUTO_TEST_CASE( test_polling_encode_payload )
+{
+    std::deque<std::shared_ptr<const std::string> > queue;
+    queue.push_back(std::make_shared<std::string>("42[\"a\"]"));
+    queue.push_back(std::make_shared<std::string>("42[\"b\"]"));
+    std::string bin(1,(char)packet::frame_message);
+    bin.append("\x01\x02\x03\xff");
+    queue.push_back(std::make_shared<std::string>(bin));
+    std::string payload;
+    sio::polling_transport::encode_payload(queue,0,payload);
+    BOOST_CHECK(queue.empty());
+    BOOST_CHECK_MESSAGE(payload == "42[\"a\"]\x1e" "42[\"b\"]\x1e" "bAQID/w==",std::string("outputing payload:")+payload);
+
+    queue.push_back(std::make_shared<std::string>("42[\"a\"]"));
+    queue.push_back(std::make_shared<std::string>("42[\"b\"]"));
+    queue.push_back(std::make_shared<std::string>("42[\"c\"]"));
+    sio::polling_transport::encode_payload(queue,16,payload);
+    BOOST_CHECK(queue.size() == 1);
+    BOOST_CHECK_MESSAGE(payload == "42[\"a\"]\x1e" "42[\"b\"]",std::string("outputing payload:")+payload);
+    //a packet larger than max payload is still sent alone.
+    sio::polling_transport::encode_payload(queue,2,payload);
+    BOOST_CHECK(queue.empty());
+    BOOST_CHECK(payload == "42[\"c\"]");
+}
+
+BOOST_AUTO_TEST_CASE( test_polling_decode_payload )
+{
+    std::vector<std::string> packets;
+    sio::polling_transport::decode_payload("0{\"sid\":\"abc\"}\x1e" "40\x1e" "bAQID/w==\x1e" "6",packets);
+    BOOST_REQUIRE(packets.size() == 4);
+    BOOST_CHECK(packets[0] == "0{\"sid\":\"abc\"}");
+    BOOST_CHECK(packets[1] == "40");
+    BOOST_CHECK(packet::is_binary_message(packets[2]));
+    BOOST_CHECK(packets[2] == std::string("\x04\x01\x02\x03\xff"));
+    BOOST_CHECK(packets[3] == "6");
+}
+
+// Stand-in for an engine.io server: answers the handshake and echoes the
+// payload of every POST in the response of the next poll.
+class polling_stand_in
+{
+public:
+    polling_stand_in():
+        m_acceptor(m_io,boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(),0))
+    {
+        m_thread = std::thread([this]()
+        {
+            for(int i = 0;i<2;++i)
+            {
+                std::shared_ptr<boost::asio::ip::tcp::socket> s = std::make_shared<boost::asio::ip::tcp::socket>(m_io);
+                m_acceptor.accept(*s);
+                m_workers.push_back(std::thread([this,s](){ this->serve(*s); }));
+            }
+        });
+    }
+
+    ~polling_stand_in()
+    {
+        m_thread.join();
+        for(auto& t : m_workers) t.join();
+    }
+
+    unsigned short port() const { return m_acceptor.local_endpoint().port(); }
+
+    size_t post_count()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_posts;
+    }
+
+private:
+    void serve(boost::asio::ip::tcp::socket& s)
+    {
+        boost::asio::streambuf buf;
+        boost::system::error_code ec;
+        while(true)
+        {
+            size_t n = boost::asio::read_until(s,buf,"\r\n\r\n",ec);
+            if(ec) return;
+            std::string head(boost::asio::buffers_begin(buf.data()),boost::asio::buffers_begin(buf.data())+n);
+            buf.consume(n);
+            std::string body;
+            size_t cl = head.find("Content-Length: ");
+            if(cl != std::string::npos)
+            {
+                size_t len = std::stoul(head.substr(cl+16));
+                if(buf.size()<len) boost::asio::read(s,buf,boost::asio::transfer_exactly(len-buf.size()));
+                body.assign(boost::asio::buffers_begin(buf.data()),boost::asio::buffers_begin(buf.data())+len);
+                buf.consume(len);
+            }
+            std::string reply;
+            if(head.compare(0,4,"POST") == 0)
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                ++m_posts;
+                m_pending.append(m_pending.empty() ? "" : "\x1e").append(body);
+                m_cond.notify_all();
+                reply = "ok";
+            }
+            else if(head.find("&sid=") == std::string::npos)
+            {
+                reply = "0{\"sid\":\"stand-in\",\"upgrades\":[],\"pingInterval\":25000,\"pingTimeout\":20000,\"maxPayload\":20}";
+            }
+            else
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.wait(lock,[this](){ return !m_pending.empty(); });
+                reply.swap(m_pending);
+            }
+            std::ostringstream ss;
+            ss<<"HTTP/1.1 200 OK\r\nContent-Length: "<<reply.size()<<"\r\n\r\n"<<reply;
+            boost::asio::write(s,boost::asio::buffer(ss.str()),ec);
+            if(ec) return;
+        }
+    }
+
+    boost::asio::io_service m_io;
+    boost::asio::ip::tcp::acceptor m_acceptor;
+    std::thread m_thread;
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::string m_pending;
+    size_t m_posts = 0;
+};
+
+BOOST_AUTO_TEST_CASE( test_polling_stand_in_server )
+{
+    polling_stand_in server;
+    std::vector<std::string> received;
+    boost::asio::io_service io;
+    std::shared_ptr<sio::polling_transport> t = std::make_shared<sio::polling_transport>(io);
+    t->set_packet_handler([&](std::string const& p)
+    {
+        received.push_back(p);
+        if(p[0] == '0')
+        {
+            t->start("stand-in",20);
+            t->send(std::make_shared<std::string>("42[\"a\",1]"));
+            t->send(std::make_shared<std::string>("42[\"b\",2]"));
+        }
+        else if(received.size() == 3)
+        {
+            t->close();
+        }
+    });
+    t->open("127.0.0.1",std::to_string(server.port()),"/socket.io/?EIO=4&transport=polling",std::map<std::string,std::string>());
+    io.run();
+    BOOST_REQUIRE(received.size() == 3);
+    BOOST_CHECK(received[1] == "42[\"a\",1]");
+    BOOST_CHECK(received[2] == "42[\"b\",2]");
+    //both packets don't fit into the max payload of 20 bytes.
+    BOOST_CHECK(server.post_count() == 2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
+// Stand-in for a Socket.IO server on the polling transport. Records the
+// packets the client sends, hands each to the script and sends what is
+// pushed in the response of the client's next poll. Namespace CONNECTs
+// are answered unless the script handles them.
+class sio_stand_in
+{
+public:
+    // Returns true if it handled the packet.
+    typedef std::function<bool(std::string const& packet)> script;
+
+    sio_stand_in(unsigned ping_interval = 25000, unsigned ping_timeout = 20000):
+        m_acceptor(m_io,boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(),0)),
+        m_ping_interval(ping_interval),
+        m_ping_timeout(ping_timeout),
+        m_connect_root(true),
+        m_sessions(0),
+        m_stopped(false)
+    {
+        m_thread = std::thread([this]()
+        {
+            while(true)
+            {
+                std::shared_ptr<boost::asio::ip::tcp::socket> s = std::make_shared<boost::asio::ip::tcp::socket>(m_io);
+                boost::system::error_code ec;
+                m_acceptor.accept(*s,ec);
+                std::lock_guard<std::mutex> guard(m_mutex);
+                if(ec || m_stopped) return;
+                m_sockets.push_back(s);
+                m_workers.push_back(std::thread([this,s](){ this->serve(*s); }));
+            }
+        });
+    }
+
+    ~sio_stand_in()
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_stopped = true;
+            m_cond.notify_all();
+            for(auto& s : m_sockets)
+            {
+                boost::system::error_code ec;
+                s->shutdown(boost::asio::ip::tcp::socket::shutdown_both,ec);
+            }
+        }
+        //wakes the accepting thread.
+        boost::asio::ip::tcp::socket waker(m_io);
+        boost::system::error_code ec;
+        waker.connect(m_acceptor.local_endpoint(),ec);
+        m_thread.join();
+        for(auto& t : m_workers) t.join();
+    }
+
+    std::string uri() const { return "http://127.0.0.1:" + std::to_string(m_acceptor.local_endpoint().port()); }
+
+    // Before the client connects.
+    void set_script(script const& s) { m_script = s; }
+
+    // Whether the handshake is followed by the CONNECT of the main
+    // namespace, for clients that don't send one (no connection state recovery).
+    void set_connect_root(bool connect) { m_connect_root = connect; }
+
+    // Sent as the Content-Length of every response instead of its size.
+    void set_content_length(std::string const& value) { m_content_length = value; }
+
+    // Sent to the client of the last handshake.
+    void push(std::string const& packet)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        std::string& pending = m_pending[m_sid];
+        pending.append(pending.empty() ? "" : "\x1e").append(packet);
+        m_cond.notify_all();
+    }
+
+    std::vector<std::string> received()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_received;
+    }
+
+    unsigned sessions()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_sessions;
+    }
+
+    // Waits until the packets received so far satisfy pred.
+    bool wait_for(std::function<bool(std::vector<std::string> const&)> const& pred, unsigned millis = 5000)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_cond.wait_for(lock,std::chrono::milliseconds(millis),[&](){ return pred(m_received); });
+    }
+
+    bool wait_for_packet(std::string const& packet, unsigned millis = 5000)
+    {
+        return this->wait_for([&](std::vector<std::string> const& r){ return std::find(r.begin(),r.end(),packet) != r.end(); },millis);
+    }
+
+private:
+    void serve(boost::asio::ip::tcp::socket& s)
+    {
+        boost::asio::streambuf buf;
+        boost::system::error_code ec;
+        while(true)
+        {
+            size_t n = boost::asio::read_until(s,buf,"\r\n\r\n",ec);
+            if(ec) return;
+            std::string head(boost::asio::buffers_begin(buf.data()),boost::asio::buffers_begin(buf.data())+n);
+            buf.consume(n);
+            std::string body;
+            size_t cl = head.find("Content-Length: ");
+            if(cl != std::string::npos)
+            {
+                size_t len = std::stoul(head.substr(cl+16));
+                if(buf.size()<len) boost::asio::read(s,buf,boost::asio::transfer_exactly(len-buf.size()),ec);
+                if(ec) return;
+                body.assign(boost::asio::buffers_begin(buf.data()),boost::asio::buffers_begin(buf.data())+len);
+                buf.consume(len);
+            }
+            std::string reply;
+            size_t sid_pos = head.find("&sid=");
+            if(head.compare(0,4,"POST") == 0)
+            {
+                std::vector<std::string> packets;
+                sio::polling_transport::decode_payload(body,packets);
+                for(auto it = packets.begin(); it != packets.end(); ++it)
+                {
+                    this->on_packet(*it);
+                }
+                reply = "ok";
+            }
+            else if(sid_pos == std::string::npos)
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_sid = "s" + std::to_string(++m_sessions);
+                reply = "0{\"sid\":\"" + m_sid + "\",\"upgrades\":[],\"pingInterval\":" + std::to_string(m_ping_interval) +
+                        ",\"pingTimeout\":" + std::to_string(m_ping_timeout) + ",\"maxPayload\":1000000}";
+                if(m_connect_root)
+                {
+                    m_pending[m_sid] = "40{\"sid\":\"root\"}";
+                }
+            }
+            else
+            {
+                std::string sid = head.substr(sid_pos+5,head.find_first_of("& ",sid_pos+5)-sid_pos-5);
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.wait(lock,[&](){ return m_stopped || !m_pending[sid].empty(); });
+                if(m_stopped) return;
+                reply.swap(m_pending[sid]);
+            }
+            std::ostringstream ss;
+            ss<<"HTTP/1.1 200 OK\r\nContent-Length: "<<(m_content_length.empty() ? std::to_string(reply.size()) : m_content_length)<<"\r\n\r\n"<<reply;
+            boost::asio::write(s,boost::asio::buffer(ss.str()),ec);
+            if(ec) return;
+        }
+    }
+
+    void on_packet(std::string const& packet)
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_received.push_back(packet);
+            m_cond.notify_all();
+        }
+        if(m_script && m_script(packet))
+        {
+            return;
+        }
+        if(packet.compare(0,2,"40") == 0)
+        {
+            //"40", "40/nsp" or "40/nsp," with an optional payload.
+            std::string nsp = packet.size() > 2 && packet[2] == '/' ? packet.substr(2,packet.find(',')-2) : std::string();
+            this->push("40" + (nsp.empty() ? std::string() : nsp + ",") + "{\"sid\":\"" + (nsp.empty() ? "root" : nsp) + "\"}");
+        }
+    }
+
+    boost::asio::io_service m_io;
+    boost::asio::ip::tcp::acceptor m_acceptor;
+    unsigned m_ping_interval;
+    unsigned m_ping_timeout;
+    bool m_connect_root;
+    std::string m_content_length;
+    script m_script;
+    std::thread m_thread;
+    std::vector<std::thread> m_workers;
+    std::vector<std::shared_ptr<boost::asio::ip::tcp::socket> > m_sockets;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::string m_sid;
+    std::map<std::string, std::string> m_pending;
+    std::vector<std::string> m_received;
+    unsigned m_sessions;
+    bool m_stopped;
+};
+
+// Waits for a condition set from the network thread.
+class latch
+{
+public:
+    latch(): m_set(false) {}
+
+    void set()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_set = true;
+        m_cond.notify_all();
+    }
+
+    bool wait(unsigned millis = 5000)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_cond.wait_for(lock,std::chrono::milliseconds(millis),[this](){ return m_set; });
+    }
+
+    void reset()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_set = false;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_set;
+};
+
+BOOST_AUTO_TEST_SUITE(test_polling)
+
+BOOST_AUTO_TEST_CASE( test_polling_bad_content_length )
+{
+    //malformed, out of range or larger than the max payload allows.
+    const char* values[] = { "x", "-1", "99999999999999999999999", "100000000" };
+    for(const char* value : values)
+    {
+        sio_stand_in server;
+        server.set_content_length(value);
+        client c;
+        latch failed;
+        c.set_transport(client::transport_polling);
+        c.set_reconnect_attempts(0);
+        c.set_fail_listener([&](){ failed.set(); });
+        c.connect(server.uri());
+        BOOST_CHECK_MESSAGE(failed.wait(), value);
+        c.sync_close();
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_heartbeat)
+
+BOOST_AUTO_TEST_CASE( test_heartbeat_pong )
+{
+    sio_stand_in server;
+    client c;
+    latch connected;
+    c.set_transport(client::transport_polling);
+    c.set_socket_open_listener([&](std::string const&){ connected.set(); });
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    server.push("2");
+    BOOST_CHECK(server.wait_for_packet("3"));
+    server.push("2");
+    BOOST_CHECK(server.wait_for([](std::vector<std::string> const& r){ return std::count(r.begin(),r.end(),"3") == 2; }));
+    c.sync_close();
+}
+
+BOOST_AUTO_TEST_CASE( test_heartbeat_timeout )
+{
+    //no ping within pingInterval + pingTimeout, the connection is considered dropped.
+    sio_stand_in server(100,100);
+    client c;
+    latch connected;
+    latch closed;
+    client::close_reason reason = client::close_reason_normal;
+    c.set_transport(client::transport_polling);
+    c.set_reconnect_attempts(0);
+    c.set_socket_open_listener([&](std::string const&){ connected.set(); });
+    c.set_close_listener([&](client::close_reason const& r){ reason = r; closed.set(); });
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    BOOST_REQUIRE(closed.wait());
+    BOOST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(200));
+    BOOST_CHECK(reason == client::close_reason_drop);
+    BOOST_CHECK(!c.opened());
+    c.sync_close();
+}
+
+BOOST_AUTO_TEST_CASE( test_heartbeat_ping_keeps_alive )
+{
+    sio_stand_in server(100,100);
+    client c;
+    latch connected;
+    latch closed;
+    c.set_transport(client::transport_polling);
+    c.set_reconnect_attempts(0);
+    c.set_socket_open_listener([&](std::string const&){ connected.set(); });
+    c.set_close_listener([&](client::close_reason const&){ closed.set(); });
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    for(int i = 0;i<6;++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        server.push("2");
+    }
+    BOOST_CHECK(!closed.wait(0));
+    BOOST_CHECK(c.opened());
+    c.sync_close();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_recovery)
+
+BOOST_AUTO_TEST_CASE( test_recovery_session )
+{
+    sio_stand_in server;
+    server.set_connect_root(false);
+    std::mutex mutex;
+    std::vector<std::string> replies;
+    replies.push_back("42[\"tick\",1,\"o1\"]\x1e" "42[\"tick\",2,\"o2\"]\x1e" "40{\"sid\":\"a\",\"pid\":\"p1\"}");
+    replies.push_back("40{\"sid\":\"b\",\"pid\":\"p1\"}\x1e" "42[\"tick\",3,\"o3\"]");
+    replies.push_back("40{\"sid\":\"c\",\"pid\":\"p2\"}");
+    replies.push_back("40{\"sid\":\"d\"}");
+    size_t connects = 0;
+    server.set_script([&](std::string const& p)
+    {
+        if(p.compare(0,2,"40") != 0) return false;
+        //events sent ahead of the CONNECT reply wait for it.
+        server.push(replies[std::min(connects++,replies.size()-1)]);
+        return true;
+    });
+    client c;
+    c.set_transport(client::transport_polling);
+    c.set_connection_state_recovery(true);
+    c.set_reconnect_delay(10);
+    c.set_reconnect_delay_max(10);
+    latch connected;
+    latch ticked;
+    std::vector<bool> recovered;
+    std::vector<int> ticks;
+    c.set_socket_open_listener([&](std::string const&)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        recovered.push_back(c.socket()->recovered());
+        connected.set();
+    });
+    c.socket()->on("tick",[&](event& ev)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        ticks.push_back((int)ev.get_messages()[0]->get_int());
+        if(ticks.size() > 1) ticked.set();
+    });
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    //replayed once the namespace is connected.
+    BOOST_REQUIRE(ticked.wait());
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        BOOST_CHECK(!recovered[0]);
+        BOOST_REQUIRE(ticks.size() == 2);
+        BOOST_CHECK(ticks[0] == 1 && ticks[1] == 2);
+    }
+
+    //the last offset seen is sent along when the session is resumed.
+    connected.reset();
+    ticked.reset();
+    server.push("1");
+    BOOST_REQUIRE(connected.wait());
+    BOOST_CHECK(server.wait_for_packet("40{\"offset\":\"o2\",\"pid\":\"p1\"}"));
+    BOOST_REQUIRE(ticked.wait());
+
+    connected.reset();
+    server.push("1");
+    BOOST_REQUIRE(connected.wait());
+    BOOST_CHECK(server.wait_for_packet("40{\"offset\":\"o3\",\"pid\":\"p1\"}"));
+
+    connected.reset();
+    server.push("1");
+    BOOST_REQUIRE(connected.wait());
+    BOOST_CHECK(server.wait_for_packet("40{\"offset\":\"\",\"pid\":\"p2\"}"));
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        BOOST_REQUIRE(recovered.size() == 4);
+        BOOST_CHECK(recovered[1]);
+        //another pid, a new session without the offsets of the old one.
+        BOOST_CHECK(!recovered[2]);
+        BOOST_CHECK(!recovered[3]);
+        BOOST_CHECK(ticks.size() == 3);
+    }
+    c.sync_close();
+}
+
+BOOST_AUTO_TEST_CASE( test_recovery_disabled )
+{
+    //without recovery, events of a namespace not connected yet aren't held back.
+    sio_stand_in server;
+    server.set_script([&](std::string const& p)
+    {
+        if(p.compare(0,7,"40/chat") != 0) return false;
+        server.push("42/chat,[\"tick\",1,\"o1\"]\x1e" "40/chat,{\"sid\":\"chat\",\"pid\":\"p1\"}\x1e" "42/chat,[\"tick\",2,\"o2\"]");
+        return true;
+    });
+    client c;
+    c.set_transport(client::transport_polling);
+    latch connected;
+    latch ticked;
+    std::vector<int> ticks;
+    c.set_socket_open_listener([&](std::string const& nsp){ if(nsp == "/chat") connected.set(); });
+    c.socket("chat")->on("tick",[&](event& ev)
+    {
+        ticks.push_back((int)ev.get_messages()[0]->get_int());
+        if(ticks.size() == 2) ticked.set();
+    });
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    BOOST_REQUIRE(ticked.wait());
+    BOOST_CHECK(ticks[0] == 1 && ticks[1] == 2);
+    BOOST_CHECK(!c.socket("chat")->recovered());
+    c.sync_close();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_ack)
+
+// Ack id of an emit as the server receives it, "42<id>[...]" or "42/nsp,<id>[...]".
+static std::string ack_id_of(std::string const& packet)
+{
+    size_t start = packet.find(',') != std::string::npos ? packet.find(',') + 1 : 2;
+    return packet.substr(start,packet.find('[')-start);
+}
+
+BOOST_AUTO_TEST_CASE( test_ack_timeout_once )
+{
+    sio_stand_in server;
+    std::string late_ack;
+    server.set_script([&](std::string const& p)
+    {
+        if(p.compare(0,2,"42") != 0) return false;
+        late_ack = "43" + ack_id_of(p) + "[\"late\"]";
+        return true;
+    });
+    client c;
+    c.set_transport(client::transport_polling);
+    latch connected;
+    latch answered;
+    std::atomic<int> calls(0);
+    socket::ack_status status = socket::ack_ok;
+    c.set_socket_open_listener([&](std::string const&){ connected.set(); });
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    c.socket()->emit_with_ack("ping",message::list(),[&](socket::ack_status s, message::list const&)
+    {
+        status = s;
+        ++calls;
+        answered.set();
+    },100);
+    BOOST_REQUIRE(answered.wait());
+    BOOST_CHECK(status == socket::ack_timeout);
+    BOOST_CHECK(c.socket()->get_pending_ack_count() == 0);
+    //the ack arriving after the timeout is ignored.
+    server.push(late_ack);
+    c.socket()->emit("done");
+    BOOST_REQUIRE(server.wait_for_packet("42[\"done\"]"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    BOOST_CHECK(calls == 1);
+    c.sync_close();
+}
+
+BOOST_AUTO_TEST_CASE( test_ack_disconnected_on_drop )
+{
+    sio_stand_in server;
+    client c;
+    c.set_transport(client::transport_polling);
+    c.set_reconnect_attempts(0);
+    latch connected;
+    latch answered;
+    std::atomic<int> calls(0);
+    socket::ack_status status = socket::ack_ok;
+    c.set_socket_open_listener([&](std::string const&){ connected.set(); });
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    c.socket()->emit_with_ack("ping",message::list(),[&](socket::ack_status s, message::list const&)
+    {
+        status = s;
+        ++calls;
+        answered.set();
+    },5000);
+    BOOST_REQUIRE(server.wait_for([](std::vector<std::string> const& r){ return r.size() > 0 && r.back().compare(0,2,"42") == 0; }));
+    server.push("1");
+    BOOST_REQUIRE(answered.wait(1000));
+    BOOST_CHECK(status == socket::ack_disconnected);
+    BOOST_CHECK(c.socket()->get_pending_ack_count() == 0);
+    //its timeout doesn't fire again.
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    BOOST_CHECK(calls == 1);
+    c.sync_close();
+}
+
+BOOST_AUTO_TEST_CASE( test_ack_disconnected_on_close )
+{
+    sio_stand_in server;
+    client c;
+    c.set_transport(client::transport_polling);
+    latch connected;
+    latch answered;
+    std::atomic<int> calls(0);
+    socket::ack_status status = socket::ack_ok;
+    c.set_socket_open_listener([&](std::string const& nsp){ if(nsp == "/chat") connected.set(); });
+    socket::ptr chat = c.socket("chat");
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    chat->emit_with_ack("ping",message::list(),[&](socket::ack_status s, message::list const&)
+    {
+        status = s;
+        ++calls;
+        answered.set();
+    });
+    BOOST_REQUIRE(server.wait_for([](std::vector<std::string> const& r){ return r.size() > 0 && r.back().compare(0,7,"42/chat") == 0; }));
+    //the server closes the namespace.
+    server.push("41/chat,");
+    BOOST_REQUIRE(answered.wait());
+    BOOST_CHECK(status == socket::ack_disconnected);
+    BOOST_CHECK(calls == 1);
+    c.sync_close();
+}
+
+// Runs tasks as they are submitted, counting them.
+class counting_executor : public event_executor
+{
+public:
+    counting_executor(): submitted(0), running(false) {}
+
+    void submit(std::size_t, std::function<void()> const& task)
+    {
+        ++submitted;
+        running = true;
+        task();
+        running = false;
+    }
+
+    std::atomic<int> submitted;
+    std::atomic<bool> running;
+};
+
+BOOST_AUTO_TEST_CASE( test_ack_failed_on_executor )
+{
+    sio_stand_in server;
+    std::shared_ptr<counting_executor> executor = std::make_shared<counting_executor>();
+    client c;
+    c.set_transport(client::transport_polling);
+    c.set_reconnect_attempts(0);
+    c.set_event_executor(executor);
+    latch connected;
+    latch timed_out;
+    latch disconnected;
+    c.set_socket_open_listener([&](std::string const&){ connected.set(); });
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    //resolved without a reply, still on the executor.
+    c.socket()->emit_with_ack("ping",message::list(),[&](socket::ack_status s, message::list const&)
+    {
+        if(s == socket::ack_timeout && executor->running) timed_out.set();
+    },100);
+    BOOST_CHECK(timed_out.wait());
+    c.socket()->emit_with_ack("ping",message::list(),[&](socket::ack_status s, message::list const&)
+    {
+        if(s == socket::ack_disconnected && executor->running) disconnected.set();
+    });
+    BOOST_REQUIRE(server.wait_for([](std::vector<std::string> const& r){ return std::count_if(r.begin(),r.end(),[](std::string const& p){ return p.compare(0,2,"42") == 0; }) == 2; }));
+    server.push("1");
+    BOOST_CHECK(disconnected.wait());
+    BOOST_CHECK(executor->submitted == 2);
+    c.sync_close();
+}
+
+BOOST_AUTO_TEST_CASE( test_ack_cap )
+{
+    sio_stand_in server;
+    std::mutex mutex;
+    std::vector<std::string> ids;
+    server.set_script([&](std::string const& p)
+    {
+        if(p.compare(0,2,"42") == 0)
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            ids.push_back(ack_id_of(p));
+        }
+        return false;
+    });
+    client c;
+    c.set_transport(client::transport_polling);
+    latch connected;
+    c.set_socket_open_listener([&](std::string const&){ connected.set(); });
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    socket::ptr s = c.socket();
+    s->set_max_pending_acks(1);
+    latch first;
+    s->emit_with_ack("first",message::list(),[&](socket::ack_status st, message::list const&)
+    {
+        BOOST_CHECK(st == socket::ack_ok);
+        first.set();
+    });
+    BOOST_REQUIRE(server.wait_for([](std::vector<std::string> const& r){ return r.size() > 0 && r.back().find("first") != std::string::npos; }));
+
+    //at the cap, waits for its timeout without sending.
+    socket::ack_status status = socket::ack_ok;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    s->emit_with_ack("waits",message::list(),[&](socket::ack_status st, message::list const&){ status = st; },200);
+    BOOST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(200));
+    BOOST_CHECK(status == socket::ack_timeout);
+
+    //on the network thread it's rejected right away.
+    latch rejected;
+    s->on("go",[&](event&)
+    {
+        s->emit_with_ack("refused",message::list(),[&](socket::ack_status st, message::list const&)
+        {
+            if(st == socket::ack_rejected) rejected.set();
+        });
+    });
+    server.push("42[\"go\"]");
+    BOOST_CHECK(rejected.wait());
+    BOOST_CHECK(s->get_pending_ack_count() == 1);
+
+    //blocks until the first ack frees room.
+    latch second;
+    std::thread blocked([&]()
+    {
+        s->emit_with_ack("second",message::list(),[&](socket::ack_status, message::list const&){ second.set(); });
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        BOOST_REQUIRE(ids.size() == 1);
+        server.push("43" + ids[0] + "[]");
+    }
+    BOOST_CHECK(first.wait());
+    blocked.join();
+    BOOST_CHECK(server.wait_for([](std::vector<std::string> const& r){ return r.size() > 0 && r.back().find("second") != std::string::npos; }));
+    std::vector<std::string> r = server.received();
+    BOOST_CHECK(std::count_if(r.begin(),r.end(),[](std::string const& p){ return p.find("waits") != std::string::npos || p.find("refused") != std::string::npos; }) == 0);
+    c.sync_close();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_bindings)
+
+BOOST_AUTO_TEST_CASE( test_bindings_swap_during_dispatch )
+{
+    sio_stand_in server;
+    client c;
+    c.set_transport(client::transport_polling);
+    latch connected;
+    latch ticked;
+    std::atomic<int> ticks(0);
+    c.set_socket_open_listener([&](std::string const&){ connected.set(); });
+    socket::ptr s = c.socket();
+    s->on("tick",[&](event&){ if(++ticks == 500) ticked.set(); });
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    //bindings change under every dispatch, tick stays bound throughout.
+    std::atomic<bool> stop(false);
+    std::thread rebinding([&]()
+    {
+        for(int i = 0; !stop; ++i)
+        {
+            std::string name = "other" + std::to_string(i % 8);
+            s->on(name,[](event&){});
+            s->off(name);
+        }
+    });
+    for(int i = 0; i < 50; ++i)
+    {
+        std::string batch;
+        for(int j = 0; j < 10; ++j)
+        {
+            batch.append(batch.empty() ? "" : "\x1e").append("42[\"tick\"," + std::to_string(i * 10 + j) + "]");
+        }
+        server.push(batch);
+    }
+    BOOST_CHECK(ticked.wait());
+    stop = true;
+    rebinding.join();
+    BOOST_CHECK(ticks == 500);
+    c.sync_close();
+}
+
+BOOST_AUTO_TEST_CASE( test_bindings_rebind_in_listener )
+{
+    sio_stand_in server;
+    client c;
+    c.set_transport(client::transport_polling);
+    latch connected;
+    latch done;
+    std::atomic<int> first(0);
+    std::atomic<int> second(0);
+    c.set_socket_open_listener([&](std::string const&){ connected.set(); });
+    socket::ptr s = c.socket();
+    s->on("a",[&](event&)
+    {
+        //replaces the listener running now.
+        s->off("a");
+        s->on("a",[&](event&){ ++second; });
+        s->on("b",[&](event&){ done.set(); });
+        ++first;
+    });
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    server.push("42[\"a\"]\x1e" "42[\"a\"]\x1e" "42[\"b\"]");
+    BOOST_REQUIRE(done.wait());
+    BOOST_CHECK(first == 1);
+    BOOST_CHECK(second == 1);
+    c.sync_close();
+}
+
+BOOST_AUTO_TEST_CASE( test_bindings_before_connect )
+{
+    //nothing dispatches yet, replaced bindings are released right away.
+    client c;
+    std::shared_ptr<int> token = std::make_shared<int>(0);
+    c.socket()->on("a",[token](event&){});
+    BOOST_CHECK(token.use_count() == 2);
+    c.socket()->off("a");
+    BOOST_CHECK(token.use_count() == 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_volatile)
+
+BOOST_AUTO_TEST_CASE( test_volatile_disconnected )
+{
+    sio_stand_in server;
+    client c;
+    c.set_transport(client::transport_polling);
+    c.set_reconnect_attempts(0);
+    BOOST_CHECK(!c.socket()->emit_volatile("position"));
+    latch connected;
+    latch closed;
+    c.set_socket_open_listener([&](std::string const&){ connected.set(); });
+    c.set_close_listener([&](client::close_reason const&){ closed.set(); });
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    BOOST_CHECK(c.socket()->emit_volatile("position"));
+    BOOST_CHECK(server.wait_for_packet("42[\"position\"]"));
+    server.push("1");
+    BOOST_REQUIRE(closed.wait());
+    BOOST_CHECK(!c.socket()->emit_volatile("position"));
+    BOOST_CHECK(c.socket()->get_volatile_drop_count() == 2);
+    c.sync_close();
+}
+
+BOOST_AUTO_TEST_CASE( test_volatile_backlog )
+{
+    sio_stand_in server;
+    client c;
+    c.set_transport(client::transport_polling);
+    socket::ptr s = c.socket();
+    //queued before connecting, the open listener runs ahead of sending it.
+    s->emit("queued");
+    bool sent = true;
+    latch connected;
+    c.set_socket_open_listener([&](std::string const&)
+    {
+        sent = s->emit_volatile("position");
+        connected.set();
+    });
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    BOOST_CHECK(!sent);
+    BOOST_CHECK(s->get_volatile_drop_count() == 1);
+    BOOST_CHECK(server.wait_for_packet("42[\"queued\"]"));
+    //sent once the backlog is gone.
+    BOOST_CHECK(s->emit_volatile("position"));
+    BOOST_CHECK(server.wait_for_packet("42[\"position\"]"));
+    c.sync_close();
+}
+
+BOOST_AUTO_TEST_CASE( test_volatile_buffer_limit )
+{
+    sio_stand_in server;
+    client c;
+    c.set_transport(client::transport_polling);
+    c.set_volatile_buffer_limit(1000);
+    socket::ptr s = c.socket();
+    latch connected;
+    latch filled;
+    bool sent = true;
+    c.set_socket_open_listener([&](std::string const&){ connected.set(); });
+    s->on("fill",[&](event&)
+    {
+        //the second waits in the transport behind the request of the first.
+        s->emit("bulk",message::list(std::string(2000,'x')));
+        s->emit("bulk",message::list(std::string(2000,'y')));
+        sent = s->emit_volatile("position");
+        filled.set();
+    });
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    server.push("42[\"fill\"]");
+    BOOST_REQUIRE(filled.wait());
+    BOOST_CHECK(!sent);
+    BOOST_CHECK(server.wait_for([](std::vector<std::string> const& r){ return std::count_if(r.begin(),r.end(),[](std::string const& p){ return p.find("bulk") != std::string::npos; }) == 2; }));
+    //a drop resamples what the transport holds, so emits get through once it drained.
+    bool recovered = false;
+    for(int i = 0; i < 200 && !recovered; ++i)
+    {
+        recovered = s->emit_volatile("position");
+        if(!recovered) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    BOOST_CHECK(recovered);
+    BOOST_CHECK(server.wait_for_packet("42[\"position\"]"));
+    c.sync_close();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_lanes)
+
+// Index of the first packet received containing text, -1 if none.
+static int index_of(std::vector<std::string> const& r, std::string const& text)
+{
+    for(size_t i = 0; i < r.size(); ++i)
+    {
+        if(r[i].find(text) != std::string::npos) return (int)i;
+    }
+    return -1;
+}
+
+BOOST_AUTO_TEST_CASE( test_lanes_order )
+{
+    sio_stand_in server;
+    client c;
+    c.set_transport(client::transport_polling);
+    socket::ptr s = c.socket();
+    latch connected;
+    c.set_socket_open_listener([&](std::string const&){ connected.set(); });
+    s->on("fill",[&](event& ev)
+    {
+        //the first goes out, the second waits in the transport above the
+        //watermark, the rest is held back in the lanes.
+        s->emit("bulk1",message::list(std::string(300 * 1024,'x')),nullptr,socket::priority_low);
+        s->emit("bulk2",message::list(std::string(300 * 1024,'y')),nullptr,socket::priority_low);
+        s->emit("l1",nullptr,nullptr,socket::priority_low);
+        s->emit("n1");
+        message::list bin("nbin");
+        bin.push(std::make_shared<const std::string>("binary"));
+        s->emit("nbin",bin);
+        s->emit("h1",nullptr,nullptr,socket::priority_high);
+        s->emit("n2");
+        s->emit("l2",nullptr,nullptr,socket::priority_low);
+        s->emit("h2",nullptr,nullptr,socket::priority_high);
+        //the ack replying to this event goes on the control lane.
+        ev.put_ack_message(message::list("ok"));
+    });
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    server.push("425[\"fill\"]");
+    //resumes once the transport drained.
+    BOOST_REQUIRE(server.wait_for([](std::vector<std::string> const& r){ return index_of(r,"l2") >= 0; }));
+    std::vector<std::string> r = server.received();
+    int ack = index_of(r,"435[");
+    int bin = index_of(r,"nbin");
+    BOOST_REQUIRE(ack >= 0 && bin >= 0 && bin + 1 < (int)r.size());
+    BOOST_CHECK(index_of(r,"bulk1") < index_of(r,"bulk2"));
+    BOOST_CHECK(index_of(r,"bulk2") < ack);
+    BOOST_CHECK(ack < index_of(r,"h1"));
+    BOOST_CHECK(index_of(r,"h1") < index_of(r,"h2"));
+    BOOST_CHECK(index_of(r,"h2") < index_of(r,"n1"));
+    BOOST_CHECK(index_of(r,"n1") < bin);
+    //the attachment right behind its packet.
+    BOOST_CHECK(r[bin].compare(0,3,"451") == 0);
+    BOOST_CHECK(r[bin + 1].substr(1) == "binary");
+    BOOST_CHECK(bin + 1 < index_of(r,"n2"));
+    BOOST_CHECK(index_of(r,"n2") < index_of(r,"l1"));
+    BOOST_CHECK(index_of(r,"l1") < index_of(r,"l2"));
+    c.sync_close();
+}
+
+BOOST_AUTO_TEST_CASE( test_lanes_disconnect_last )
+{
+    sio_stand_in server;
+    client c;
+    c.set_transport(client::transport_polling);
+    socket::ptr chat = c.socket("chat");
+    latch connected;
+    c.set_socket_open_listener([&](std::string const& nsp){ if(nsp == "/chat") connected.set(); });
+    chat->on("fill",[&](event&)
+    {
+        chat->emit("bulk1",message::list(std::string(300 * 1024,'x')),nullptr,socket::priority_low);
+        chat->emit("bulk2",message::list(std::string(300 * 1024,'y')),nullptr,socket::priority_low);
+        chat->emit("last");
+        chat->close();
+    });
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    server.push("42/chat,[\"fill\"]");
+    BOOST_REQUIRE(server.wait_for([](std::vector<std::string> const& r){ return index_of(r,"41/chat") >= 0; }));
+    std::vector<std::string> r = server.received();
+    int last = index_of(r,"last");
+    BOOST_CHECK(last >= 0 && last < index_of(r,"41/chat"));
+    c.sync_close();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_backoff)
+
+BOOST_AUTO_TEST_CASE( test_backoff_jitter )
+{
+    sio::backoff b;
+    BOOST_CHECK(b.next_delay(0,5000,25000) == 5000);
+    BOOST_CHECK(b.next_delay(1,5000,25000) == 7500);
+    BOOST_CHECK(b.next_delay(10,5000,25000) == 25000);
+
+    b.set_jitter(client::jitter_full);
+    b.seed(1);
+    for(unsigned i = 0;i<100;++i)
+    {
+        BOOST_CHECK(b.next_delay(i%5,5000,25000) <= std::min(5000*std::pow(1.5,i%5),25000.0));
+    }
+
+    b.set_jitter(client::jitter_decorrelated);
+    bool varied = false;
+    unsigned last = 0;
+    for(unsigned i = 0;i<100;++i)
+    {
+        unsigned d = b.next_delay(i,5000,25000);
+        BOOST_CHECK(d >= 5000 && d <= 25000);
+        varied = varied || (i>0 && d != last);
+        last = d;
+    }
+    BOOST_CHECK(varied);
+}
+
+BOOST_AUTO_TEST_CASE( test_reconnect_gate )
+{
+    sio::reconnect_gate gate;
+    gate.set_limit(2);
+    int granted = 0;
+    sio::reconnect_gate::ticket t1 = gate.acquire([&](){ ++granted; });
+    sio::reconnect_gate::ticket t2 = gate.acquire([&](){ ++granted; });
+    sio::reconnect_gate::ticket t3 = gate.acquire([&](){ ++granted; });
+    sio::reconnect_gate::ticket t4 = gate.acquire([&](){ ++granted; });
+    BOOST_CHECK(granted == 2);
+    BOOST_CHECK(gate.active() == 2);
+    gate.release(t3);//withdrawn while waiting.
+    gate.release(t1);
+    BOOST_CHECK(granted == 3);
+    gate.release(t2);
+    gate.release(t4);
+    BOOST_CHECK(granted == 3);
+    BOOST_CHECK(gate.active() == 0);
+    gate.set_limit(0);
+    gate.acquire([&](){ ++granted; });
+    BOOST_CHECK(granted == 4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_journal)
+
+static sio::journal::record make_record(std::string const& text, std::string const& bin = std::string())
+{
+    sio::journal::record r;
+    sio::journal::frame f;
+    f.binary = false;
+    f.payload = std::make_shared<std::string>(text);
+    r.push_back(f);
+    if(!bin.empty())
+    {
+        f.binary = true;
+        f.payload = std::make_shared<std::string>(bin);
+        r.push_back(f);
+    }
+    return r;
+}
+
+BOOST_AUTO_TEST_CASE( test_journal_persist )
+{
+    std::string path = "sio_test_journal_1.bin";
+    {
+        sio::journal j;
+        BOOST_REQUIRE(j.open(path,256));
+        BOOST_CHECK(j.append(make_record("451-[\"bin\",{\"_placeholder\":true,\"num\":0}]",std::string("\x04\x00\x01",3))));
+        BOOST_CHECK(j.append(make_record("42[\"a\",1]")));
+        BOOST_CHECK(j.size() == 2);
+    }
+    sio::journal j;
+    BOOST_REQUIRE(j.open(path,1024));
+    BOOST_CHECK(j.capacity() == 256);//an existing journal keeps its capacity.
+    sio::journal::record r;
+    BOOST_REQUIRE(j.front(r));
+    BOOST_REQUIRE(r.size() == 2);
+    BOOST_CHECK(!r[0].binary && r[1].binary);
+    BOOST_CHECK(*r[1].payload == std::string("\x04\x00\x01",3));
+    j.pop();
+    BOOST_REQUIRE(j.front(r));
+    BOOST_CHECK(*r[0].payload == "42[\"a\",1]");
+    j.pop();
+    BOOST_CHECK(j.empty() && j.used_bytes() == 0);
+    j.close();
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( test_journal_wrap_and_full )
+{
+    std::string path = "sio_test_journal_2.bin";
+    sio::journal j;
+    BOOST_REQUIRE(j.open(path,64));
+    //each record takes 4+4+5+16 = 29 bytes, two of them fit.
+    BOOST_CHECK(j.append(make_record("42[\"0\",\"xxxxxx\"]")));
+    BOOST_CHECK(j.append(make_record("42[\"1\",\"xxxxxx\"]")));
+    BOOST_CHECK(!j.append(make_record("42[\"2\",\"xxxxxx\"]")));
+    sio::journal::record r;
+    for(int i = 2;i<10;++i)
+    {
+        j.pop();
+        //records now straddle the end of the ring.
+        std::string text = "42[\"" + std::to_string(i) + "\",\"xxxxxx\"]";
+        BOOST_REQUIRE(j.append(make_record(text)));
+        BOOST_REQUIRE(j.front(r));
+        BOOST_CHECK(*r[0].payload == "42[\"" + std::to_string(i-1) + "\",\"xxxxxx\"]");
+    }
+    BOOST_CHECK(j.size() == 2);
+    j.close();
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( test_journal_foreign_file )
+{
+    std::string path = "sio_test_journal_3.bin";
+    std::string text(200,'x');
+    {
+        std::ofstream out(path.c_str(),std::ios::binary);
+        out<<text;
+    }
+    sio::journal j;
+    BOOST_CHECK(!j.open(path,256));
+    BOOST_CHECK(!j.is_open());
+    //left as it was.
+    {
+        std::ifstream in(path.c_str(),std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(in)),std::istreambuf_iterator<char>());
+        BOOST_CHECK(content == text);
+    }
+    //an empty file becomes a journal.
+    {
+        std::ofstream out(path.c_str(),std::ios::binary|std::ios::trunc);
+    }
+    BOOST_REQUIRE(j.open(path,256));
+    BOOST_CHECK(j.empty() && j.capacity() == 256);
+    j.close();
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_resolver)
+
+BOOST_AUTO_TEST_CASE( test_endpoint_cache )
+{
+    boost::asio::io_service io;
+    sio::endpoint_cache cache(io);
+    int lookups = 0;
+    cache.set_resolve_hook([&](std::string const& host, std::string const& port, sio::endpoint_cache::resolve_handler const& handler)
+    {
+        ++lookups;
+        sio::endpoint_list endpoints;
+        if(host == "stub.test")
+        {
+            endpoints.push_back(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string("::1"),(unsigned short)std::stoi(port)));
+            endpoints.push_back(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"),(unsigned short)std::stoi(port)));
+        }
+        handler(boost::system::error_code(),endpoints);
+    });
+    sio::endpoint_list result;
+    boost::system::error_code result_ec;
+    auto store = [&](boost::system::error_code const& ec, sio::endpoint_list const& endpoints)
+    {
+        result_ec = ec;
+        result = endpoints;
+    };
+    cache.resolve("stub.test","80",store);
+    io.run();
+    io.reset();
+    BOOST_CHECK(lookups == 1 && result.size() == 2);
+    cache.resolve("stub.test","80",store);
+    io.run();
+    io.reset();
+    BOOST_CHECK(lookups == 1 && result.size() == 2);//served from the cache.
+    cache.evict("stub.test","80");
+    cache.resolve("stub.test","80",store);
+    io.run();
+    io.reset();
+    BOOST_CHECK(lookups == 2);
+    cache.resolve("unknown.test","80",store);
+    io.run();
+    io.reset();
+    BOOST_CHECK(result_ec == boost::asio::error::host_not_found);
+    cache.set_ttl(0);
+    cache.resolve("stub.test","81",store);
+    cache.resolve("stub.test","81",store);
+    io.run();
+    BOOST_CHECK(lookups == 5);
+}
+
+BOOST_AUTO_TEST_CASE( test_endpoint_interleave )
+{
+    using boost::asio::ip::tcp;
+    using boost::asio::ip::address;
+    sio::endpoint_list endpoints;
+    endpoints.push_back(tcp::endpoint(address::from_string("::1"),1));
+    endpoints.push_back(tcp::endpoint(address::from_string("::2"),1));
+    endpoints.push_back(tcp::endpoint(address::from_string("::3"),1));
+    endpoints.push_back(tcp::endpoint(address::from_string("10.0.0.1"),1));
+    sio::endpoint_list order = sio::endpoint_racer::interleave(endpoints);
+    BOOST_REQUIRE(order.size() == 4);
+    BOOST_CHECK(order[0].address().is_v6() && order[1].address().is_v4());
+    BOOST_CHECK(order[2] == endpoints[1] && order[3] == endpoints[2]);
+}
+
+BOOST_AUTO_TEST_CASE( test_endpoint_race )
+{
+    using boost::asio::ip::tcp;
+    boost::asio::io_service io;
+    tcp::endpoint refused;
+    {
+        tcp::acceptor closed(io,tcp::endpoint(boost::asio::ip::address_v4::loopback(),0));
+        refused = closed.local_endpoint();
+    }
+    tcp::acceptor listener(io,tcp::endpoint(boost::asio::ip::address_v4::loopback(),0));
+    tcp::socket peer(io);
+    listener.async_accept(peer,[](boost::system::error_code const&){});
+    sio::endpoint_list endpoints;
+    endpoints.push_back(refused);
+    endpoints.push_back(listener.local_endpoint());
+    std::shared_ptr<sio::endpoint_racer> racer = std::make_shared<sio::endpoint_racer>(io,endpoints);
+    racer->set_attempt_delay(5000);//the refused attempt has to move the race on by itself.
+    boost::system::error_code race_ec = boost::asio::error::would_block;
+    tcp::endpoint winner;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::unique_ptr<tcp::socket> won;
+    racer->start([&](boost::system::error_code const& ec, tcp::endpoint const& ep)
+    {
+        race_ec = ec;
+        winner = ep;
+        won = racer->take_socket();
+    });
+    io.run();
+    BOOST_CHECK(!race_ec);
+    BOOST_CHECK(winner == listener.local_endpoint());
+    BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(4));
+    //the connection is handed over, not closed.
+    BOOST_REQUIRE(won);
+    BOOST_CHECK(won->is_open());
+    BOOST_CHECK(won->remote_endpoint() == listener.local_endpoint());
+
+    io.reset();
+    endpoints.pop_back();
+    endpoints.push_back(refused);
+    racer = std::make_shared<sio::endpoint_racer>(io,endpoints);
+    racer->start([&](boost::system::error_code const& ec, tcp::endpoint const&)
+    {
+        race_ec = ec;
+    });
+    io.run();
+    BOOST_CHECK(race_ec == boost::asio::error::connection_refused);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_timer_wheel)
+
+BOOST_AUTO_TEST_CASE( test_timer_wheel_order )
+{
+    boost::asio::io_service io;
+    sio::timer_wheel wheel(io, 1);
+    std::vector<int> fired;
+    wheel.arm(30, [&]() { fired.push_back(3); });
+    wheel.arm(10, [&]() { fired.push_back(1); });
+    wheel.arm(20, [&]() { fired.push_back(2); });
+    sio::timer_wheel::timer_id id = wheel.arm(15, [&]() { fired.push_back(0); });
+    BOOST_CHECK(wheel.pending() == 4);
+    BOOST_CHECK(wheel.cancel(id));
+    BOOST_CHECK(!wheel.cancel(id));
+    BOOST_CHECK(!wheel.cancel(0));
+    io.run();
+    BOOST_REQUIRE(fired.size() == 3);
+    BOOST_CHECK(fired[0] == 1 && fired[1] == 2 && fired[2] == 3);
+    BOOST_CHECK(wheel.pending() == 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_timer_wheel_cascade )
+{
+    //with 1ms ticks 70 and 300 land in the second level and cascade down.
+    boost::asio::io_service io;
+    sio::timer_wheel wheel(io, 1);
+    std::vector<int> fired;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration last_elapsed;
+    wheel.arm(300, [&]() { fired.push_back(300); last_elapsed = std::chrono::steady_clock::now() - start; });
+    wheel.arm(5, [&]() { fired.push_back(5); });
+    wheel.arm(70, [&]() { fired.push_back(70); });
+    io.run();
+    BOOST_REQUIRE(fired.size() == 3);
+    BOOST_CHECK(fired[0] == 5 && fired[1] == 70 && fired[2] == 300);
+    BOOST_CHECK(std::chrono::duration_cast<std::chrono::milliseconds>(last_elapsed).count() >= 300);
+}
+
+BOOST_AUTO_TEST_CASE( test_timer_wheel_idle )
+{
+    //once the last timer is cancelled the io_service runs out.
+    boost::asio::io_service io;
+    sio::timer_wheel wheel(io);
+    bool fired = false;
+    sio::timer_wheel::timer_id id = wheel.arm(10000, [&]() { fired = true; });
+    io.post([&]() { wheel.cancel(id); });
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    io.run();
+    BOOST_CHECK(!fired);
+    BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_ack_table)
+
+BOOST_AUTO_TEST_CASE( test_ack_table_basic )
+{
+    sio::ack_table table(16);
+    std::vector<unsigned> ids;
+    //more acks than slots, the rest overflows.
+    for(int i = 0; i < 40; ++i)
+    {
+        BOOST_REQUIRE(table.acquire(0));
+        unsigned id = table.reserve();
+        BOOST_CHECK(id > 0 && id < 0x80000000);
+        sio::ack_table::entry e;
+        e.listener = [i](sio::socket::ack_status, sio::message::list const&) {};
+        e.timer = i;
+        table.publish(id, e);
+        ids.push_back(id);
+    }
+    BOOST_CHECK(table.size() == 40);
+    BOOST_CHECK(!table.acquire(40));
+    sio::ack_table::entry e;
+    BOOST_CHECK(table.take(ids[3], e));
+    BOOST_CHECK(e.listener && e.timer == 3);
+    BOOST_CHECK(!table.take(ids[3], e));
+    BOOST_CHECK(table.take(ids[39], e));
+    BOOST_CHECK(e.timer == 39);
+    BOOST_CHECK(table.size() == 38);
+    std::vector<sio::ack_table::entry> rest;
+    table.take_all(rest);
+    BOOST_CHECK(rest.size() == 38);
+    BOOST_CHECK(table.size() == 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_ack_table_set_timer )
+{
+    sio::ack_table table(16);
+    std::vector<unsigned> ids;
+    //the last ones overflow.
+    for(int i = 0; i < 20; ++i)
+    {
+        table.acquire(0);
+        unsigned id = table.reserve();
+        sio::ack_table::entry e;
+        e.timer = 0;
+        table.publish(id, e);
+        ids.push_back(id);
+    }
+    sio::ack_table::entry e;
+    for(int i = 0; i < 20; ++i)
+    {
+        BOOST_CHECK(table.set_timer(ids[i], i + 1));
+        BOOST_CHECK(table.take(ids[i], e));
+        BOOST_CHECK(e.timer == (sio::timer_wheel::timer_id)(i + 1));
+        BOOST_CHECK(!table.set_timer(ids[i], 1));
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_ack_table_take_all_publishing )
+{
+    sio::ack_table table(16);
+    table.acquire(0);
+    unsigned id = table.reserve();
+    std::vector<sio::ack_table::entry> taken;
+    //reserved, not published yet: take_all waits rather than miss it.
+    std::thread disconnect([&]() { table.take_all(taken); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    sio::ack_table::entry e;
+    e.timer = 7;
+    table.publish(id, e);
+    disconnect.join();
+    BOOST_REQUIRE(taken.size() == 1);
+    BOOST_CHECK(taken[0].timer == 7);
+    BOOST_CHECK(table.size() == 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_ack_table_threads )
+{
+    sio::ack_table table(64);
+    std::atomic<unsigned> completed(0);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t)
+    {
+        threads.push_back(std::thread([&]()
+        {
+            for(int i = 0; i < 10000; ++i)
+            {
+                table.acquire(0);
+                unsigned id = table.reserve();
+                sio::ack_table::entry e;
+                e.listener = [&completed](sio::socket::ack_status, sio::message::list const&) { ++completed; };
+                e.timer = 0;
+                table.publish(id, e);
+                sio::ack_table::entry out;
+                if(table.take(id, out))
+                {
+                    out.listener(sio::socket::ack_ok, sio::message::list());
+                }
+            }
+        }));
+    }
+    for(size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i].join();
+    }
+    BOOST_CHECK(completed == 40000);
+    BOOST_CHECK(table.size() == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_worker_pool)
+
+BOOST_AUTO_TEST_CASE( test_worker_pool_order )
+{
+    const unsigned keys = 8;
+    const unsigned tasks = 2000;
+    std::vector<std::vector<unsigned> > seen(keys);
+    std::atomic<unsigned> concurrent_violations(0);
+    std::vector<std::atomic<int> > running(keys);
+    for(unsigned k = 0; k < keys; ++k) running[k] = 0;
+    {
+        sio::worker_pool pool(4);
+        BOOST_CHECK(pool.size() == 4);
+        for(unsigned i = 0; i < tasks; ++i)
+        {
+            for(unsigned k = 0; k < keys; ++k)
+            {
+                pool.submit(k, [&, k, i]()
+                {
+                    if(running[k]++ != 0) ++concurrent_violations;
+                    seen[k].push_back(i);
+                    --running[k];
+                });
+            }
+        }
+        //the destructor runs what's queued.
+    }
+    BOOST_CHECK(concurrent_violations == 0);
+    for(unsigned k = 0; k < keys; ++k)
+    {
+        BOOST_REQUIRE(seen[k].size() == tasks);
+        bool ordered = true;
+        for(unsigned i = 0; i < tasks; ++i)
+        {
+            ordered = ordered && seen[k][i] == i;
+        }
+        BOOST_CHECK(ordered);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_worker_pool_slow_key )
+{
+    //a busy key doesn't hold back the others.
+    sio::worker_pool pool(2);
+    std::mutex m;
+    std::condition_variable cv;
+    bool release = false;
+    std::atomic<bool> fast_done(false);
+    pool.submit(1, [&]()
+    {
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait_for(lock, std::chrono::seconds(5), [&]() { return release; });
+    });
+    pool.submit(2, [&]() { fast_done = true; });
+    for(int i = 0; i < 500 && !fast_done; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    BOOST_CHECK(fast_done);
+    {
+        std::lock_guard<std::mutex> lock(m);
+        release = true;
+    }
+    cv.notify_all();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_mpsc_ring)
+
+BOOST_AUTO_TEST_CASE( test_mpsc_ring_full )
+{
+    sio::mpsc_ring<int> ring(3);
+    BOOST_CHECK(ring.capacity() == 4);
+    for(int i = 0; i < 4; ++i)
+    {
+        BOOST_CHECK(ring.push(i));
+    }
+    BOOST_CHECK(!ring.push(4));
+    int v = -1;
+    BOOST_CHECK(ring.pop(v) && v == 0);
+    BOOST_CHECK(ring.push(4));
+    for(int i = 1; i <= 4; ++i)
+    {
+        BOOST_CHECK(ring.pop(v) && v == i);
+    }
+    BOOST_CHECK(!ring.pop(v));
+}
+
+BOOST_AUTO_TEST_CASE( test_mpsc_ring_producers )
+{
+    //every producer's values come out in the order it pushed them.
+    const int producers = 4;
+    const int count = 20000;
+    sio::mpsc_ring<std::pair<int,int> > ring(64);
+    std::vector<std::thread> threads;
+    for(int p = 0; p < producers; ++p)
+    {
+        threads.push_back(std::thread([&ring, p, count]()
+        {
+            for(int i = 0; i < count; ++i)
+            {
+                while(!ring.push(std::make_pair(p, i)))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }));
+    }
+    std::vector<int> next(producers, 0);
+    int received = 0;
+    bool ordered = true;
+    while(received < producers * count)
+    {
+        std::pair<int,int> v;
+        if(ring.pop(v))
+        {
+            ordered = ordered && v.second == next[v.first];
+            next[v.first] = v.second + 1;
+            ++received;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    for(size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i].join();
+    }
+    BOOST_CHECK(ordered);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_event_index)
+
+static void exact_listener(sio::event&) {}
+static void market_listener(sio::event&) {}
+static void trade_listener(sio::event&) {}
+static void single_listener(sio::event&) {}
+static void any_listener(sio::event&) {}
+
+typedef void (*listener_fn)(sio::event&);
+
+static sio::symbol_table symbols;
+
+static std::vector<listener_fn> match(sio::event_index const& index, std::string const& name)
+{
+    std::vector<const sio::socket::event_listener*> matched;
+    index.match(symbols.find(name), name, matched);
+    std::vector<listener_fn> result;
+    for(size_t i = 0; i < matched.size(); ++i)
+    {
+        result.push_back(*matched[i]->target<listener_fn>());
+    }
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE( test_event_index_match )
+{
+    sio::event_index index;
+    index.set(symbols.intern("market.eur.trade"), &exact_listener);
+    index.set_pattern("market.*", &market_listener);
+    index.set_pattern("market.**.trade", &trade_listener);
+    index.set_pattern("market.???.quote", &single_listener);
+    index.set_any(&any_listener);
+
+    std::vector<listener_fn> m = match(index, "market.eur.trade");
+    BOOST_REQUIRE(m.size() == 4);
+    BOOST_CHECK(m[0] == &any_listener && m[1] == &exact_listener && m[2] == &market_listener && m[3] == &trade_listener);
+
+    m = match(index, "market.usd.quote");
+    BOOST_REQUIRE(m.size() == 3);
+    BOOST_CHECK(m[0] == &any_listener && m[1] == &market_listener && m[2] == &single_listener);
+
+    m = match(index, "market.");
+    BOOST_CHECK(m.size() == 2);//'*' matches an empty run.
+    m = match(index, "market.usdx.quote");
+    BOOST_CHECK(m.size() == 2);
+    m = match(index, "news");
+    BOOST_REQUIRE(m.size() == 1);
+    BOOST_CHECK(m[0] == &any_listener);
+}
+
+BOOST_AUTO_TEST_CASE( test_event_index_scratch )
+{
+    sio::event_index index;
+    index.set_pattern("a*", &market_listener);
+    index.set_pattern("?b*", &trade_listener);
+    sio::event_index::scratch scratch;
+    std::vector<const sio::socket::event_listener*> matched;
+    index.match(NULL, "abc", matched, scratch);
+    BOOST_REQUIRE(matched.size() == 2);
+    BOOST_CHECK(*matched[0]->target<listener_fn>() == &market_listener);
+    std::size_t capacity = scratch.states.capacity();
+    //the states of the last walk don't leak into the next one.
+    matched.clear();
+    index.match(NULL, "xbc", matched, scratch);
+    BOOST_REQUIRE(matched.size() == 1);
+    BOOST_CHECK(*matched[0]->target<listener_fn>() == &trade_listener);
+    matched.clear();
+    index.match(NULL, "abc", matched, scratch);
+    BOOST_CHECK(matched.size() == 2);
+    BOOST_CHECK(scratch.states.capacity() == capacity);
+}
+
+BOOST_AUTO_TEST_CASE( test_event_index_copy )
+{
+    sio::event_index index;
+    index.set_pattern("a*", &market_listener);
+    index.set_pattern("a**c?", &trade_listener);
+    sio::event_index copy(index);
+    index.erase_pattern("a*");
+    BOOST_CHECK(match(index, "abc").empty());
+    std::vector<listener_fn> m = match(copy, "abcd");
+    BOOST_REQUIRE(m.size() == 2);
+    BOOST_CHECK(m[0] == &market_listener && m[1] == &trade_listener);
+    //the copy doesn't point into the index it was copied from.
+    std::unique_ptr<sio::event_index> source(new sio::event_index(copy));
+    sio::event_index assigned;
+    assigned = *source;
+    source.reset();
+    m = match(assigned, "abcd");
+    BOOST_REQUIRE(m.size() == 2);
+    BOOST_CHECK(m[0] == &market_listener && m[1] == &trade_listener);
+    copy.clear();
+    BOOST_CHECK(match(copy, "abc").empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_symbol_table)
+
+using namespace sio::literals;
+
+static_assert("abc"_ev.hash() == sio::event_name::hash("abc", 3), "event names hash at compile time");
+
+BOOST_AUTO_TEST_CASE( test_symbol_table_intern )
+{
+    sio::symbol_table table;
+    const sio::symbol* a = table.intern(std::string("chat"));
+    BOOST_CHECK(table.intern("chat"_ev) == a);
+    BOOST_CHECK(table.find("chat") == a);
+    BOOST_CHECK(a->hash == sio::symbol_table::hash("chat", 4));
+    BOOST_CHECK("chat"_ev.hash() == a->hash);
+    BOOST_CHECK(table.find("news") == NULL);
+    //growing keeps the symbols where they are.
+    for(int i = 0; i < 1000; ++i)
+    {
+        table.intern("event" + std::to_string(i));
+    }
+    BOOST_CHECK(table.size() == 1001);
+    BOOST_CHECK(table.find("chat") == a);
+    BOOST_CHECK(table.find("event999")->name == "event999");
+}
+
+BOOST_AUTO_TEST_CASE( test_symbol_table_auto_limit )
+{
+    sio::symbol_table table(2);
+    const sio::symbol* chat = table.intern(std::string("chat"));
+    BOOST_CHECK(table.lookup_or_intern("a") != NULL);
+    BOOST_CHECK(table.lookup_or_intern("b") != NULL);
+    BOOST_CHECK(table.lookup_or_intern("c") == NULL);
+    BOOST_CHECK(table.lookup_or_intern("chat") == chat);
+    BOOST_CHECK(table.lookup_or_intern("a") == table.find("a"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_outbound_scheduler)
+
+static void push(sio::outbound_scheduler& s, sio::outbound_flow* f, unsigned lane, size_t bytes, char tag)
+{
+    sio::outbound_packet p;
+    p.payload = std::make_shared<std::string>(1, tag);
+    p.bytes = bytes;
+    p.lane = lane;
+    p.flow = f;
+    f->add(bytes);
+    s.push(p);
+}
+
+static std::string drain(sio::outbound_scheduler& s, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now())
+{
+    std::string order;
+    sio::outbound_packet p;
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::time_point::max();
+    while(s.pop(p, now, next))
+    {
+        order += *p.payload;
+    }
+    return order;
+}
+
+BOOST_AUTO_TEST_CASE( test_outbound_scheduler_lanes )
+{
+    sio::outbound_scheduler s(3, 100);
+    sio::outbound_flow* f = s.get_flow("/");
+    BOOST_CHECK(s.get_flow("/") == f);
+    push(s, f, 2, 10, 'a');
+    push(s, f, 2, 10, 'b');
+    push(s, f, 0, 10, 'c');
+    push(s, f, 1, 10, 'd');
+    BOOST_CHECK(f->queued_packets() == 4 && f->queued_bytes() == 40);
+    BOOST_CHECK_EQUAL(drain(s), "cdab");
+    BOOST_CHECK(s.empty());
+    BOOST_CHECK(f->queued_packets() == 0 && f->queued_bytes() == 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_outbound_scheduler_fairness )
+{
+    sio::outbound_scheduler s(1, 100);
+    sio::outbound_flow* chatty = s.get_flow("/data");
+    sio::outbound_flow* admin = s.get_flow("/admin");
+    for(int i = 0; i < 6; ++i)
+    {
+        push(s, chatty, 0, 100, 'd');
+    }
+    push(s, admin, 0, 100, 'a');
+    push(s, admin, 0, 100, 'a');
+    //the admin packets don't wait behind all of the data ones.
+    BOOST_CHECK_EQUAL(drain(s), "dadadddd");
+
+    s.set_weight("/data", 2);
+    for(int i = 0; i < 6; ++i)
+    {
+        push(s, chatty, 0, 100, 'd');
+        push(s, admin, 0, 100, 'a');
+    }
+    BOOST_CHECK_EQUAL(drain(s).substr(0, 6), "ddadda");
+
+    push(s, chatty, 0, 1000, 'd');
+    push(s, admin, 0, 10, 'a');
+    BOOST_CHECK_EQUAL(drain(s), "ad");
+    push(s, chatty, 0, 10, 'd');
+    BOOST_CHECK(s.clear() == 10);
+    BOOST_CHECK(s.empty() && chatty->queued_packets() == 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_outbound_scheduler_large_packets )
+{
+    //a quantum per round would take a billion rounds.
+    sio::outbound_scheduler s(1, 1);
+    sio::outbound_flow* big = s.get_flow("/big");
+    sio::outbound_flow* bigger = s.get_flow("/bigger");
+    push(s, bigger, 0, 1500000000, 'B');
+    push(s, big, 0, 1000000000, 'b');
+    push(s, big, 0, 10, 'c');
+    //the smaller one earns enough first, then the small packet after it
+    //takes far fewer rounds than the bigger one still needs.
+    BOOST_CHECK_EQUAL(drain(s), "bcB");
+
+    s.set_weight("/bigger", 2);
+    push(s, bigger, 0, 1500000000, 'B');
+    push(s, big, 0, 1000000000, 'b');
+    BOOST_CHECK_EQUAL(drain(s), "Bb");
+    BOOST_CHECK(s.empty());
+}
+
+BOOST_AUTO_TEST_CASE( test_outbound_scheduler_held_back )
+{
+    sio::outbound_scheduler s(1, 100);
+    sio::outbound_flow* limited = s.get_flow("/limited");
+    sio::outbound_flow* other = s.get_flow("/other");
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    push(s, limited, 0, 10, 'l');
+    push(s, other, 0, 10, 'o');
+    sio::outbound_packet p;
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::time_point::max();
+    BOOST_REQUIRE(s.pop(p, now, next));
+    BOOST_CHECK_EQUAL(*p.payload, "l");
+    p.payload = std::make_shared<std::string>("h");
+    p.not_before = now + std::chrono::milliseconds(50);
+    limited->add(p.bytes);
+    s.push(p);
+    push(s, limited, 0, 10, 'm');
+    //the held packet keeps its flow's order, the other flow goes on.
+    BOOST_REQUIRE(s.pop(p, now, next));
+    BOOST_CHECK_EQUAL(*p.payload, "o");
+    BOOST_CHECK(!s.pop(p, now, next));
+    BOOST_CHECK(next == now + std::chrono::milliseconds(50));
+    BOOST_CHECK_EQUAL(drain(s, next), "hm");
+}
+
+BOOST_AUTO_TEST_CASE( test_outbound_scheduler_trailing )
+{
+    sio::outbound_scheduler s(3, 100);
+    sio::outbound_flow* f = s.get_flow("/chat");
+    sio::outbound_flow* other = s.get_flow("/");
+    push(s, f, 1, 10, 'a');
+    push(s, f, 2, 10, 'b');
+    push(s, f, sio::outbound_scheduler::lane_trailing, 10, 'z');
+    push(s, other, 0, 10, 'c');
+    push(s, other, 2, 10, 'd');
+    BOOST_CHECK_EQUAL(drain(s), "cabzd");
+    //nothing queued, it goes first.
+    push(s, other, 1, 10, 'd');
+    push(s, f, sio::outbound_scheduler::lane_trailing, 10, 'z');
+    BOOST_CHECK_EQUAL(drain(s), "zd");
+
+    //nor does it overtake a packet held back in a higher lane.
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    sio::outbound_packet p;
+    p.payload = std::make_shared<std::string>("h");
+    p.bytes = 10;
+    p.lane = 0;
+    p.flow = f;
+    p.not_before = now + std::chrono::milliseconds(50);
+    f->add(p.bytes);
+    s.push(p);
+    push(s, f, 2, 10, 'b');
+    push(s, f, sio::outbound_scheduler::lane_trailing, 10, 'z');
+    BOOST_CHECK_EQUAL(drain(s, now), "b");
+    BOOST_CHECK_EQUAL(drain(s, now + std::chrono::milliseconds(50)), "hz");
+}
+
+BOOST_AUTO_TEST_CASE( test_outbound_scheduler_conflation )
+{
+    sio::outbound_scheduler s(1, 100);
+    sio::outbound_flow* f = s.get_flow("/");
+    std::shared_ptr<sio::conflation_slot> slot = std::make_shared<sio::conflation_slot>();
+    sio::outbound_packet value;
+    value.payload = std::make_shared<std::string>("1");
+    BOOST_CHECK(!slot->offer(value));
+    sio::outbound_packet p = value;
+    p.bytes = 1;
+    p.lane = 0;
+    p.flow = f;
+    p.slot = slot;
+    f->add(1);
+    s.push(p);
+    push(s, f, 0, 1, 'x');
+    value.payload = std::make_shared<std::string>("2");
+    BOOST_CHECK(slot->offer(value));
+    value.payload = std::make_shared<std::string>("3");
+    BOOST_CHECK(slot->offer(value));
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::time_point::max();
+    BOOST_REQUIRE(s.pop(p, std::chrono::steady_clock::now(), next));
+    p.slot->take(p);
+    //the newest value in the first position.
+    BOOST_CHECK_EQUAL(*p.payload, "3");
+    BOOST_CHECK(!slot->offer(value));
+
+    //a dropped packet frees its slot for the next value.
+    p.slot = slot;
+    f->add(1);
+    s.push(p);
+    s.clear();
+    BOOST_CHECK(!slot->offer(value));
+}
+
+BOOST_AUTO_TEST_CASE( test_outbound_scheduler_recharge )
+{
+    sio::outbound_scheduler s(1, 100);
+    sio::outbound_flow* f = s.get_flow("/");
+    sio::outbound_flow* other = s.get_flow("/other");
+    push(s, f, 0, 50, 'a');
+    push(s, f, 0, 40, 'b');
+    push(s, other, 0, 10, 'o');
+    sio::outbound_packet p;
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::time_point::max();
+    BOOST_REQUIRE(s.pop(p, std::chrono::steady_clock::now(), next));
+    BOOST_CHECK_EQUAL(*p.payload, "a");
+    //went out with a newer, larger value, the flow's turn pays for it.
+    p.bytes = 90;
+    s.recharge(p, 50);
+    BOOST_CHECK_EQUAL(drain(s), "ob");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_rate_limiter)
+
+typedef sio::rate_limiter::clock::time_point time_point;
+
+BOOST_AUTO_TEST_CASE( test_rate_limiter_delay )
+{
+    sio::rate_limiter limiter;
+    BOOST_CHECK(!limiter.enabled());
+    limiter.set(10, 2, sio::socket::rate_limit_delay);
+    BOOST_CHECK(limiter.enabled());
+    time_point now = sio::rate_limiter::clock::now();
+    time_point due;
+    BOOST_CHECK(limiter.acquire("a", now, true, due) == sio::rate_limiter::accepted && due == now);
+    BOOST_CHECK(limiter.acquire("a", now, true, due) == sio::rate_limiter::accepted && due == now);
+    //the burst is used up, the next ones are spaced at the rate.
+    BOOST_CHECK(limiter.acquire("a", now, true, due) == sio::rate_limiter::accepted);
+    BOOST_CHECK(due - now == std::chrono::milliseconds(100));
+    BOOST_CHECK(limiter.acquire("a", now, true, due) == sio::rate_limiter::accepted);
+    BOOST_CHECK(due - now == std::chrono::milliseconds(200));
+    BOOST_CHECK(limiter.acquire("a", now, false, due) == sio::rate_limiter::dropped);
+    BOOST_CHECK(limiter.acquire("a", now + std::chrono::milliseconds(300), true, due) == sio::rate_limiter::accepted);
+    BOOST_CHECK(due == now + std::chrono::milliseconds(300));
+    limiter.set(0, 0, sio::socket::rate_limit_delay);
+    BOOST_CHECK(!limiter.enabled());
+}
+
+BOOST_AUTO_TEST_CASE( test_rate_limiter_per_name )
+{
+    sio::rate_limiter limiter;
+    limiter.set("move", 1, 1, sio::socket::rate_limit_drop);
+    limiter.set("chat", 1, 1, sio::socket::rate_limit_reject);
+    time_point now = sio::rate_limiter::clock::now();
+    time_point due;
+    BOOST_CHECK(limiter.acquire("move", now, true, due) == sio::rate_limiter::accepted);
+    BOOST_CHECK(limiter.acquire("move", now, true, due) == sio::rate_limiter::dropped);
+    BOOST_CHECK(limiter.acquire("chat", now, true, due) == sio::rate_limiter::accepted);
+    BOOST_CHECK(limiter.acquire("chat", now, true, due) == sio::rate_limiter::rejected);
+    BOOST_CHECK(limiter.acquire("other", now, true, due) == sio::rate_limiter::accepted);
+    BOOST_CHECK(limiter.acquire("move", now + std::chrono::seconds(1), true, due) == sio::rate_limiter::accepted);
+
+    //a refused event doesn't take the socket's token.
+    limiter.set(1, 1, sio::socket::rate_limit_drop);
+    BOOST_CHECK(limiter.acquire("move", now + std::chrono::seconds(1), true, due) == sio::rate_limiter::dropped);
+    BOOST_CHECK(limiter.acquire("other", now + std::chrono::seconds(1), true, due) == sio::rate_limiter::accepted);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_inbound_policy)
+
+//events can't be made outside the library, the policy only passes them on.
+static const std::shared_ptr<sio::event> no_event;
+
+BOOST_AUTO_TEST_CASE( test_inbound_policy_conflate )
+{
+    std::shared_ptr<sio::inbound_policy> policy = sio::inbound_policy::conflate(nullptr);
+    std::shared_ptr<sio::inbound_policy::slot> a, b, none;
+    BOOST_CHECK(policy->admit("EUR", no_event, a) == sio::inbound_policy::deliver && a);
+    BOOST_CHECK(policy->admit("EUR", no_event, none) == sio::inbound_policy::conflated && !none);
+    BOOST_CHECK(policy->admit("USD", no_event, b) == sio::inbound_policy::deliver && b && b != a);
+    BOOST_CHECK(policy->admit("USD", no_event, none) == sio::inbound_policy::conflated);
+    //once the dispatch for EUR started, the next one needs its own.
+    a->take();
+    policy->done();
+    BOOST_CHECK(policy->admit("EUR", no_event, none) == sio::inbound_policy::deliver && none == a);
+}
+
+BOOST_AUTO_TEST_CASE( test_inbound_policy_sweep )
+{
+    std::shared_ptr<sio::inbound_policy> policy = sio::inbound_policy::conflate(nullptr);
+    std::shared_ptr<sio::inbound_policy::slot> waiting, s, none;
+    BOOST_CHECK(policy->admit("EUR", no_event, waiting) == sio::inbound_policy::deliver);
+    //keys seen once, their dispatch done.
+    for(int i = 0; i < 1000; ++i)
+    {
+        s.reset();
+        BOOST_REQUIRE(policy->admit(std::to_string(i), no_event, s) == sio::inbound_policy::deliver);
+        s->take();
+        policy->done();
+    }
+    BOOST_CHECK(policy->slots() <= 64);
+    //the slot a dispatch waits for is kept.
+    BOOST_CHECK(policy->admit("EUR", no_event, none) == sio::inbound_policy::conflated);
+}
+
+BOOST_AUTO_TEST_CASE( test_inbound_policy_sample )
+{
+    std::shared_ptr<sio::inbound_policy> policy = sio::inbound_policy::sample(3);
+    std::shared_ptr<sio::inbound_policy::slot> s;
+    BOOST_CHECK(policy->admit("", no_event, s) == sio::inbound_policy::deliver && !s);
+    //busy, one in three gets through.
+    BOOST_CHECK(policy->admit("", no_event, s) == sio::inbound_policy::dropped);
+    BOOST_CHECK(policy->admit("", no_event, s) == sio::inbound_policy::dropped);
+    BOOST_CHECK(policy->admit("", no_event, s) == sio::inbound_policy::deliver);
+    BOOST_CHECK(policy->admit("", no_event, s) == sio::inbound_policy::dropped);
+    policy->done();
+    policy->done();
+    BOOST_CHECK(policy->admit("", no_event, s) == sio::inbound_policy::deliver);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_metrics)
+
+BOOST_AUTO_TEST_CASE( test_metrics_histogram )
+{
+    sio::latency_histogram latency;
+    latency.record(std::chrono::nanoseconds(500));
+    latency.record(std::chrono::microseconds(1));
+    latency.record(std::chrono::microseconds(100));
+    latency.record(std::chrono::microseconds(100));
+    latency.record(std::chrono::hours(1));
+    sio::client::histogram h;
+    latency.snapshot(h);
+    BOOST_CHECK_EQUAL(h.count, 5u);
+    BOOST_CHECK_EQUAL(h.buckets[0], 1u);
+    BOOST_CHECK_EQUAL(h.buckets[1], 1u);
+    //64 to 128.
+    BOOST_CHECK_EQUAL(h.buckets[7], 2u);
+    BOOST_CHECK_EQUAL(h.buckets[sio::client::histogram::bucket_count - 1], 1u);
+    BOOST_CHECK_EQUAL(h.percentile(0.5), 128u);
+    BOOST_CHECK_EQUAL(h.percentile(0.2), 1u);
+    BOOST_CHECK_EQUAL(h.percentile(1), 1ull << (sio::client::histogram::bucket_count - 1));
+}
+
+BOOST_AUTO_TEST_CASE( test_metrics_counters )
+{
+    sio::client_metrics counters;
+    unsigned timed = 0;
+    for(unsigned i = 0; i < 64; ++i)
+    {
+        timed += counters.frame_in(10) ? 1 : 0;
+        timed += counters.encoding() ? 1 : 0;
+        counters.packet_out(sio::packet::type_event);
+    }
+    counters.packet_in(sio::packet::type_ack);
+    counters.packet_in(sio::packet::type_undetermined);
+    counters.frame_out(3);
+    sio::client::metrics m;
+    counters.snapshot(m);
+    BOOST_CHECK_EQUAL(timed, 2 * 64 / sio::client_metrics::timing_period);
+    BOOST_CHECK_EQUAL(m.frames_in, 64u);
+    BOOST_CHECK_EQUAL(m.bytes_in, 640u);
+    BOOST_CHECK_EQUAL(m.packets_out[sio::packet::type_event], 64u);
+    BOOST_CHECK_EQUAL(m.packets_in[sio::packet::type_ack], 1u);
+    BOOST_CHECK_EQUAL(m.bytes_out, 3u);
+    BOOST_CHECK_EQUAL(m.reconnect_attempts, 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_tracer)
+
+BOOST_AUTO_TEST_CASE( test_tracer_sampling )
+{
+    sio::emit_tracer tracer;
+    BOOST_CHECK(!tracer.start("/", "a"));
+    tracer.set(2, nullptr);
+    std::shared_ptr<sio::emit_trace> first = tracer.start("/", "a");
+    BOOST_CHECK(!tracer.start("/", "b"));
+    std::shared_ptr<sio::emit_trace> third = tracer.start("/chat", "c");
+    BOOST_REQUIRE(first && third);
+    BOOST_CHECK_EQUAL(third->nsp, "/chat");
+    BOOST_CHECK_EQUAL(third->ack_id, -1);
+    BOOST_CHECK(third->emitted != std::chrono::steady_clock::time_point());
+}
+
+BOOST_AUTO_TEST_CASE( test_tracer_ack )
+{
+    sio::emit_tracer tracer;
+    tracer.set(1, nullptr);
+    std::shared_ptr<sio::emit_trace> plain = tracer.start("/", "plain");
+    std::shared_ptr<sio::emit_trace> acked = tracer.start("/", "acked");
+    std::shared_ptr<sio::emit_trace> lost = tracer.start("/", "lost");
+    acked->ack_id = 1;
+    lost->ack_id = 2;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    tracer.written(plain, now);
+    tracer.written(acked, now);
+    tracer.written(lost, now);
+    std::vector<sio::emit_trace> traces;
+    BOOST_CHECK_EQUAL(tracer.drain(traces), 1u);
+    //same id in another namespace.
+    tracer.acked("/chat", 1);
+    tracer.acked("/", 1);
+    tracer.abandon();
+    BOOST_CHECK_EQUAL(tracer.drain(traces), 2u);
+    BOOST_REQUIRE_EQUAL(traces.size(), 3u);
+    BOOST_CHECK_EQUAL(traces[0].name, "plain");
+    BOOST_CHECK_EQUAL(traces[1].name, "acked");
+    BOOST_CHECK(traces[1].acked >= traces[1].written);
+    BOOST_CHECK_EQUAL(traces[2].name, "lost");
+    BOOST_CHECK(traces[2].acked == std::chrono::steady_clock::time_point());
+    BOOST_CHECK(traces[0].status == socket::ack_ok);
+    BOOST_CHECK(traces[1].status == socket::ack_ok);
+    BOOST_CHECK(traces[2].status == socket::ack_disconnected);
+}
+
+BOOST_AUTO_TEST_CASE( test_tracer_failed )
+{
+    sio::emit_tracer tracer;
+    tracer.set(1, nullptr);
+    std::shared_ptr<sio::emit_trace> waiting = tracer.start("/", "waiting");
+    std::shared_ptr<sio::emit_trace> queued = tracer.start("/", "queued");
+    std::shared_ptr<sio::emit_trace> dropped = tracer.start("/", "dropped");
+    waiting->ack_id = 1;
+    queued->ack_id = 2;
+    dropped->ack_id = 3;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    tracer.written(waiting, now);
+    tracer.ack_failed(waiting, socket::ack_timeout);
+    //still in the lanes, done once written.
+    tracer.ack_failed(queued, socket::ack_timeout);
+    std::vector<sio::emit_trace> traces;
+    BOOST_CHECK_EQUAL(tracer.drain(traces), 1u);
+    tracer.written(queued, now);
+    //the ack's failure wins over the drop's.
+    tracer.ack_failed(dropped, socket::ack_rejected);
+    tracer.dropped(dropped, socket::ack_disconnected);
+    tracer.dropped(tracer.start("/", "closed"), socket::ack_disconnected);
+    BOOST_CHECK_EQUAL(tracer.drain(traces), 3u);
+    //nothing left waiting.
+    tracer.abandon();
+    BOOST_CHECK_EQUAL(tracer.drain(traces), 0u);
+    BOOST_REQUIRE_EQUAL(traces.size(), 4u);
+    BOOST_CHECK_EQUAL(traces[0].name, "waiting");
+    BOOST_CHECK(traces[0].status == socket::ack_timeout);
+    BOOST_CHECK_EQUAL(traces[1].name, "queued");
+    BOOST_CHECK(traces[1].status == socket::ack_timeout);
+    BOOST_CHECK(traces[1].written == now);
+    BOOST_CHECK_EQUAL(traces[2].name, "dropped");
+    BOOST_CHECK(traces[2].status == socket::ack_rejected);
+    BOOST_CHECK(traces[2].written == std::chrono::steady_clock::time_point());
+    BOOST_CHECK_EQUAL(traces[3].name, "closed");
+    BOOST_CHECK(traces[3].status == socket::ack_disconnected);
+}
+
+BOOST_AUTO_TEST_CASE( test_tracer_client )
+{
+    sio_stand_in server;
+    server.set_script([](std::string const& p)
+    {
+        //never acked.
+        return p.compare(0,2,"42") == 0;
+    });
+    client c;
+    c.set_transport(client::transport_polling);
+    std::mutex mutex;
+    std::vector<sio::emit_trace> traces;
+    latch finished;
+    c.set_emit_tracing(1, [&](sio::emit_trace const& trace)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        traces.push_back(trace);
+        if(traces.size() == 3) finished.set();
+    });
+    latch connected;
+    c.set_socket_open_listener([&](std::string const&){ connected.set(); });
+    c.connect(server.uri());
+    BOOST_REQUIRE(connected.wait());
+    c.socket()->set_rate_limit("limited", 1, 1, socket::rate_limit_drop);
+    c.socket()->emit_with_ack("slow", message::list(), [](socket::ack_status, message::list const&){}, 100);
+    c.socket()->emit("limited");
+    c.socket()->emit("limited");
+    BOOST_REQUIRE(finished.wait());
+    c.sync_close();
+    std::lock_guard<std::mutex> guard(mutex);
+    BOOST_REQUIRE_EQUAL(traces.size(), 3u);
+    //the dropped emit is reported first, the timeout takes 100ms.
+    BOOST_CHECK_EQUAL(traces[0].name, "limited");
+    BOOST_CHECK(traces[0].status == socket::ack_ok);
+    BOOST_CHECK_EQUAL(traces[1].name, "limited");
+    BOOST_CHECK(traces[1].status == socket::ack_rejected);
+    BOOST_CHECK_EQUAL(traces[2].name, "slow");
+    BOOST_CHECK(traces[2].status == socket::ack_timeout);
+}
+
+BOOST_AUTO_TEST_CASE( test_tracer_listener )
+{
+    sio::emit_tracer tracer;
+    std::vector<std::string> names;
+    tracer.set(1, [&](sio::emit_trace const& trace) { names.push_back(trace.name); });
+    tracer.written(tracer.start("/", "a"), std::chrono::steady_clock::now());
+    std::vector<sio::emit_trace> traces;
+    BOOST_CHECK_EQUAL(tracer.drain(traces), 0u);
+    BOOST_REQUIRE_EQUAL(names.size(), 1u);
+    BOOST_CHECK_EQUAL(names[0], "a");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_log)
+
+struct capture_logger : sio::logger
+{
+    std::vector<std::pair<level, std::string> > lines;
+
+    void log(level l, char const* message, std::size_t length)
+    {
+        lines.push_back(std::make_pair(l, std::string(message, length)));
+    }
+};
+
+BOOST_AUTO_TEST_CASE( test_log_levels )
+{
+    std::shared_ptr<capture_logger> capture = std::make_shared<capture_logger>();
+    sio::log_sink& sink = sio::log_sink::global();
+    sink.set_logger(capture);
+    sink.set_level(sio::logger::level_warning);
+    int formatted = 0;
+    SIO_LOG(sio::logger::level_info, "skipped" << ++formatted);
+    SIO_LOG(sio::logger::level_error, "failed:" << 42 << std::endl);
+    sio::log_bridge bridge(sio::logger::level_error);
+    bridge << "[2026] [error] from websocketpp\n";
+    bridge.flush();
+    sink.set_logger(nullptr);
+    sink.set_level(sio::logger::level_info);
+    //the disabled line wasn't even formatted.
+    BOOST_CHECK_EQUAL(formatted, 0);
+    BOOST_REQUIRE_EQUAL(capture->lines.size(), 2u);
+    BOOST_CHECK(capture->lines[0].first == sio::logger::level_error);
+    BOOST_CHECK_EQUAL(capture->lines[0].second, "failed:42");
+    BOOST_CHECK_EQUAL(capture->lines[1].second, "[2026] [error] from websocketpp");
+}
+
+BOOST_AUTO_TEST_CASE( test_log_line_cut )
+{
+    sio::log_line line;
+    line << std::string(sio::log_line::capacity + 10, 'x');
+    BOOST_CHECK_EQUAL(line.length(), (std::size_t)sio::log_line::capacity);
+}
+
+BOOST_AUTO_TEST_CASE( test_log_async )
+{
+    std::shared_ptr<capture_logger> capture = std::make_shared<capture_logger>();
+    {
+        sio::async_logger async(capture, 4);
+        for(int i = 0; i < 3; ++i)
+        {
+            std::string line = "line " + std::to_string(i);
+            async.log(sio::logger::level_info, line.data(), line.size());
+        }
+        //written by its thread, at the latest when it stops.
+    }
+    BOOST_REQUIRE_EQUAL(capture->lines.size(), 3u);
+    BOOST_CHECK_EQUAL(capture->lines[2].second, "line 2");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
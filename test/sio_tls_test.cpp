@@ -0,0 +1,141 @@
+//
+//  sio_tls_test.cpp
+//
+//  Tests of the TLS only parts, built with SIO_TLS against sioclient_tls.
+//
+
+#include <internal/sio_tls.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#define BOOST_TEST_MODULE sio_tls_test
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(test_tls_session_cache)
+
+// Server with a self-signed certificate, handshakes run over memory BIOs.
+class tls_stand_in
+{
+public:
+    explicit tls_stand_in(long session_timeout = 300):
+        m_ctx(SSL_CTX_new(TLS_server_method()))
+    {
+        EVP_PKEY_CTX* kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+        EVP_PKEY* key = NULL;
+        EVP_PKEY_keygen_init(kctx);
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(kctx, NID_X9_62_prime256v1);
+        EVP_PKEY_keygen(kctx, &key);
+        EVP_PKEY_CTX_free(kctx);
+        X509* cert = X509_new();
+        X509_set_version(cert, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+        X509_set_pubkey(cert, key);
+        X509_NAME* name = X509_get_subject_name(cert);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"localhost", -1, -1, 0);
+        X509_set_issuer_name(cert, name);
+        X509_sign(cert, key, EVP_sha256());
+        SSL_CTX_use_certificate(m_ctx, cert);
+        SSL_CTX_use_PrivateKey(m_ctx, key);
+        SSL_CTX_set_timeout(m_ctx, session_timeout);
+        X509_free(cert);
+        EVP_PKEY_free(key);
+    }
+
+    ~tls_stand_in()
+    {
+        SSL_CTX_free(m_ctx);
+    }
+
+    // Runs a handshake of a client connection of ctx, then lets the client
+    // read the session tickets. Returns whether the session was resumed.
+    bool connect(sio::tls_session_cache& cache, SSL_CTX* ctx, const char* server_name, bool* finished = NULL)
+    {
+        SSL* client = SSL_new(ctx);
+        SSL* server = SSL_new(m_ctx);
+        BIO* client_bio;
+        BIO* server_bio;
+        BIO_new_bio_pair(&client_bio, 0, &server_bio, 0);
+        SSL_set_bio(client, client_bio, client_bio);
+        SSL_set_bio(server, server_bio, server_bio);
+        SSL_set_connect_state(client);
+        SSL_set_accept_state(server);
+        SSL_set_tlsext_host_name(client, server_name);
+        cache.prepare(client);
+        for(int i = 0; i < 16 && !(SSL_is_init_finished(client) && SSL_is_init_finished(server)); ++i)
+        {
+            SSL_do_handshake(client);
+            SSL_do_handshake(server);
+        }
+        char buf[16];
+        SSL_read(client, buf, sizeof(buf));
+        cache.handshake_done(client, std::chrono::milliseconds(1));
+        if(finished)
+        {
+            *finished = SSL_is_init_finished(client) != 0;
+        }
+        bool resumed = SSL_session_reused(client) != 0;
+        SSL_shutdown(client);
+        SSL_shutdown(server);
+        SSL_free(client);
+        SSL_free(server);
+        return resumed;
+    }
+
+private:
+    SSL_CTX* m_ctx;
+};
+
+BOOST_AUTO_TEST_CASE( test_tls_session_cache_resume )
+{
+    tls_stand_in server;
+    sio::tls_session_cache cache;
+    sio::tls_session_cache::context_ptr ctx = cache.create_context();
+    bool finished = false;
+    BOOST_CHECK(!server.connect(cache, ctx->native_handle(), "localhost", &finished));
+    BOOST_REQUIRE(finished);
+    //the session of the first handshake is offered to the next one.
+    BOOST_CHECK(server.connect(cache, ctx->native_handle(), "localhost"));
+    BOOST_CHECK(cache.handshakes() == 2);
+    BOOST_CHECK(cache.resumed() == 1);
+    BOOST_CHECK(cache.handshake_time() == 2000);
+    //not to another server.
+    BOOST_CHECK(!server.connect(cache, ctx->native_handle(), "other"));
+    BOOST_CHECK(!server.connect(cache, ctx->native_handle(), "localhost"));
+    BOOST_CHECK(server.connect(cache, ctx->native_handle(), "localhost"));
+    cache.clear();
+    BOOST_CHECK(!server.connect(cache, ctx->native_handle(), "localhost"));
+    BOOST_CHECK(cache.resumed() == 2);
+}
+
+BOOST_AUTO_TEST_CASE( test_tls_session_cache_expiry )
+{
+    tls_stand_in server(1);
+    sio::tls_session_cache cache;
+    sio::tls_session_cache::context_ptr ctx = cache.create_context();
+    BOOST_CHECK(!server.connect(cache, ctx->native_handle(), "localhost"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+    BOOST_CHECK(!server.connect(cache, ctx->native_handle(), "localhost"));
+    //the new session is good again.
+    BOOST_CHECK(server.connect(cache, ctx->native_handle(), "localhost"));
+}
+
+BOOST_AUTO_TEST_CASE( test_tls_session_cache_failed_handshake )
+{
+    sio::tls_session_cache cache;
+    sio::tls_session_cache::context_ptr ctx = cache.create_context();
+    SSL* ssl = SSL_new(ctx->native_handle());
+    //never finished, not counted.
+    cache.handshake_done(ssl, std::chrono::milliseconds(1));
+    SSL_free(ssl);
+    BOOST_CHECK(cache.handshakes() == 0);
+    BOOST_CHECK(cache.handshake_time() == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()